@@ -0,0 +1,349 @@
+/*
+Texture atlas for small images. See atlas.h
+
+Pages are filled with a shelf packer: images go left to right along rows
+("shelves") as tall as the first image placed on them. Removing an image
+leaves a hole that the packer doesn't reuse, so a page whose live images
+cover less than half of the space handed out is repacked from its CPU
+copy before a new page is made.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+
+#define ATLAS_PAGE_SIZE     512
+#define ATLAS_MAX_SIZE      64    // larger images get a texture of their own
+#define ATLAS_PADDING       4     // edge pixels copied around each image
+#define ATLAS_ALIGN         4     // keeps cells on a 4 texel grid
+#define ATLAS_MAX_SHELVES   64
+
+typedef struct
+{
+  int   y;
+  int   h;
+  int   x;    // where the next cell on the shelf goes
+} shelf_t;
+
+struct atlas_page_s
+{
+  atlas_page_t*   p_next;
+  int             image;
+  unsigned char*  p_pixels;       // CPU copy of the page
+  atlas_slot_t*   p_slots;
+  shelf_t         shelves[ATLAS_MAX_SHELVES];
+  int             shelf_count;
+  int             top;            // first row below the last shelf
+  uint32_t        used_area;      // cells of the live slots
+  uint32_t        packed_area;    // cells handed out since the page was last packed
+  int             dirty_top;      // rows to upload. None if top >= bottom
+  int             dirty_bottom;
+};
+
+static atlas_page_t* p_pages = NULL;
+
+//---------------------------------------------------------
+static int cell_size( int size ) {
+  size += ATLAS_PADDING * 2;
+  return (size + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+}
+
+static uint32_t cell_area( const atlas_slot_t* p_slot ) {
+  return cell_size(p_slot->w) * cell_size(p_slot->h);
+}
+
+static void mark_dirty( atlas_page_t* p_page, int top, int bottom ) {
+  if ( p_page->dirty_top >= p_page->dirty_bottom ) {
+    p_page->dirty_top = top;
+    p_page->dirty_bottom = bottom;
+    return;
+  }
+  if ( top < p_page->dirty_top ) p_page->dirty_top = top;
+  if ( bottom > p_page->dirty_bottom ) p_page->dirty_bottom = bottom;
+}
+
+//---------------------------------------------------------
+// finds room for a cell. Prefers the lowest shelf it fits on, unless that
+// wastes more than half the cell height and a new shelf can still be made
+static bool pack_cell( atlas_page_t* p_page, int cw, int ch, int* p_x, int* p_y ) {
+  shelf_t* p_best = NULL;
+  for ( int i = 0; i < p_page->shelf_count; i++ ) {
+    shelf_t* p_shelf = &p_page->shelves[i];
+    if ( p_shelf->h < ch || p_shelf->x + cw > ATLAS_PAGE_SIZE ) continue;
+    if ( !p_best || p_shelf->h < p_best->h ) p_best = p_shelf;
+  }
+
+  bool can_open = p_page->shelf_count < ATLAS_MAX_SHELVES &&
+                  p_page->top + ch <= ATLAS_PAGE_SIZE;
+  if ( (!p_best || p_best->h > ch + ch / 2) && can_open ) {
+    p_best = &p_page->shelves[p_page->shelf_count++];
+    p_best->y = p_page->top;
+    p_best->h = ch;
+    p_best->x = 0;
+    p_page->top += ch;
+  }
+  if ( !p_best ) return false;
+
+  *p_x = p_best->x;
+  *p_y = p_best->y;
+  p_best->x += cw;
+  p_page->packed_area += cw * ch;
+  return true;
+}
+
+//---------------------------------------------------------
+// writes the image and its padding, repeating the edge pixels outwards
+static void copy_cell( atlas_slot_t* p_slot, const unsigned char* p_rgba ) {
+  atlas_page_t* p_page = p_slot->p_page;
+
+  for ( int r = -ATLAS_PADDING; r < p_slot->h + ATLAS_PADDING; r++ ) {
+    int sr = r < 0 ? 0 : (r >= p_slot->h ? p_slot->h - 1 : r);
+    const unsigned char* p_src = p_rgba + (size_t)sr * p_slot->w * 4;
+    unsigned char* p_dst = p_page->p_pixels +
+      ((size_t)(p_slot->y + r) * ATLAS_PAGE_SIZE + p_slot->x) * 4;
+
+    for ( int c = 1; c <= ATLAS_PADDING; c++ ) {
+      memcpy(p_dst - c * 4, p_src, 4);
+      memcpy(p_dst + (p_slot->w - 1 + c) * 4, p_src + (p_slot->w - 1) * 4, 4);
+    }
+    memcpy(p_dst, p_src, p_slot->w * 4);
+  }
+
+  mark_dirty(p_page, p_slot->y - ATLAS_PADDING, p_slot->y + p_slot->h + ATLAS_PADDING);
+}
+
+//---------------------------------------------------------
+static int compare_height( const void* p_a, const void* p_b ) {
+  const atlas_slot_t* a = *(atlas_slot_t* const*)p_a;
+  const atlas_slot_t* b = *(atlas_slot_t* const*)p_b;
+  return b->h - a->h;
+}
+
+// packs the live slots of a page again, tallest first, closing the holes
+// left by removed ones. Leaves the page as it was if they don't all fit
+static bool repack_page( atlas_page_t* p_page ) {
+  int count = 0;
+  for ( atlas_slot_t* p_slot = p_page->p_slots; p_slot; p_slot = p_slot->p_next ) count++;
+  if ( count == 0 ) return false;
+
+  atlas_slot_t** pp_slots = malloc(count * sizeof(atlas_slot_t*));
+  int* p_pos = malloc(count * 2 * sizeof(int));
+  unsigned char* p_pixels = calloc(ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 4);
+  if ( !pp_slots || !p_pos || !p_pixels ) {
+    free(pp_slots);
+    free(p_pos);
+    free(p_pixels);
+    return false;
+  }
+
+  int i = 0;
+  for ( atlas_slot_t* p_slot = p_page->p_slots; p_slot; p_slot = p_slot->p_next ) {
+    pp_slots[i++] = p_slot;
+  }
+  qsort(pp_slots, count, sizeof(atlas_slot_t*), compare_height);
+
+  atlas_page_t packed = *p_page;
+  packed.shelf_count = 0;
+  packed.top = 0;
+  packed.packed_area = 0;
+  for ( i = 0; i < count; i++ ) {
+    int cw = cell_size(pp_slots[i]->w);
+    int ch = cell_size(pp_slots[i]->h);
+    if ( !pack_cell(&packed, cw, ch, &p_pos[i * 2], &p_pos[i * 2 + 1]) ) break;
+  }
+  if ( i < count ) {
+    free(pp_slots);
+    free(p_pos);
+    free(p_pixels);
+    return false;
+  }
+
+  // move the padded images over to their new places
+  for ( i = 0; i < count; i++ ) {
+    atlas_slot_t* p_slot = pp_slots[i];
+    int nx = p_pos[i * 2] + ATLAS_PADDING;
+    int ny = p_pos[i * 2 + 1] + ATLAS_PADDING;
+    int row_bytes = (p_slot->w + ATLAS_PADDING * 2) * 4;
+    for ( int r = -ATLAS_PADDING; r < p_slot->h + ATLAS_PADDING; r++ ) {
+      memcpy(p_pixels + ((size_t)(ny + r) * ATLAS_PAGE_SIZE + nx - ATLAS_PADDING) * 4,
+        p_page->p_pixels + ((size_t)(p_slot->y + r) * ATLAS_PAGE_SIZE + p_slot->x - ATLAS_PADDING) * 4,
+        row_bytes);
+    }
+    p_slot->x = nx;
+    p_slot->y = ny;
+  }
+
+  free(p_page->p_pixels);
+  memcpy(p_page->shelves, packed.shelves, sizeof(packed.shelves));
+  p_page->shelf_count = packed.shelf_count;
+  p_page->top = packed.top;
+  p_page->packed_area = packed.packed_area;
+  p_page->p_pixels = p_pixels;
+  mark_dirty(p_page, 0, ATLAS_PAGE_SIZE);
+
+  free(pp_slots);
+  free(p_pos);
+  return true;
+}
+
+//---------------------------------------------------------
+static atlas_page_t* new_page( NVGcontext* p_ctx ) {
+  atlas_page_t* p_page = calloc(1, sizeof(atlas_page_t));
+  if ( !p_page ) return NULL;
+  p_page->p_pixels = calloc(ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 4);
+  if ( p_page->p_pixels ) {
+    p_page->image = nvgCreateImageRGBA(p_ctx, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE,
+      0, p_page->p_pixels);
+  }
+  if ( !p_page->p_pixels || p_page->image == 0 ) {
+    free(p_page->p_pixels);
+    free(p_page);
+    return NULL;
+  }
+
+  p_page->p_next = p_pages;
+  p_pages = p_page;
+  return p_page;
+}
+
+//=============================================================================
+
+//---------------------------------------------------------
+bool atlas_fits( int w, int h ) {
+  return w > 0 && h > 0 && w <= ATLAS_MAX_SIZE && h <= ATLAS_MAX_SIZE;
+}
+
+//---------------------------------------------------------
+atlas_slot_t* atlas_add( NVGcontext* p_ctx, int w, int h, const unsigned char* p_rgba ) {
+  if ( !atlas_fits(w, h) ) return NULL;
+
+  int cw = cell_size(w);
+  int ch = cell_size(h);
+  int x, y;
+
+  // first try the pages as they are, then the fragmented ones repacked
+  atlas_page_t* p_page;
+  for ( p_page = p_pages; p_page; p_page = p_page->p_next ) {
+    if ( pack_cell(p_page, cw, ch, &x, &y) ) break;
+  }
+  if ( !p_page ) {
+    for ( p_page = p_pages; p_page; p_page = p_page->p_next ) {
+      if ( p_page->used_area * 2 < p_page->packed_area && repack_page(p_page) &&
+           pack_cell(p_page, cw, ch, &x, &y) ) break;
+    }
+  }
+  if ( !p_page ) {
+    p_page = new_page(p_ctx);
+    if ( !p_page || !pack_cell(p_page, cw, ch, &x, &y) ) return NULL;
+  }
+
+  atlas_slot_t* p_slot = malloc(sizeof(atlas_slot_t));
+  p_slot->p_page = p_page;
+  p_slot->x = x + ATLAS_PADDING;
+  p_slot->y = y + ATLAS_PADDING;
+  p_slot->w = w;
+  p_slot->h = h;
+  p_slot->p_next = p_page->p_slots;
+  p_page->p_slots = p_slot;
+  p_page->used_area += cw * ch;
+
+  copy_cell(p_slot, p_rgba);
+  return p_slot;
+}
+
+//---------------------------------------------------------
+void atlas_update( atlas_slot_t* p_slot, const unsigned char* p_rgba ) {
+  copy_cell(p_slot, p_rgba);
+}
+
+//---------------------------------------------------------
+// the page already holds the rest of the image, so the padding is
+// extruded again from the page itself where the rect touches an edge
+void atlas_update_rect( atlas_slot_t* p_slot, int x, int y, int w, int h,
+                        const unsigned char* p_rgba ) {
+  atlas_page_t* p_page = p_slot->p_page;
+  size_t row_bytes = ATLAS_PAGE_SIZE * 4;
+  unsigned char* p_cell = p_page->p_pixels + ((size_t)p_slot->y * ATLAS_PAGE_SIZE + p_slot->x) * 4;
+
+  for ( int r = y; r < y + h; r++ ) {
+    unsigned char* p_dst = p_cell + r * row_bytes;
+    memcpy(p_dst + x * 4, p_rgba + (size_t)(r - y) * w * 4, w * 4);
+    for ( int c = 1; c <= ATLAS_PADDING; c++ ) {
+      if ( x == 0 ) memcpy(p_dst - c * 4, p_dst, 4);
+      if ( x + w == p_slot->w ) memcpy(p_dst + (p_slot->w - 1 + c) * 4, p_dst + (p_slot->w - 1) * 4, 4);
+    }
+  }
+
+  // padding rows are copies of the first and last rows, corners included
+  int top = p_slot->y + y;
+  int bottom = p_slot->y + y + h;
+  size_t padded_bytes = (p_slot->w + ATLAS_PADDING * 2) * 4;
+  for ( int c = 1; c <= ATLAS_PADDING; c++ ) {
+    if ( y == 0 ) {
+      memcpy(p_cell - c * row_bytes - ATLAS_PADDING * 4, p_cell - ATLAS_PADDING * 4, padded_bytes);
+    }
+    if ( y + h == p_slot->h ) {
+      unsigned char* p_last = p_cell + (p_slot->h - 1) * row_bytes - ATLAS_PADDING * 4;
+      memcpy(p_last + c * row_bytes, p_last, padded_bytes);
+    }
+  }
+  if ( y == 0 ) top -= ATLAS_PADDING;
+  if ( y + h == p_slot->h ) bottom += ATLAS_PADDING;
+
+  mark_dirty(p_page, top, bottom);
+}
+
+//---------------------------------------------------------
+void atlas_remove( NVGcontext* p_ctx, atlas_slot_t* p_slot ) {
+  atlas_page_t* p_page = p_slot->p_page;
+
+  atlas_slot_t** pp = &p_page->p_slots;
+  while ( *pp != p_slot ) pp = &(*pp)->p_next;
+  *pp = p_slot->p_next;
+  p_page->used_area -= cell_area(p_slot);
+  free(p_slot);
+
+  if ( p_page->p_slots ) return;
+
+  // the page is empty
+  atlas_page_t** pp_page = &p_pages;
+  while ( *pp_page != p_page ) pp_page = &(*pp_page)->p_next;
+  *pp_page = p_page->p_next;
+  nvgDeleteImage(p_ctx, p_page->image);
+  free(p_page->p_pixels);
+  free(p_page);
+}
+
+//---------------------------------------------------------
+void atlas_read( const atlas_slot_t* p_slot, unsigned char* p_rgba ) {
+  const atlas_page_t* p_page = p_slot->p_page;
+  for ( int r = 0; r < p_slot->h; r++ ) {
+    memcpy(p_rgba + (size_t)r * p_slot->w * 4,
+           p_page->p_pixels + ((size_t)(p_slot->y + r) * ATLAS_PAGE_SIZE + p_slot->x) * 4,
+           p_slot->w * 4);
+  }
+}
+
+//---------------------------------------------------------
+int atlas_image( const atlas_slot_t* p_slot ) {
+  return p_slot->p_page->image;
+}
+
+//---------------------------------------------------------
+uint32_t atlas_slot_bytes( const atlas_slot_t* p_slot ) {
+  return cell_area(p_slot) * 4;
+}
+
+//---------------------------------------------------------
+bool atlas_flush( NVGcontext* p_ctx ) {
+  bool flushed = false;
+  for ( atlas_page_t* p_page = p_pages; p_page; p_page = p_page->p_next ) {
+    if ( p_page->dirty_top >= p_page->dirty_bottom ) continue;
+    nvgUpdateImageRegion(p_ctx, p_page->image, 0, p_page->dirty_top,
+      ATLAS_PAGE_SIZE, p_page->dirty_bottom - p_page->dirty_top, p_page->p_pixels);
+    p_page->dirty_top = p_page->dirty_bottom = 0;
+    flushed = true;
+  }
+  return flushed;
+}
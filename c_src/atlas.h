@@ -0,0 +1,69 @@
+/*
+Texture atlas for small images
+
+Icons and other small static textures are packed into shared RGBA pages
+instead of getting a texture each. Image patterns that use the same page
+don't need a texture change, so nanovg can batch them into one draw.
+
+Each image is surrounded by a copy of its edge pixels, so filtering
+doesn't pick up the neighbours. Pages never get mipmaps: neighbours would
+bleed into each other a few levels down. An image that is drawn minified
+is moved out to a texture of its own instead. A CPU copy of every page is
+kept to upload changed rows, to repack pages whose space is fragmented by
+removed images and to read images back out. Only used on the render
+thread.
+*/
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include <stdint.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+#include "nanovg/nanovg.h"
+
+typedef struct atlas_page_s atlas_page_t;
+
+typedef struct atlas_slot_s
+{
+  atlas_page_t*         p_page;
+  struct atlas_slot_s*  p_next;   // the other slots on the same page
+  int                   x;        // the image inside the page, not counting the padding
+  int                   y;
+  int                   w;
+  int                   h;
+} atlas_slot_t;
+
+// true if an image of this size is packed instead of getting its own texture
+bool atlas_fits( int w, int h );
+
+// copies tightly packed RGBA pixels into a page. Returns NULL if there
+// is no room and no new page could be made
+atlas_slot_t* atlas_add( NVGcontext* p_ctx, int w, int h, const unsigned char* p_rgba );
+
+// replaces the pixels of a slot. Same size as it was added with
+void atlas_update( atlas_slot_t* p_slot, const unsigned char* p_rgba );
+
+// replaces the rect (x,y,w,h) of a slot's image. p_rgba holds just the rect
+void atlas_update_rect( atlas_slot_t* p_slot, int x, int y, int w, int h,
+                        const unsigned char* p_rgba );
+
+// frees the slot. Pages left empty are deleted
+void atlas_remove( NVGcontext* p_ctx, atlas_slot_t* p_slot );
+
+// copies the slot's image out as tightly packed RGBA, without its padding
+void atlas_read( const atlas_slot_t* p_slot, unsigned char* p_rgba );
+
+// nanovg image of the page the slot is on
+int atlas_image( const atlas_slot_t* p_slot );
+
+// memory a slot takes in its page, padding included
+uint32_t atlas_slot_bytes( const atlas_slot_t* p_slot );
+
+// uploads the page rows changed since the last flush. Returns true if any were
+bool atlas_flush( NVGcontext* p_ctx );
+
+#endif
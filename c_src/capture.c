@@ -0,0 +1,104 @@
+/*
+Capture of the message stream coming down from the caller.
+See capture.h for the file format.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+
+// large enough that the writes coming from a frame's worth of messages
+// are usually collapsed into a single write to disk
+#define CAPTURE_BUFFER_SIZE     (256 * 1024)
+
+static FILE*    capture_file  = NULL;
+static char*    capture_buff  = NULL;
+static uint64_t capture_start = 0;
+
+//---------------------------------------------------------
+uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+//---------------------------------------------------------
+bool capture_open( const char* path, int width, int height ) {
+  capture_header_t header;
+
+  capture_close();
+
+  capture_file = fopen(path, "wb");
+  if ( !capture_file ) {
+    fprintf(stderr, "could not open capture file %s\n", path);
+    return false;
+  }
+
+  // fully buffered, so capturing costs a memcpy per message
+  capture_buff = malloc(CAPTURE_BUFFER_SIZE);
+  if ( capture_buff ) {
+    setvbuf(capture_file, capture_buff, _IOFBF, CAPTURE_BUFFER_SIZE);
+  }
+
+  capture_start = monotonic_ns();
+
+  memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+  header.version    = CAPTURE_VERSION;
+  header.byte_order = CAPTURE_BYTE_ORDER;
+  header.width      = width;
+  header.height     = height;
+  header.start_ns   = capture_start;
+  fwrite(&header, sizeof(capture_header_t), 1, capture_file);
+
+  return true;
+}
+
+//---------------------------------------------------------
+void capture_close() {
+  if ( capture_file ) {
+    fclose(capture_file);
+    capture_file = NULL;
+  }
+  // the buffer must outlive the stream, so only free it now
+  free(capture_buff);
+  capture_buff = NULL;
+}
+
+//---------------------------------------------------------
+bool capture_active() {
+  return capture_file != NULL;
+}
+
+//---------------------------------------------------------
+static void write_record( uint32_t type, uint32_t length ) {
+  capture_record_t record;
+  record.type    = type;
+  record.length  = length;
+  record.time_ns = monotonic_ns() - capture_start;
+  fwrite(&record, sizeof(capture_record_t), 1, capture_file);
+}
+
+//---------------------------------------------------------
+// starts a message record. The payload is added by capture_write
+// as the message is read down from stdin
+void capture_begin_msg( uint32_t length ) {
+  if ( !capture_file ) return;
+  write_record(CAPTURE_REC_MSG, length);
+}
+
+//---------------------------------------------------------
+void capture_write( const void* p_data, int length ) {
+  if ( !capture_file || length <= 0 ) return;
+  fwrite(p_data, 1, length, capture_file);
+}
+
+//---------------------------------------------------------
+void capture_frame() {
+  if ( !capture_file ) return;
+  write_record(CAPTURE_REC_FRAME, 0);
+}
@@ -0,0 +1,75 @@
+/*
+Capture of the message stream coming down from the caller
+
+When the driver is launched with "-c <path>", every framed message read in
+handle_stdio_in is appended to a capture file, together with a marker each
+time a frame is presented. The file can be replayed offline by the
+scenic_driver_egl_replay tool.
+
+File format, version 1. All values are in the byte order of the machine that
+wrote the capture, which is recorded in the header.
+
+  header (32 bytes)
+    char      magic[8]      "SCNEGLCP"
+    uint32_t  version       CAPTURE_VERSION
+    uint32_t  byte_order    0x01020304 as written by the capturing machine
+    uint32_t  width         screen width in pixels
+    uint32_t  height        screen height in pixels
+    uint64_t  start_ns      CLOCK_MONOTONIC time the capture was opened
+
+  records, repeated until end of file (16 byte header + payload)
+    uint32_t  type          CAPTURE_REC_MSG or CAPTURE_REC_FRAME
+    uint32_t  length        number of payload bytes that follow
+    uint64_t  time_ns       CLOCK_MONOTONIC time relative to start_ns
+    byte      payload[length]
+
+A CAPTURE_REC_MSG payload is exactly the message as it came in on stdin,
+without the 4 byte big-endian packet length. It starts with the uint32_t
+message id. A CAPTURE_REC_FRAME record has no payload and marks the point
+where the driver rendered and presented a frame.
+*/
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdint.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+#define CAPTURE_MAGIC           "SCNEGLCP"
+#define CAPTURE_VERSION         1
+#define CAPTURE_BYTE_ORDER      0x01020304
+
+#define CAPTURE_REC_MSG         0x01
+#define CAPTURE_REC_FRAME       0x02
+
+typedef struct __attribute__((__packed__))
+{
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  byte_order;
+  uint32_t  width;
+  uint32_t  height;
+  uint64_t  start_ns;
+} capture_header_t;
+
+typedef struct __attribute__((__packed__))
+{
+  uint32_t  type;
+  uint32_t  length;
+  uint64_t  time_ns;
+} capture_record_t;
+
+bool capture_open(const char* path, int width, int height);
+void capture_close();
+bool capture_active();
+
+void capture_begin_msg(uint32_t length);
+void capture_write(const void* p_data, int length);
+void capture_frame();
+
+uint64_t monotonic_ns();
+
+#endif
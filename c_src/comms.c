@@ -22,10 +22,13 @@ The caller will typically be erlang, so use the 2-byte length indicator
 #include <sys/select.h>
 
 #include "types.h"
+#include "capture.h"
 #include "comms.h"
+#include "font.h"
 #include "render_script.h"
 #include "tx.h"
 #include "utils.h"
+#include "uthash.h"
 
 #define   MSG_OUT_CLOSE             0x00
 #define   MSG_OUT_STATS             0x01
@@ -35,6 +38,7 @@ The caller will typically be erlang, so use the 2-byte length indicator
 #define   MSG_OUT_RESHAPE           0x05
 #define   MSG_OUT_READY             0x06
 #define   MSG_OUT_DRAW_READY        0x07
+#define   MSG_OUT_TEXT_METRICS      0x08
 
 #define   MSG_OUT_KEY               0x0A
 #define   MSG_OUT_CODEPOINT         0x0B
@@ -47,6 +51,8 @@ The caller will typically be erlang, so use the 2-byte length indicator
 #define   MSG_OUT_DYNAMIC_TEXTURE_MISS 0x21
 
 #define   MSG_OUT_FONT_MISS         0x22
+#define   MSG_OUT_TX_HANDLE_UNUSED  0x23
+#define   MSG_OUT_TX_HANDLE_RELEASED 0x24
 
 // #define   MSG_OUT_NEW_DL_ID         0x30
 #define   MSG_OUT_NEW_TX_ID         0x31
@@ -54,46 +60,6 @@ The caller will typically be erlang, so use the 2-byte length indicator
 
 
 
-#define   CMD_RENDER_GRAPH          0x01
-#define   CMD_CLEAR_GRAPH           0x02
-#define   CMD_SET_ROOT              0x03
-
-#define   CMD_CLEAR_COLOR           0x05
-
-// #define   CMD_CACHE_LOAD            0x03
-// #define   CMD_CACHE_RELEASE         0x04
-
-#define   CMD_INPUT                 0x0A
-
-#define   CMD_QUIT                  0x20
-#define   CMD_QUERY_STATS           0x21
-#define   CMD_RESHAPE               0x22
-#define   CMD_POSITION              0x23
-#define   CMD_FOCUS                 0x24
-#define   CMD_ICONIFY               0x25
-#define   CMD_MAXIMIZE              0x26
-#define   CMD_RESTORE               0x27
-#define   CMD_SHOW                  0x28
-#define   CMD_HIDE                  0x29
-
-// #define   CMD_NEW_DL_ID             0x30
-// #define   CMD_FREE_DL_ID            0x31
-
-#define   CMD_NEW_TX_ID             0x32
-#define   CMD_FREE_TX_ID            0x33
-#define   CMD_PUT_TX_BLOB           0x34
-#define   CMD_PUT_TX_RAW            0x35
-
-
-#define   CMD_LOAD_FONT_FILE        0X37
-#define   CMD_LOAD_FONT_BLOB        0X38
-#define   CMD_FREE_FONT             0X39
-
-// here to test recovery
-#define   CMD_CRASH                 0xFE
-
-
-
 // handy time definitions in microseconds
 #define MILLISECONDS_8              8000
 #define MILLISECONDS_16             16000
@@ -115,6 +81,11 @@ The caller will typically be erlang, so use the 2-byte length indicator
 
 static bool f_little_endian;
 
+// where messages come down from and go up to. Normally stdin and stdout,
+// the replay tool points them at a capture file and /dev/null
+static int comms_in_fd  = 0;
+static int comms_out_fd = 1;
+
 // pthread_rwlock_t comms_out_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 
@@ -129,6 +100,11 @@ void test_endian() {
   f_little_endian = (*((uint8_t*)(&i))) == 0x67;
 }
 
+void set_comms_fds( int in_fd, int out_fd ) {
+  comms_in_fd  = in_fd;
+  comms_out_fd = out_fd;
+}
+
 
 
 //---------------------------------------------------------
@@ -137,7 +113,7 @@ int read_exact(byte *buf, int len)
   int i, got=0;
 
   do {
-    if ((i = read(0, buf+got, len-got)) <= 0)
+    if ((i = read(comms_in_fd, buf+got, len-got)) <= 0)
       return(i);
     got += i;
   } while (got<len);
@@ -152,7 +128,7 @@ int write_exact(byte *buf, int len)
   int i, wrote = 0;
 
   do {
-    if ((i = write(1, buf+wrote, len-wrote)) <= 0)
+    if ((i = write(comms_out_fd, buf+wrote, len-wrote)) <= 0)
       return (i);
     wrote += i;
   } while (wrote<len);
@@ -195,10 +171,10 @@ int read_msg_length(struct timeval *ptv) {
 
   // Watch stdin (fd 0) to see when it has input.
   FD_ZERO(&rfds);
-  FD_SET(0, &rfds);
+  FD_SET(comms_in_fd, &rfds);
 
   // look for data
-  retval = select(1, &rfds, NULL, NULL, ptv);
+  retval = select(comms_in_fd + 1, &rfds, NULL, NULL, ptv);
   if (retval == -1) {
     return -1;  // error
   }
@@ -207,6 +183,7 @@ int read_msg_length(struct timeval *ptv) {
     // length from erlang is always big endian
     uint32_t len = *((uint32_t*)&buff);
     if (f_little_endian) len = SWAP_UINT32(len);
+    capture_begin_msg(len);
     return len;
   } else {
     // no data within the timeout
@@ -220,6 +197,7 @@ bool read_bytes_down( void* p_buff, int bytes_to_read, int* p_bytes_to_remaining
   if (bytes_to_read > *p_bytes_to_remaining){
     // read in the remaining bytes
     read_exact(p_buff, *p_bytes_to_remaining);
+    capture_write(p_buff, *p_bytes_to_remaining);
     *p_bytes_to_remaining = 0;
     // return false
     return false;
@@ -227,11 +205,23 @@ bool read_bytes_down( void* p_buff, int bytes_to_read, int* p_bytes_to_remaining
 
   // read in the requested bytes
   read_exact(p_buff, bytes_to_read);
+  capture_write(p_buff, bytes_to_read);
   // do accounting on the bytes remaining
   *p_bytes_to_remaining -= bytes_to_read;
   return true;
 }
 
+//---------------------------------------------------------
+// reads past data that isn't needed, without a buffer the size of it
+void skip_bytes_down( int bytes_to_skip, int* p_bytes_to_remaining ) {
+  byte buff[4096];
+  while ( bytes_to_skip > 0 && *p_bytes_to_remaining > 0 ) {
+    int chunk = bytes_to_skip < (int)sizeof(buff) ? bytes_to_skip : (int)sizeof(buff);
+    read_bytes_down( buff, chunk, p_bytes_to_remaining );
+    bytes_to_skip -= chunk;
+  }
+}
+
 //=============================================================================
 // send messages up to caller
 
@@ -274,11 +264,63 @@ void send_inspect( void* data, int length ) {
 }
 
 //---------------------------------------------------------
-void send_static_texture_miss(const char* key)
+// the reply to CMD_MEASURE_TEXT. See receive_measure_text
+void send_text_metrics( void* data, int length ) {
+  uint32_t cmd_len = length + sizeof(uint32_t);
+  uint32_t cmd = MSG_OUT_TEXT_METRICS;
+
+  if (f_little_endian) cmd_len = SWAP_UINT32(cmd_len);
+
+  write_exact((byte*)&cmd_len, sizeof(uint32_t));
+  write_exact((byte*)&cmd, sizeof(uint32_t));
+  write_exact(data, length);
+}
+
+//---------------------------------------------------------
+// missing textures and fonts are requested once. Scripts keep drawing
+// while the reply is on its way, and a multi megabyte blob can take a
+// while, so the same key is only asked for again if nothing has come back
+// after MISS_RETRY_NS. Putting the texture or font forgets the request
+#define MISS_RETRY_NS               2000000000ULL
+
+#define MISS_STATIC_TEXTURE         0
+#define MISS_DYNAMIC_TEXTURE        1
+#define MISS_FONT                   2
+
+typedef struct
+{
+  const char*     key;
+  uint64_t        sent_ns;
+  UT_hash_handle  hh;
+} miss_t;
+
+static miss_t*      p_misses[3] = {NULL, NULL, NULL};
+static miss_stats_t miss_stats = {0};
+
+static void send_miss(int kind, uint32_t cmd, const char* key)
 {
+  uint64_t now = monotonic_ns();
+  miss_t*  found;
+  HASH_FIND_STR(p_misses[kind], key, found);
+  if (found && now - found->sent_ns < MISS_RETRY_NS) {
+    miss_stats.suppressed++;
+    return;
+  }
+
+  if (found) {
+    miss_stats.retried++;
+  } else {
+    int key_size = strlen(key) + 1;
+    found = malloc(sizeof(miss_t) + key_size);
+    found->key = (void*)found + sizeof(miss_t);
+    memcpy((char*)found->key, key, key_size);
+    HASH_ADD_KEYPTR(hh, p_misses[kind], found->key, key_size - 1, found);
+  }
+  found->sent_ns = now;
+  miss_stats.sent++;
+
   uint32_t msg_len = strlen(key);
   uint32_t cmd_len = msg_len + sizeof(uint32_t);
-  uint32_t cmd     = MSG_OUT_STATIC_TEXTURE_MISS;
 
   if (f_little_endian)
     cmd_len = SWAP_UINT32(cmd_len);
@@ -288,34 +330,66 @@ void send_static_texture_miss(const char* key)
   write_exact((byte*) key, msg_len);
 }
 
-//---------------------------------------------------------
+static void forget_miss(int kind, const char* key)
+{
+  miss_t* found;
+  HASH_FIND_STR(p_misses[kind], key, found);
+  if (found) {
+    HASH_DEL(p_misses[kind], found);
+    free(found);
+  }
+}
+
+void send_static_texture_miss(const char* key)
+{
+  send_miss(MISS_STATIC_TEXTURE, MSG_OUT_STATIC_TEXTURE_MISS, key);
+}
+
 void send_dynamic_texture_miss(const char* key)
 {
+  send_miss(MISS_DYNAMIC_TEXTURE, MSG_OUT_DYNAMIC_TEXTURE_MISS, key);
+}
+
+void send_font_miss( const char* key ) {
+  send_miss(MISS_FONT, MSG_OUT_FONT_MISS, key);
+}
+
+// a texture arrived, whichever cache it came from
+void texture_miss_answered( const char* key ) {
+  forget_miss(MISS_STATIC_TEXTURE, key);
+  forget_miss(MISS_DYNAMIC_TEXTURE, key);
+}
+
+void font_miss_answered( const char* key ) {
+  forget_miss(MISS_FONT, key);
+}
+
+//---------------------------------------------------------
+// a texture handle whose key was freed and that no stored script draws
+// with. Elixir stops giving it out and then releases it
+void send_tx_handle_unused( uint32_t handle, const char* key ) {
   uint32_t msg_len = strlen(key);
-  uint32_t cmd_len = msg_len + sizeof(uint32_t);
-  uint32_t cmd     = MSG_OUT_DYNAMIC_TEXTURE_MISS;
+  uint32_t cmd_len = msg_len + 2 * sizeof(uint32_t);
+  uint32_t cmd = MSG_OUT_TX_HANDLE_UNUSED;
 
   if (f_little_endian)
     cmd_len = SWAP_UINT32(cmd_len);
 
   write_exact((byte*) &cmd_len, sizeof(uint32_t));
   write_exact((byte*) &cmd, sizeof(uint32_t));
+  write_exact((byte*) &handle, sizeof(uint32_t));
   write_exact((byte*) key, msg_len);
 }
 
-//---------------------------------------------------------
-void send_font_miss( const char* key ) {
-  uint32_t msg_len = strlen(key);
-  uint32_t cmd_len = msg_len + sizeof(uint32_t);
-  uint32_t cmd = MSG_OUT_FONT_MISS;
-
-  if (f_little_endian) cmd_len = SWAP_UINT32(cmd_len);
-
-  write_exact((byte*)&cmd_len, sizeof(uint32_t));
-  write_exact((byte*)&cmd, sizeof(uint32_t));
-  write_exact((byte*)key, msg_len);
+// the handle is gone from the port, so Elixir can give it to a new key
+void send_tx_handle_released( uint32_t handle ) {
+  uint32_t msg[2] = { MSG_OUT_TX_HANDLE_RELEASED, handle };
+  write_cmd( (byte*)msg, sizeof(msg) );
 }
 
+void get_miss_stats( miss_stats_t* p_stats ) {
+  *p_stats = miss_stats;
+}
 
 //---------------------------------------------------------
 typedef struct __attribute__((__packed__))
@@ -447,6 +521,26 @@ typedef struct __attribute__((__packed__))
   int32_t       ypos;
   int32_t       width;
   int32_t       height;
+  uint32_t      tx_decoded;
+  uint64_t      tx_decode_us_total;
+  uint32_t      tx_decode_us_max;
+  uint64_t      tx_resident_bytes;
+  uint32_t      tx_evictions;
+  uint32_t      miss_sent;
+  uint32_t      miss_suppressed;
+  uint32_t      miss_retried;
+  uint32_t      tx_dedup_hits;
+  uint64_t      tx_dedup_bytes;
+  uint32_t      glyph_atlas_width;
+  uint32_t      glyph_atlas_height;
+  uint32_t      glyph_atlas_used;
+  uint32_t      glyph_count;
+  uint32_t      glyph_evictions;
+  uint32_t      glyph_rerasterized;
+  uint32_t      glyph_atlas_resets;
+  uint32_t      font_count;
+  uint32_t      font_bytes;
+  uint32_t      fonts_freed;
 } msg_stats_t;
 void receive_query_stats( driver_data_t* p_data ) {
   msg_stats_t   msg;
@@ -464,6 +558,38 @@ void receive_query_stats( driver_data_t* p_data ) {
   msg.width = p_data->screen_width;
   msg.height = p_data->screen_height;
 
+  tx_stats_t tx;
+  get_tx_stats(&tx);
+  msg.tx_decoded = tx.decoded;
+  msg.tx_decode_us_total = tx.decode_total_ns / 1000;
+  msg.tx_decode_us_max = tx.decode_max_ns / 1000;
+  msg.tx_resident_bytes = tx.resident_bytes;
+  msg.tx_evictions = tx.evictions;
+
+  miss_stats_t miss;
+  get_miss_stats(&miss);
+  msg.miss_sent = miss.sent;
+  msg.miss_suppressed = miss.suppressed;
+  msg.miss_retried = miss.retried;
+  msg.tx_dedup_hits = tx.dedup_hits;
+  msg.tx_dedup_bytes = tx.dedup_bytes;
+
+  NVGtextAtlasStats atlas;
+  nvgTextAtlasStats(p_data->p_ctx, &atlas);
+  msg.glyph_atlas_width = atlas.width;
+  msg.glyph_atlas_height = atlas.height;
+  msg.glyph_atlas_used = atlas.used;
+  msg.glyph_count = atlas.glyphs;
+  msg.glyph_evictions = atlas.evictions;
+  msg.glyph_rerasterized = atlas.rerasterized;
+  msg.glyph_atlas_resets = atlas.resets;
+
+  font_stats_t fonts;
+  get_font_stats(p_data->p_ctx, &fonts);
+  msg.font_count = fonts.loaded;
+  msg.font_bytes = fonts.bytes;
+  msg.fonts_freed = fonts.freed;
+
   write_cmd( (byte*)&msg, sizeof(msg_stats_t) );
 }
 
@@ -495,15 +621,16 @@ void receive_render( int* p_msg_length, driver_data_t* p_data ) {
   read_bytes_down( &id, sizeof(GLuint), p_msg_length);
 
   // extract the render script itself
-  void* p_script = malloc(*p_msg_length);
-  read_bytes_down( p_script, *p_msg_length, p_msg_length);
+  int   script_length = *p_msg_length;
+  void* p_script = malloc(script_length);
+  read_bytes_down( p_script, script_length, p_msg_length);
 
   // char buff[200];
   // sprintf(buff, "receive_render %d", id);
   // send_puts( buff );
 
   // save the script away for later
-  put_script( p_data, id, p_script );
+  put_script( p_data, id, p_script, script_length );
 
   // render the graph
 //  if ( pthread_rwlock_wrlock(&p_data->context.gl_lock) == 0 ) {
@@ -555,11 +682,11 @@ typedef struct __attribute__((__packed__))
   GLuint b;
   GLuint a;
 } clear_color_t;
-void receive_clear_color( int* p_msg_length ) {
-  // get the clear_color
+void receive_clear_color( int* p_msg_length, driver_data_t* p_data ) {
+  // get the clear_color. It is applied by the renderer as each frame starts
   clear_color_t cc;
   read_bytes_down( &cc, sizeof(clear_color_t), p_msg_length);
-  glClearColor(cc.r/255.0, cc.g/255.0, cc.b/255.0, cc.a/255.0);
+  p_data->clear_color = nvgRGBA(cc.r, cc.g, cc.b, cc.a);
 }
 
 
@@ -568,8 +695,20 @@ typedef struct __attribute__((__packed__))
 {
   GLuint name_length;
   GLuint data_length;
+  GLuint flags;
 } font_info_t;
 
+// sets the options a new font is loaded with and points the scripts that
+// use its name at it. Only new fonts take the options, the glyphs of a
+// loaded one may already be in the atlas
+static void add_font( NVGcontext* p_ctx, const char* p_name, int font, uint32_t flags ) {
+  if ( font < 0 ) return;
+  if ( (flags & FONT_FLAG_SDF) && !nvgFontSDF(p_ctx, font, 1) ) {
+    send_puts("distance field fonts are not supported, drawing it normally");
+  }
+  font_loaded( p_name, font );
+}
+
 void receive_load_font_file( int* p_msg_length, driver_data_t* p_data ) {
   NVGcontext* p_ctx = p_data->p_ctx;
 
@@ -583,10 +722,16 @@ void receive_load_font_file( int* p_msg_length, driver_data_t* p_data ) {
   void* p_path = malloc(font_info.data_length);
   read_bytes_down( p_path, font_info.data_length, p_msg_length);
 
-  // only load the font if it is not already loaded!
-  if (nvgFindFont(p_ctx, p_name) < 0) {
-    nvgCreateFont(p_ctx, p_name, p_path);
+  // only load the font if it is not already loaded! Large files are mapped,
+  // not read, so only the pages glyphs are made from take memory
+  int font = nvgFindFont(p_ctx, p_name);
+  if (font < 0) {
+    add_font( p_ctx, p_name, nvgCreateFont(p_ctx, p_name, p_path), font_info.flags );
+  } else {
+    // sent again, so it is wanted after all if a free was waiting
+    font_loaded( p_name, font );
   }
+  font_miss_answered(p_name);
 
   free(p_name);
   free(p_path);
@@ -604,13 +749,19 @@ void receive_load_font_blob( int* p_msg_length, driver_data_t* p_data ) {
   void* p_name = malloc(font_info.name_length);
   read_bytes_down( p_name, font_info.name_length, p_msg_length);
 
-  void* p_blob = malloc(font_info.data_length);
-  read_bytes_down( p_blob, font_info.data_length, p_msg_length);
-
-  // only load the font if it is not already loaded!
-  if (nvgFindFont(p_ctx, p_name) < 0) {
-    nvgCreateFontMem(p_ctx, p_name, p_blob, font_info.data_length, true);
+  // only load the font if it is not already loaded! The blob is read
+  // straight into the buffer the font keeps, or skipped if it is loaded
+  int font = nvgFindFont(p_ctx, p_name);
+  if (font < 0) {
+    void* p_blob = malloc(font_info.data_length);
+    read_bytes_down( p_blob, font_info.data_length, p_msg_length);
+    add_font( p_ctx, p_name, nvgCreateFontMem(p_ctx, p_name, p_blob, font_info.data_length, true),
+              font_info.flags );
+  } else {
+    skip_bytes_down( font_info.data_length, p_msg_length );
+    font_loaded( p_name, font );
   }
+  font_miss_answered(p_name);
 
   free(p_name);
 }
@@ -643,7 +794,7 @@ bool dispatch_message( int msg_length, driver_data_t* p_data ) {
     case CMD_CLEAR_GRAPH:     receive_clear( &msg_length, p_data );           render = true; break;
     case CMD_SET_ROOT:        receive_set_root( &msg_length, p_data );        render = true; break;
 
-    case CMD_CLEAR_COLOR:     receive_clear_color( &msg_length );             render = true; break;
+    case CMD_CLEAR_COLOR:     receive_clear_color( &msg_length, p_data );     render = true; break;
 
     // case CMD_INPUT:           receive_input( &msg_length, p_data );           break;
 
@@ -652,12 +803,18 @@ bool dispatch_message( int msg_length, driver_data_t* p_data ) {
     // font handling
     case CMD_LOAD_FONT_FILE:  receive_load_font_file( &msg_length, p_data );  render = true; break;
     case CMD_LOAD_FONT_BLOB:  receive_load_font_blob( &msg_length, p_data );  render = true; break;
-    // case CMD_FREE_FONT:       receive_free_font( &msg_length, p_data );       break;
+    case CMD_PREWARM_FONT:    receive_prewarm_font( &msg_length, p_data );    break;
+    case CMD_FREE_FONT:       receive_free_font( &msg_length, p_data );       render = true; break;
+    case CMD_MEASURE_TEXT:    receive_measure_text( &msg_length, p_data );    break;
 
     // the next two are in texture.c
+    case CMD_NEW_TX_ID:       receive_new_tx_id( &msg_length, p_data );       render = true; break;
     case CMD_PUT_TX_BLOB:     receive_put_tx_blob( &msg_length, p_data );     render = true; break;
-    // case CMD_PUT_TX_RAW:      receive_put_tx_raw( &msg_length, p_data );      render = true; break;
+    case CMD_PUT_TX_RAW:      receive_put_tx_pixels( &msg_length, p_data );   render = true; break;
+    case CMD_PUT_TX_KTX:      receive_put_tx_ktx( &msg_length, p_data );      render = true; break;
+    case CMD_PUT_TX_SUB:      receive_put_tx_sub( &msg_length, p_data );      render = true; break;
     case CMD_FREE_TX_ID:      receive_free_tx_id( &msg_length, p_data );      break;
+    case CMD_RELEASE_TX_ID:   receive_release_tx_id( &msg_length, p_data );   break;
 
     // the next set are in text.c
     // case CMD_PUT_FONT:        receive_put_font_atlas( &msg_length, p_data );  render = true; break;
@@ -674,9 +831,7 @@ bool dispatch_message( int msg_length, driver_data_t* p_data ) {
   if ( msg_length > 0 ) {
     sprintf( buff, "WARNING Excess message bytes! %d", msg_length );
     send_puts( buff );
-    void* p = malloc(msg_length);
-    read_bytes_down( p, msg_length, &msg_length);
-    free(p);
+    skip_bytes_down( msg_length, &msg_length );
   }
 
   sprintf(buff, "end dispatch_message %d", msg_id);
@@ -719,6 +874,12 @@ bool handle_stdio_in( driver_data_t* p_data ) {
     time_remaining = end_time - get_time_stamp();
   }
 
+  // pick up textures that finished decoding in the background
+  redraw = upload_decoded_tx( p_data, false ) || redraw;
+
+  // get glyphs the app said it will draw into the atlas before it does
+  prewarm_glyphs( p_data, false );
+
   // return false to not cause a redraw
   return redraw;
 }
@@ -13,17 +13,77 @@
 #include <stdbool.h>
 #endif
 
+// messages coming down from the caller
+#define   CMD_RENDER_GRAPH          0x01
+#define   CMD_CLEAR_GRAPH           0x02
+#define   CMD_SET_ROOT              0x03
+
+#define   CMD_CLEAR_COLOR           0x05
+
+// #define   CMD_CACHE_LOAD            0x03
+// #define   CMD_CACHE_RELEASE         0x04
+
+#define   CMD_INPUT                 0x0A
+
+#define   CMD_QUIT                  0x20
+#define   CMD_QUERY_STATS           0x21
+#define   CMD_RESHAPE               0x22
+#define   CMD_POSITION              0x23
+#define   CMD_FOCUS                 0x24
+#define   CMD_ICONIFY               0x25
+#define   CMD_MAXIMIZE              0x26
+#define   CMD_RESTORE               0x27
+#define   CMD_SHOW                  0x28
+#define   CMD_HIDE                  0x29
+
+// #define   CMD_NEW_DL_ID             0x30
+// #define   CMD_FREE_DL_ID            0x31
+
+#define   CMD_NEW_TX_ID             0x32
+#define   CMD_FREE_TX_ID            0x33
+#define   CMD_PUT_TX_BLOB           0x34
+#define   CMD_PUT_TX_RAW            0x35
+#define   CMD_PUT_TX_KTX            0x36
+
+
+#define   CMD_LOAD_FONT_FILE        0X37
+#define   CMD_LOAD_FONT_BLOB        0X38
+#define   CMD_FREE_FONT             0X39
+
+#define   CMD_PUT_TX_SUB            0x3A
+
+#define   CMD_PREWARM_FONT          0x3B
+#define   CMD_MEASURE_TEXT          0x3C
+#define   CMD_RELEASE_TX_ID         0x3D
+
+// here to test recovery
+#define   CMD_CRASH                 0xFE
+
 bool read_bytes_down(void* p_buff, int bytes_to_read,
                      int* p_bytes_to_remaining);
+void skip_bytes_down(int bytes_to_skip, int* p_bytes_to_remaining);
 
 // basic events to send up to the caller
 void send_puts(const char* msg);
 void send_write(const char* msg);
 void send_inspect(void* data, int length);
+void send_text_metrics(void* data, int length);
+
+typedef struct
+{
+  uint32_t  sent;             // misses sent up to be loaded
+  uint32_t  suppressed;       // repeats of a miss still waiting on its reply
+  uint32_t  retried;          // misses sent again after MISS_RETRY_NS
+} miss_stats_t;
 
 void send_static_texture_miss(const char* key);
 void send_dynamic_texture_miss(const char* key);
 void send_font_miss(const char* key);
+void texture_miss_answered(const char* key);
+void font_miss_answered(const char* key);
+void send_tx_handle_unused(uint32_t handle, const char* key);
+void send_tx_handle_released(uint32_t handle);
+void get_miss_stats(miss_stats_t* p_stats);
 void send_key(int key, int scancode, int action, int mods);
 void send_codepoint(unsigned int codepoint, int mods);
 void send_cursor_pos(float xpos, float ypos);
@@ -40,7 +100,9 @@ void send_draw_ready(unsigned int id);
 void* comms_thread(void* window);
 
 void test_endian();
+void set_comms_fds(int in_fd, int out_fd);
 
+bool dispatch_message(int msg_length, driver_data_t* p_data);
 bool handle_stdio_in(driver_data_t* p_data);
 
 #endif
@@ -0,0 +1,122 @@
+/*
+Background image decoding for texture blobs. See decode.h
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "nanovg/stb_image.h"
+#include "capture.h"
+#include "decode.h"
+#include "ktx.h"
+
+// stb_image keeps its load settings and its failure reason in globals. The
+// driver never changes the settings and never reads the failure reason, so
+// running loads on several threads at once is fine.
+
+// leave a core for the render thread. Decoding is bursty, so a few
+// workers are plenty
+#define MAX_DECODE_THREADS    4
+
+static pthread_mutex_t decode_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_ready  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  all_done    = PTHREAD_COND_INITIALIZER;
+
+static bool          started = false;
+static int           pending = 0;     // queued or being decoded
+static decode_job_t* p_queue = NULL;
+static decode_job_t* p_queue_tail = NULL;
+static decode_job_t* p_done = NULL;
+static decode_job_t* p_done_tail = NULL;
+
+//---------------------------------------------------------
+static void append( decode_job_t** pp_head, decode_job_t** pp_tail, decode_job_t* p_job ) {
+  p_job->p_next = NULL;
+  if ( *pp_tail ) (*pp_tail)->p_next = p_job;
+  else *pp_head = p_job;
+  *pp_tail = p_job;
+}
+
+//---------------------------------------------------------
+static void* decode_worker( void* p_arg ) {
+  while ( true ) {
+    pthread_mutex_lock(&decode_lock);
+    while ( p_queue == NULL ) {
+      pthread_cond_wait(&work_ready, &decode_lock);
+    }
+    decode_job_t* p_job = p_queue;
+    p_queue = p_job->p_next;
+    if ( p_queue == NULL ) p_queue_tail = NULL;
+    pthread_mutex_unlock(&decode_lock);
+
+    // KTX files only get here when the GPU can't take their blocks.
+    // ktx_decode_rgba mallocs, which is also what stbi_image_free expects
+    int      channels;
+    uint64_t start = monotonic_ns();
+    if ( is_ktx(p_job->p_file, p_job->file_size) ) {
+      p_job->p_pixels = ktx_decode_rgba(p_job->p_file, p_job->file_size,
+                                        &p_job->width, &p_job->height);
+    } else {
+      p_job->p_pixels = stbi_load_from_memory(p_job->p_file, p_job->file_size,
+                                              &p_job->width, &p_job->height, &channels, 4);
+    }
+    p_job->decode_ns = monotonic_ns() - start;
+    free(p_job->p_file);
+    p_job->p_file = NULL;
+
+    pthread_mutex_lock(&decode_lock);
+    append(&p_done, &p_done_tail, p_job);
+    if ( --pending == 0 ) pthread_cond_broadcast(&all_done);
+    pthread_mutex_unlock(&decode_lock);
+  }
+  return NULL;
+}
+
+static void start_workers() {
+  long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+  int  threads = cores > 1 ? cores - 1 : 1;
+  if ( threads > MAX_DECODE_THREADS ) threads = MAX_DECODE_THREADS;
+
+  for ( int i = 0; i < threads; i++ ) {
+    pthread_t thread;
+    if ( pthread_create(&thread, NULL, decode_worker, NULL) == 0 ) {
+      pthread_detach(thread);
+    }
+  }
+  started = true;
+}
+
+//=============================================================================
+
+//---------------------------------------------------------
+void decode_submit( decode_job_t* p_job ) {
+  pthread_mutex_lock(&decode_lock);
+  if ( !started ) start_workers();
+  append(&p_queue, &p_queue_tail, p_job);
+  pending++;
+  pthread_cond_signal(&work_ready);
+  pthread_mutex_unlock(&decode_lock);
+}
+
+//---------------------------------------------------------
+decode_job_t* decode_take_done( bool wait ) {
+  pthread_mutex_lock(&decode_lock);
+  while ( wait && pending > 0 ) {
+    pthread_cond_wait(&all_done, &decode_lock);
+  }
+  decode_job_t* p_jobs = p_done;
+  p_done = p_done_tail = NULL;
+  pthread_mutex_unlock(&decode_lock);
+  return p_jobs;
+}
+
+//---------------------------------------------------------
+void decode_free_job( decode_job_t* p_job ) {
+  if ( p_job->p_pixels ) stbi_image_free(p_job->p_pixels);
+  free(p_job->p_file);
+  free(p_job->p_key);
+  free(p_job);
+}
@@ -0,0 +1,43 @@
+/*
+Background image decoding for texture blobs
+
+Encoded PNG/JPEG files, and KTX files the GPU can't use, are decoded to RGBA by a small pool of worker
+threads, so a large image doesn't stall the render thread. The render
+thread collects finished jobs between frames and does the GL upload
+itself. Nothing here touches nanovg or GL.
+*/
+
+#ifndef _DECODE_H
+#define _DECODE_H
+
+#include <stdint.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+typedef struct decode_job_s
+{
+  struct decode_job_s* p_next;
+  char*          p_key;
+  uint32_t       seq;         // set by the caller to spot superseded jobs
+  void*          p_file;      // encoded image. freed by the worker
+  uint32_t       file_size;
+  uint32_t       flags;       // TX_FLAG_* to create the texture with
+  uint64_t       hash;        // of the file, to find the texture by once it is made
+  unsigned char* p_pixels;    // decoded RGBA, NULL on failure
+  int            width;
+  int            height;
+  uint64_t       decode_ns;
+} decode_job_t;
+
+// queues a job. The workers are started on first use
+void decode_submit( decode_job_t* p_job );
+
+// returns the finished jobs in the order they completed, or NULL. With
+// wait set it first blocks until every submitted job is done
+decode_job_t* decode_take_done( bool wait );
+
+void decode_free_job( decode_job_t* p_job );
+
+#endif
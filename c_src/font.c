@@ -0,0 +1,443 @@
+/*
+Font slots, freeing and glyph prewarming. See font.h
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nanovg/nanovg.h"
+#include "capture.h"
+#include "comms.h"
+#include "font.h"
+#include "uthash.h"
+
+// slots are added in blocks of this many
+#define FONT_SLOT_BLOCK       16
+
+typedef struct
+{
+  char*           p_name;
+  uint32_t        slot;
+  int             id;         // nanovg font, -1 until it is loaded
+  uint32_t        refs;       // stored scripts using it
+  bool            free_pending;
+  UT_hash_handle  hh;
+} font_slot_t;
+
+static font_slot_t*   p_slot_names = NULL;   // by name
+static font_slot_t**  pp_slots = NULL;       // by slot
+static uint32_t       num_slots = 0;
+static uint32_t       max_slots = 0;
+static uint32_t       fonts_freed = 0;
+
+// time one pass may spend rasterizing. The main loop makes a pass each time
+// it looks for messages, so a long request is spread over many of them
+#define PREWARM_BUDGET_NS     2000000ULL
+
+// codepoints rasterized between looks at the clock
+#define PREWARM_CHUNK         16
+
+// how long glyphs wait for their font. A name no font is put under would
+// otherwise keep its request queued, and checked every pass, for good
+#define PREWARM_FONT_WAIT_NS  10000000000ULL
+
+typedef struct prewarm_s
+{
+  struct prewarm_s* p_next;
+  char*             p_name;
+  uint32_t          num_styles;
+  float*            p_styles;     // size, blur pairs
+  char*             p_text;       // utf-8
+  uint32_t          text_length;
+  uint32_t          style;        // the pair being worked on
+  uint32_t          offset;       // how far into the text it got
+  uint64_t          queued_ns;    // when it came, to give up on a font that doesn't
+} prewarm_t;
+
+static prewarm_t*       p_prewarm = NULL;
+static prewarm_t*       p_prewarm_tail = NULL;
+static prewarm_stats_t  prewarm_stats = {0};
+
+//=============================================================================
+// font slots
+
+static void drop_prewarm( const char* p_name );
+
+uint32_t ref_font_slot( NVGcontext* p_ctx, const char* p_name ) {
+  font_slot_t* p_slot;
+  HASH_FIND_STR(p_slot_names, p_name, p_slot);
+  if ( p_slot ) {
+    p_slot->refs++;
+    return p_slot->slot;
+  }
+
+  if ( num_slots == max_slots ) {
+    max_slots += FONT_SLOT_BLOCK;
+    pp_slots = realloc(pp_slots, max_slots * sizeof(font_slot_t*));
+  }
+
+  int name_size = strlen(p_name) + 1;
+  p_slot = malloc(sizeof(font_slot_t) + name_size);
+  p_slot->p_name = (void*)p_slot + sizeof(font_slot_t);
+  memcpy(p_slot->p_name, p_name, name_size);
+  p_slot->slot = num_slots;
+  p_slot->id = nvgFindFont(p_ctx, p_name);
+  p_slot->refs = 1;
+  p_slot->free_pending = false;
+  HASH_ADD_KEYPTR(hh, p_slot_names, p_slot->p_name, name_size - 1, p_slot);
+  pp_slots[num_slots++] = p_slot;
+  return p_slot->slot;
+}
+
+int use_font_slot( uint32_t slot, const char** pp_name ) {
+  if ( slot >= num_slots ) {
+    *pp_name = NULL;
+    return -1;
+  }
+  *pp_name = pp_slots[slot]->p_name;
+  return pp_slots[slot]->id;
+}
+
+void font_loaded( const char* p_name, int id ) {
+  font_slot_t* p_slot;
+  HASH_FIND_STR(p_slot_names, p_name, p_slot);
+  if ( p_slot ) {
+    p_slot->id = id;
+    p_slot->free_pending = false;
+  }
+}
+
+static void unload_font( NVGcontext* p_ctx, const char* p_name ) {
+  int id = nvgFindFont(p_ctx, p_name);
+  if ( id >= 0 && nvgDeleteFont(p_ctx, id) ) fonts_freed++;
+  drop_prewarm( p_name );
+}
+
+void unref_font_slot( NVGcontext* p_ctx, uint32_t slot ) {
+  if ( slot >= num_slots ) return;
+  font_slot_t* p_slot = pp_slots[slot];
+  if ( p_slot->refs > 0 && --p_slot->refs == 0 && p_slot->free_pending ) {
+    unload_font( p_ctx, p_slot->p_name );
+    p_slot->id = -1;
+    p_slot->free_pending = false;
+  }
+}
+
+//---------------------------------------------------------
+void receive_free_font( int* p_msg_length, driver_data_t* p_data ) {
+  uint32_t name_length;
+  read_bytes_down( &name_length, sizeof(uint32_t), p_msg_length );
+  char* p_name = malloc(name_length);
+  read_bytes_down( p_name, name_length, p_msg_length );
+
+  font_slot_t* p_slot;
+  HASH_FIND_STR(p_slot_names, p_name, p_slot);
+  if ( p_slot && p_slot->refs > 0 ) {
+    // scripts still draw with it. It goes with the last of them
+    p_slot->free_pending = true;
+  } else {
+    unload_font( p_data->p_ctx, p_name );
+    if ( p_slot ) p_slot->id = -1;
+  }
+
+  free(p_name);
+}
+
+void get_font_stats( NVGcontext* p_ctx, font_stats_t* p_stats ) {
+  int loaded, bytes;
+  nvgFontStats(p_ctx, &loaded, &bytes);
+  p_stats->loaded = loaded;
+  p_stats->bytes = bytes;
+  p_stats->freed = fonts_freed;
+}
+
+//=============================================================================
+// prewarming
+
+//---------------------------------------------------------
+static void free_prewarm( prewarm_t* p_job ) {
+  free(p_job->p_name);
+  free(p_job->p_styles);
+  free(p_job->p_text);
+  free(p_job);
+}
+
+// a freed font's glyphs would wait for it forever
+static void drop_prewarm( const char* p_name ) {
+  prewarm_t** pp_job = &p_prewarm;
+  prewarm_t*  p_last = NULL;
+  while ( *pp_job ) {
+    prewarm_t* p_job = *pp_job;
+    if ( strcmp(p_job->p_name, p_name) == 0 ) {
+      *pp_job = p_job->p_next;
+      if ( p_prewarm_tail == p_job ) p_prewarm_tail = p_last;
+      free_prewarm(p_job);
+    } else {
+      p_last = p_job;
+      pp_job = &p_job->p_next;
+    }
+  }
+}
+
+// byte offset of the end of the next count codepoints
+static uint32_t utf8_advance( const char* p_text, uint32_t length, uint32_t offset, int count ) {
+  while ( offset < length ) {
+    // continuation bytes belong to the codepoint before them
+    if ( (p_text[offset] & 0xC0) != 0x80 && count-- == 0 ) break;
+    offset++;
+  }
+  return offset;
+}
+
+//---------------------------------------------------------
+typedef struct __attribute__((__packed__))
+{
+  uint32_t name_length;
+  uint32_t num_styles;
+  uint32_t text_length;
+} prewarm_header_t;
+
+void receive_prewarm_font( int* p_msg_length, driver_data_t* p_data ) {
+  prewarm_header_t header;
+  read_bytes_down( &header, sizeof(prewarm_header_t), p_msg_length );
+
+  prewarm_t* p_job = calloc(1, sizeof(prewarm_t));
+  p_job->p_name = malloc(header.name_length);
+  read_bytes_down( p_job->p_name, header.name_length, p_msg_length );
+
+  p_job->num_styles = header.num_styles;
+  p_job->p_styles = malloc(header.num_styles * 2 * sizeof(float));
+  read_bytes_down( p_job->p_styles, header.num_styles * 2 * sizeof(float), p_msg_length );
+
+  p_job->text_length = header.text_length;
+  p_job->p_text = malloc(header.text_length + 1);
+  read_bytes_down( p_job->p_text, header.text_length, p_msg_length );
+  p_job->p_text[header.text_length] = 0;
+
+  if ( header.num_styles == 0 || header.text_length == 0 ) {
+    free_prewarm(p_job);
+    return;
+  }
+
+  // the font is usually sent when a script first uses it. Ask for it now,
+  // the glyphs wait until it is there
+  if ( nvgFindFont(p_data->p_ctx, p_job->p_name) < 0 ) send_font_miss(p_job->p_name);
+
+  p_job->queued_ns = monotonic_ns();
+  if ( p_prewarm_tail ) p_prewarm_tail->p_next = p_job;
+  else p_prewarm = p_job;
+  p_prewarm_tail = p_job;
+  prewarm_stats.queued++;
+}
+
+//---------------------------------------------------------
+void prewarm_glyphs( driver_data_t* p_data, bool all ) {
+  if ( !p_prewarm ) return;
+
+  NVGcontext* p_ctx = p_data->p_ctx;
+  uint64_t start = monotonic_ns();
+  uint64_t now = start;
+
+  prewarm_t** pp_job = &p_prewarm;
+  prewarm_t*  p_last = NULL;
+  while ( *pp_job && (all || now - start < PREWARM_BUDGET_NS) ) {
+    prewarm_t* p_job = *pp_job;
+
+    int font = nvgFindFont(p_ctx, p_job->p_name);
+    if ( font < 0 && now - p_job->queued_ns < PREWARM_FONT_WAIT_NS ) {
+      // wait for the font, the rest may be for fonts that are loaded
+      p_last = p_job;
+      pp_job = &p_job->p_next;
+      continue;
+    }
+
+    bool done = false;
+    if ( font < 0 ) {
+      // it isn't coming
+      prewarm_stats.no_font++;
+      done = true;
+    } else {
+      float size = p_job->p_styles[p_job->style * 2];
+      float blur = p_job->p_styles[p_job->style * 2 + 1];
+      uint32_t end = utf8_advance(p_job->p_text, p_job->text_length, p_job->offset, PREWARM_CHUNK);
+      if ( !nvgTextPrewarm(p_ctx, font, size, blur,
+                           p_job->p_text + p_job->offset, p_job->p_text + end) ) {
+        prewarm_stats.atlas_full++;
+        done = true;
+      } else if ( end < p_job->text_length ) {
+        p_job->offset = end;
+      } else {
+        prewarm_stats.styles++;
+        p_job->offset = 0;
+        done = ++p_job->style >= p_job->num_styles;
+      }
+    }
+
+    if ( done ) {
+      *pp_job = p_job->p_next;
+      if ( p_prewarm_tail == p_job ) p_prewarm_tail = p_last;
+      free_prewarm(p_job);
+    }
+    now = monotonic_ns();
+  }
+
+  prewarm_stats.total_ns += now - start;
+}
+
+//---------------------------------------------------------
+void get_prewarm_stats( prewarm_stats_t* p_stats ) {
+  *p_stats = prewarm_stats;
+}
+
+//=============================================================================
+// text measurement
+
+// rows asked of nvgTextBreakLines at a time
+#define MEASURE_ROWS          16
+
+#define MEASURE_OK            0
+#define MEASURE_NO_FONT       1
+
+typedef struct __attribute__((__packed__))
+{
+  uint32_t  tag;            // sent back with the reply, to match it up
+  uint32_t  name_length;
+  float     size;
+  uint32_t  align;          // NVG_ALIGN_* bits
+  float     wrap_width;     // lines are broken at this width when above 0
+  uint32_t  num_strings;    // each a uint32_t length and the utf-8 bytes
+} measure_header_t;
+
+typedef struct __attribute__((__packed__))
+{
+  uint32_t  tag;
+  uint32_t  status;
+  float     ascender;
+  float     descender;
+  float     line_height;
+  uint32_t  num_strings;
+} measure_reply_t;
+
+typedef struct __attribute__((__packed__))
+{
+  float     width;          // the advance, where the next text would start
+  float     bounds[4];      // xmin, ymin, xmax, ymax
+  uint32_t  num_lines;      // measure_line_t that follow. None without a wrap width
+} measure_string_t;
+
+typedef struct __attribute__((__packed__))
+{
+  uint32_t  start;          // byte offsets of the line in the string
+  uint32_t  end;
+  float     width;
+  float     min_x;
+  float     max_x;
+} measure_line_t;
+
+typedef struct
+{
+  char*     p_data;
+  uint32_t  length;
+  uint32_t  max;
+} measure_buffer_t;
+
+static void measure_append( measure_buffer_t* p_buf, const void* p_data, uint32_t size ) {
+  if ( p_buf->length + size > p_buf->max ) {
+    p_buf->max = (p_buf->length + size) * 2;
+    p_buf->p_data = realloc(p_buf->p_data, p_buf->max);
+  }
+  memcpy(p_buf->p_data + p_buf->length, p_data, size);
+  p_buf->length += size;
+}
+
+//---------------------------------------------------------
+// measures a batch of strings in one font, size and alignment with the
+// same nanovg calls that draw them, and sends the results straight back
+void receive_measure_text( int* p_msg_length, driver_data_t* p_data ) {
+  NVGcontext* p_ctx = p_data->p_ctx;
+
+  measure_header_t header;
+  read_bytes_down( &header, sizeof(measure_header_t), p_msg_length );
+
+  char* p_name = malloc(header.name_length);
+  read_bytes_down( p_name, header.name_length, p_msg_length );
+  int font = nvgFindFont(p_ctx, p_name);
+  free(p_name);
+
+  measure_reply_t reply = { header.tag, MEASURE_OK, 0, 0, 0, 0 };
+  measure_buffer_t out = { NULL, 0, 0 };
+  measure_append( &out, &reply, sizeof(measure_reply_t) );
+
+  if ( font < 0 ) {
+    // the caller loads it and asks again
+    skip_bytes_down( *p_msg_length, p_msg_length );
+    ((measure_reply_t*)out.p_data)->status = MEASURE_NO_FONT;
+    send_text_metrics( out.p_data, out.length );
+    free(out.p_data);
+    return;
+  }
+
+  // measured in a state of its own, between frames
+  nvgSave(p_ctx);
+  nvgReset(p_ctx);
+  nvgFontFaceId(p_ctx, font);
+  nvgFontSize(p_ctx, header.size);
+  nvgTextAlign(p_ctx, header.align);
+  // can't point into packed structures
+  float ascender, descender, line_height, bounds[4];
+  nvgTextMetrics(p_ctx, &ascender, &descender, &line_height);
+  reply.ascender = ascender;
+  reply.descender = descender;
+  reply.line_height = line_height;
+
+  char*     p_text = NULL;
+  uint32_t  max_text = 0;
+  uint32_t  i;
+  for ( i = 0; i < header.num_strings; i++ ) {
+    uint32_t length;
+    if ( !read_bytes_down( &length, sizeof(uint32_t), p_msg_length ) ) break;
+    if ( length > (uint32_t)*p_msg_length ) break;
+    if ( length + 1 > max_text ) {
+      max_text = length + 1;
+      p_text = realloc(p_text, max_text);
+    }
+    read_bytes_down( p_text, length, p_msg_length );
+    const char* p_end = p_text + length;
+
+    measure_string_t string = {0};
+    string.width = nvgTextBounds(p_ctx, 0, 0, p_text, p_end, bounds);
+
+    // the lines are written after the string, which is filled in at the end
+    uint32_t at = out.length;
+    measure_append( &out, &string, sizeof(measure_string_t) );
+
+    if ( header.wrap_width > 0 ) {
+      NVGtextRow rows[MEASURE_ROWS];
+      const char* p_start = p_text;
+      int nrows;
+      while ( (nrows = nvgTextBreakLines(p_ctx, p_start, p_end, header.wrap_width,
+                                         rows, MEASURE_ROWS)) ) {
+        for ( int r = 0; r < nrows; r++ ) {
+          measure_line_t line = {
+            rows[r].start - p_text, rows[r].end - p_text,
+            rows[r].width, rows[r].minx, rows[r].maxx
+          };
+          measure_append( &out, &line, sizeof(measure_line_t) );
+          string.num_lines++;
+        }
+        p_start = rows[nrows - 1].next;
+      }
+      nvgTextBoxBounds(p_ctx, 0, 0, header.wrap_width, p_text, p_end, bounds);
+    }
+    memcpy(string.bounds, bounds, sizeof(bounds));
+    memcpy(out.p_data + at, &string, sizeof(measure_string_t));
+  }
+  nvgRestore(p_ctx);
+  free(p_text);
+
+  // strings cut off by a short message aren't in the reply
+  reply.num_strings = i;
+  memcpy(out.p_data, &reply, sizeof(measure_reply_t));
+  send_text_metrics( out.p_data, out.length );
+  free(out.p_data);
+}
@@ -0,0 +1,85 @@
+/*
+Font slots, options, freeing and glyph prewarming
+
+Scripts name their fonts by string. When a script is stored, each name is
+given a slot once, and the script is rewritten to use the slot, so drawing
+doesn't look the font up by name every frame. A slot follows its font as it
+is loaded and freed.
+
+Slots count the stored scripts that use them. CMD_FREE_FONT unloads a font
+right away if no script uses it, or else once the last of them is deleted.
+Its data is freed and the atlas space only its glyphs took is reused.
+
+Fonts are loaded with a set of FONT_FLAG_* bits. Scenes send the fonts,
+sizes and characters they are about to show with CMD_PREWARM_FONT. The
+glyphs are rasterized into the font atlas a few at a time between frames, so
+the first frame that draws the text doesn't stall on stb_truetype and the
+atlas upload.
+
+CMD_MEASURE_TEXT measures strings for layout on the Elixir side with the
+same fontstash metrics the text is drawn with. Only used on the render thread.
+*/
+
+#ifndef _FONT_H
+#define _FONT_H
+
+#include <stdint.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+#include "types.h"
+
+// flags sent with CMD_LOAD_FONT_FILE and CMD_LOAD_FONT_BLOB
+#define FONT_FLAG_SDF         0x01    // glyphs are distance fields, scaled to every size and blur
+
+typedef struct
+{
+  uint32_t  loaded;     // fonts loaded now
+  uint32_t  bytes;      // memory their data and glyph caches take
+  uint32_t  freed;      // fonts unloaded since the start
+} font_stats_t;
+
+typedef struct
+{
+  uint32_t  queued;     // prewarm requests received
+  uint32_t  styles;     // size and blur pairs finished
+  uint32_t  atlas_full; // requests cut short because the atlas filled up
+  uint32_t  no_font;    // requests dropped because their font never came
+  uint64_t  total_ns;   // time spent rasterizing them
+} prewarm_stats_t;
+
+// slot for the font name, made the first time the name is seen. Each call
+// adds a reference, for a script that uses it
+uint32_t ref_font_slot( NVGcontext* p_ctx, const char* p_name );
+
+// drops a reference. A font that was freed while in use is unloaded with
+// the last one
+void unref_font_slot( NVGcontext* p_ctx, uint32_t slot );
+
+// nanovg id of the slot's font, or -1 if it isn't loaded. pp_name gets the
+// font's name, to ask for it
+int use_font_slot( uint32_t slot, const char** pp_name );
+
+// a font was loaded under this name, or sent again while waiting to be freed
+void font_loaded( const char* p_name, int id );
+
+void receive_free_font( int* p_msg_length, driver_data_t* p_data );
+
+void get_font_stats( NVGcontext* p_ctx, font_stats_t* p_stats );
+
+void receive_prewarm_font( int* p_msg_length, driver_data_t* p_data );
+
+// rasterizes queued glyphs until the time budget for this pass is used up,
+// or all of them with all set. Glyphs of fonts that aren't loaded yet wait
+// for them
+void prewarm_glyphs( driver_data_t* p_data, bool all );
+
+void get_prewarm_stats( prewarm_stats_t* p_stats );
+
+// replies to CMD_MEASURE_TEXT with the widths, bounds and line breaks of a
+// batch of strings
+void receive_measure_text( int* p_msg_length, driver_data_t* p_data );
+
+#endif
@@ -0,0 +1,322 @@
+/*
+KTX containers and the ETC1/ETC2 software decoder. See ktx.h
+
+Formats are described in the OpenGL ES 3.0 specification, appendix C.
+ETC2 RGB is a superset of ETC1: the bit patterns that overflow in ETC1's
+differential mode select the T, H and planar modes.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ktx.h"
+
+#define KTX_HEADER_SIZE     64
+#define KTX_ENDIAN_REF      0x04030201
+
+static const unsigned char ktx_identifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// intensity modifiers of the individual and differential modes
+static const int etc_modifiers[8][4] = {
+  {2, 8, -2, -8},       {5, 17, -5, -17},     {9, 29, -9, -29},     {13, 42, -13, -42},
+  {18, 60, -18, -60},   {24, 80, -24, -80},   {33, 106, -33, -106}, {47, 183, -47, -183}
+};
+
+// distances of the T and H modes
+static const int etc_distances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int eac_modifiers[16][8] = {
+  {-3, -6, -9, -15, 2, 5, 8, 14},   {-3, -7, -10, -13, 2, 6, 9, 12},
+  {-2, -5, -8, -13, 1, 4, 7, 12},   {-2, -4, -6, -13, 1, 3, 5, 12},
+  {-3, -6, -8, -12, 2, 5, 7, 11},   {-3, -7, -9, -11, 2, 6, 8, 10},
+  {-4, -7, -8, -11, 3, 6, 7, 10},   {-3, -5, -8, -11, 2, 4, 7, 10},
+  {-2, -6, -8, -10, 1, 5, 7, 9},    {-2, -5, -8, -10, 1, 4, 7, 9},
+  {-2, -4, -8, -10, 1, 3, 7, 9},    {-2, -5, -7, -10, 1, 4, 6, 9},
+  {-3, -4, -7, -10, 2, 3, 6, 9},    {-1, -2, -3, -10, 0, 1, 2, 9},
+  {-4, -6, -8, -9, 3, 5, 7, 8},     {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+//---------------------------------------------------------
+static uint32_t read_u32( const unsigned char* p, bool swap ) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(uint32_t));
+  if ( swap ) {
+    v = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+  }
+  return v;
+}
+
+static int block_bytes( uint32_t format ) {
+  return format == KTX_ETC2_RGBA8_EAC ? 16 : 8;
+}
+
+//---------------------------------------------------------
+bool is_ktx( const void* p_file, uint32_t file_size ) {
+  return file_size >= sizeof(ktx_identifier) &&
+         memcmp(p_file, ktx_identifier, sizeof(ktx_identifier)) == 0;
+}
+
+//---------------------------------------------------------
+bool ktx_parse( const void* p_file, uint32_t file_size, ktx_t* p_ktx ) {
+  const unsigned char* p = p_file;
+  if ( file_size < KTX_HEADER_SIZE || !is_ktx(p_file, file_size) ) return false;
+
+  bool swap = read_u32(p + 12, false) != KTX_ENDIAN_REF;
+  uint32_t gl_type    = read_u32(p + 16, swap);
+  uint32_t format     = read_u32(p + 28, swap);
+  uint32_t width      = read_u32(p + 36, swap);
+  uint32_t height     = read_u32(p + 40, swap);
+  uint32_t depth      = read_u32(p + 44, swap);
+  uint32_t elements   = read_u32(p + 48, swap);
+  uint32_t faces      = read_u32(p + 52, swap);
+  uint32_t levels     = read_u32(p + 56, swap);
+  uint32_t kv_bytes   = read_u32(p + 60, swap);
+
+  // only compressed, plain 2D textures
+  if ( gl_type != 0 || depth != 0 || elements != 0 || faces != 1 ) return false;
+  if ( format != KTX_ETC1_RGB8 && format != KTX_ETC2_RGB8 && format != KTX_ETC2_RGBA8_EAC ) {
+    return false;
+  }
+  if ( width == 0 || height == 0 || width > 0x8000 || height > 0x8000 ) return false;
+  if ( levels == 0 ) levels = 1;
+  if ( levels > KTX_MAX_LEVELS ) levels = KTX_MAX_LEVELS;
+
+  p_ktx->format = format;
+  p_ktx->width  = width;
+  p_ktx->height = height;
+  p_ktx->levels = 0;
+
+  uint64_t offset = (uint64_t)KTX_HEADER_SIZE + kv_bytes;
+  uint32_t w = width, h = height;
+  for ( uint32_t i = 0; i < levels; i++ ) {
+    if ( offset + 4 > file_size ) break;
+    uint32_t size = read_u32(p + offset, swap);
+    offset += 4;
+
+    uint64_t needed = (uint64_t)((w + 3) / 4) * ((h + 3) / 4) * block_bytes(format);
+    if ( size < needed || offset + size > file_size ) break;
+
+    p_ktx->p_level[i]    = p + offset;
+    p_ktx->level_size[i] = size;
+    p_ktx->levels++;
+
+    offset += (size + 3) & ~3u;
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+
+  return p_ktx->levels > 0;
+}
+
+//=============================================================================
+// block decoding. Each decodes one 4x4 block to RGBA, rows of 4 pixels
+
+static uint8_t clamp_u8( int v ) {
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static int extend_4( int v ) { return (v << 4) | v; }
+static int extend_5( int v ) { return (v << 3) | (v >> 2); }
+static int extend_6( int v ) { return (v << 2) | (v >> 4); }
+static int extend_7( int v ) { return (v << 1) | (v >> 6); }
+
+// the 2-bit pixel indexes are stored column by column. LSBs in the low
+// 16 bits, MSBs in the high 16
+static int pixel_index( uint32_t lo, int x, int y ) {
+  int k = x * 4 + y;
+  return (((lo >> (k + 16)) & 1) << 1) | ((lo >> k) & 1);
+}
+
+static void set_rgb( unsigned char* p_out, int x, int y, int r, int g, int b ) {
+  unsigned char* p = p_out + (y * 4 + x) * 4;
+  p[0] = clamp_u8(r);
+  p[1] = clamp_u8(g);
+  p[2] = clamp_u8(b);
+  p[3] = 255;
+}
+
+//---------------------------------------------------------
+static void decode_planar( const unsigned char* s, unsigned char* p_out ) {
+  int ro = extend_6((s[0] >> 1) & 0x3F);
+  int go = extend_7(((s[0] & 1) << 6) | ((s[1] >> 1) & 0x3F));
+  int bo = extend_6(((s[1] & 1) << 5) | (s[2] & 0x18) | ((s[2] & 3) << 1) | (s[3] >> 7));
+  int rh = extend_6(((s[3] >> 1) & 0x3E) | (s[3] & 1));
+  int gh = extend_7(s[4] >> 1);
+  int bh = extend_6(((s[4] & 1) << 5) | (s[5] >> 3));
+  int rv = extend_6(((s[5] & 7) << 3) | (s[6] >> 5));
+  int gv = extend_7(((s[6] & 0x1F) << 2) | (s[7] >> 6));
+  int bv = extend_6(s[7] & 0x3F);
+
+  for ( int y = 0; y < 4; y++ ) {
+    for ( int x = 0; x < 4; x++ ) {
+      set_rgb(p_out, x, y,
+        (x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2,
+        (x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2,
+        (x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2);
+    }
+  }
+}
+
+//---------------------------------------------------------
+// T and H modes pick from four paint colors made from two base colors
+static void decode_th( const unsigned char* s, uint32_t lo, bool h_mode, unsigned char* p_out ) {
+  int c[2][3];
+  int d;
+
+  if ( h_mode ) {
+    c[0][0] = (s[0] >> 3) & 0xF;
+    c[0][1] = ((s[0] & 7) << 1) | ((s[1] >> 4) & 1);
+    c[0][2] = (s[1] & 8) | ((s[1] & 3) << 1) | (s[2] >> 7);
+    c[1][0] = (s[2] >> 3) & 0xF;
+    c[1][1] = ((s[2] & 7) << 1) | (s[3] >> 7);
+    c[1][2] = (s[3] >> 3) & 0xF;
+    d = (s[3] & 4) | ((s[3] & 1) << 1);
+  } else {
+    c[0][0] = ((s[0] & 0x18) >> 1) | (s[0] & 3);
+    c[0][1] = s[1] >> 4;
+    c[0][2] = s[1] & 0xF;
+    c[1][0] = s[2] >> 4;
+    c[1][1] = s[2] & 0xF;
+    c[1][2] = s[3] >> 4;
+    d = ((s[3] >> 1) & 6) | (s[3] & 1);
+  }
+  for ( int i = 0; i < 2; i++ ) {
+    for ( int j = 0; j < 3; j++ ) c[i][j] = extend_4(c[i][j]);
+  }
+
+  int paint[4][3];
+  if ( h_mode ) {
+    // the lowest distance bit is the order of the base colors
+    int v0 = (c[0][0] << 16) | (c[0][1] << 8) | c[0][2];
+    int v1 = (c[1][0] << 16) | (c[1][1] << 8) | c[1][2];
+    d = etc_distances[d | (v0 >= v1 ? 1 : 0)];
+    for ( int j = 0; j < 3; j++ ) {
+      paint[0][j] = c[0][j] + d;
+      paint[1][j] = c[0][j] - d;
+      paint[2][j] = c[1][j] + d;
+      paint[3][j] = c[1][j] - d;
+    }
+  } else {
+    d = etc_distances[d];
+    for ( int j = 0; j < 3; j++ ) {
+      paint[0][j] = c[0][j];
+      paint[1][j] = c[1][j] + d;
+      paint[2][j] = c[1][j];
+      paint[3][j] = c[1][j] - d;
+    }
+  }
+
+  for ( int y = 0; y < 4; y++ ) {
+    for ( int x = 0; x < 4; x++ ) {
+      int* p = paint[pixel_index(lo, x, y)];
+      set_rgb(p_out, x, y, p[0], p[1], p[2]);
+    }
+  }
+}
+
+//---------------------------------------------------------
+static void decode_etc( const unsigned char* s, bool etc2, unsigned char* p_out ) {
+  uint32_t hi = ((uint32_t)s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
+  uint32_t lo = ((uint32_t)s[4] << 24) | (s[5] << 16) | (s[6] << 8) | s[7];
+  int base[2][3];
+
+  if ( hi & 2 ) {
+    // differential: a 5 bit color and a 3 bit signed offset to the second
+    int r = hi >> 27, g = (hi >> 19) & 0x1F, b = (hi >> 11) & 0x1F;
+    int dr = ((int)(hi << 5) >> 29);
+    int dg = ((int)(hi << 13) >> 29);
+    int db = ((int)(hi << 21) >> 29);
+
+    // ETC1 wraps around where ETC2 switches modes
+    if ( etc2 ) {
+      if ( r + dr < 0 || r + dr > 31 ) { decode_th(s, lo, false, p_out); return; }
+      if ( g + dg < 0 || g + dg > 31 ) { decode_th(s, lo, true, p_out); return; }
+      if ( b + db < 0 || b + db > 31 ) { decode_planar(s, p_out); return; }
+    }
+
+    base[0][0] = extend_5(r);
+    base[0][1] = extend_5(g);
+    base[0][2] = extend_5(b);
+    base[1][0] = extend_5((r + dr) & 0x1F);
+    base[1][1] = extend_5((g + dg) & 0x1F);
+    base[1][2] = extend_5((b + db) & 0x1F);
+  } else {
+    // individual: two 4 bit colors
+    base[0][0] = extend_4(hi >> 28);
+    base[1][0] = extend_4((hi >> 24) & 0xF);
+    base[0][1] = extend_4((hi >> 20) & 0xF);
+    base[1][1] = extend_4((hi >> 16) & 0xF);
+    base[0][2] = extend_4((hi >> 12) & 0xF);
+    base[1][2] = extend_4((hi >> 8) & 0xF);
+  }
+
+  const int* table[2] = { etc_modifiers[(hi >> 5) & 7], etc_modifiers[(hi >> 2) & 7] };
+  bool flip = hi & 1;
+
+  for ( int y = 0; y < 4; y++ ) {
+    for ( int x = 0; x < 4; x++ ) {
+      // two 2x4 halves side by side, or 4x2 halves on top of each other
+      int half = flip ? (y >= 2) : (x >= 2);
+      int m = table[half][pixel_index(lo, x, y)];
+      set_rgb(p_out, x, y, base[half][0] + m, base[half][1] + m, base[half][2] + m);
+    }
+  }
+}
+
+//---------------------------------------------------------
+// EAC alpha: a base value, a multiplier and a table, with 3 bit indexes
+// stored column by column from the most significant bit down
+static void decode_eac_alpha( const unsigned char* s, unsigned char* p_out ) {
+  int base = s[0];
+  int mul = s[1] >> 4;
+  const int* table = eac_modifiers[s[1] & 0xF];
+  uint64_t bits = 0;
+  for ( int i = 2; i < 8; i++ ) bits = (bits << 8) | s[i];
+
+  for ( int x = 0; x < 4; x++ ) {
+    for ( int y = 0; y < 4; y++ ) {
+      int k = x * 4 + y;
+      int idx = (bits >> (45 - k * 3)) & 7;
+      p_out[(y * 4 + x) * 4 + 3] = clamp_u8(base + table[idx] * mul);
+    }
+  }
+}
+
+//---------------------------------------------------------
+unsigned char* ktx_decode_rgba( const void* p_file, uint32_t file_size,
+                                int* p_width, int* p_height ) {
+  ktx_t ktx;
+  if ( !ktx_parse(p_file, file_size, &ktx) ) return NULL;
+
+  int w = ktx.width, h = ktx.height;
+  unsigned char* p_pixels = malloc((size_t)w * h * 4);
+  if ( !p_pixels ) return NULL;
+
+  const unsigned char* p_block = ktx.p_level[0];
+  int bytes = block_bytes(ktx.format);
+  unsigned char rgba[16 * 4];
+
+  for ( int by = 0; by < h; by += 4 ) {
+    for ( int bx = 0; bx < w; bx += 4 ) {
+      if ( ktx.format == KTX_ETC2_RGBA8_EAC ) {
+        decode_etc(p_block + 8, true, rgba);
+        decode_eac_alpha(p_block, rgba);
+      } else {
+        decode_etc(p_block, ktx.format != KTX_ETC1_RGB8, rgba);
+      }
+      p_block += bytes;
+
+      // blocks on the right and bottom edges can hang over the image
+      for ( int y = 0; y < 4 && by + y < h; y++ ) {
+        int n = w - bx < 4 ? w - bx : 4;
+        memcpy(p_pixels + ((size_t)(by + y) * w + bx) * 4, rgba + y * 16, n * 4);
+      }
+    }
+  }
+
+  *p_width = w;
+  *p_height = h;
+  return p_pixels;
+}
@@ -0,0 +1,47 @@
+/*
+KTX (version 1) texture containers with ETC1/ETC2 payloads
+
+The blocks are handed to the GPU as they are when it supports the format.
+Otherwise the top level is decoded to RGBA on the CPU. Nothing here
+touches nanovg or GL, so the decoder can run on the decode workers.
+*/
+
+#ifndef _KTX_H
+#define _KTX_H
+
+#include <stdint.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+// GL internal formats of the supported payloads
+#define KTX_ETC1_RGB8               0x8D64
+#define KTX_ETC2_RGB8               0x9274
+#define KTX_ETC2_RGBA8_EAC          0x9278
+
+#define KTX_MAX_LEVELS              16
+
+typedef struct
+{
+  uint32_t              format;
+  int                   width;
+  int                   height;
+  int                   levels;
+  const unsigned char*  p_level[KTX_MAX_LEVELS];   // point into the file
+  int                   level_size[KTX_MAX_LEVELS];
+} ktx_t;
+
+// true if the data starts with the KTX 1 identifier
+bool is_ktx( const void* p_file, uint32_t file_size );
+
+// reads the header and finds the mip levels. Fails on anything but a 2D
+// texture in one of the formats above, or if the file is cut short
+bool ktx_parse( const void* p_file, uint32_t file_size, ktx_t* p_ktx );
+
+// decodes the top level to tightly packed RGBA. Returns a malloc'd
+// buffer, or NULL if the file can't be decoded
+unsigned char* ktx_decode_rgba( const void* p_file, uint32_t file_size,
+                                int* p_width, int* p_height );
+
+#endif
@@ -2,6 +2,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/select.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
@@ -23,10 +24,14 @@
 #define NANOVG_GLES2_IMPLEMENTATION
 #include "nanovg/nanovg.h"
 #include "nanovg/nanovg_gl.h"
+#define NANOVG_SW_IMPLEMENTATION
+#include "nanovg/nanovg_sw.h"
 
 #include "types.h"
+#include "capture.h"
 #include "comms.h"
 #include "render_script.h"
+#include "tx.h"
 #include "utils.h"
 
 #define STDIN_FILENO 0
@@ -35,6 +40,12 @@
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 #define MAX_DISPLAYS 	(4)
 #define MAX_BUFFERS 	(4)
+#define DUMB_BUFFERS 	(2)
+
+// size of the memory framebuffer used by the software output when there
+// is no DRM device. Overridden with -w and -h
+#define DEFAULT_FB_WIDTH 	(800)
+#define DEFAULT_FB_HEIGHT 	(480)
 
 uint8_t DISP_ID = 0;
 uint8_t all_display = 0;
@@ -77,6 +88,21 @@ struct drm_fb {
 	uint32_t fb_id;
 };
 
+struct dumb_fb {
+	uint32_t handle;
+	uint32_t pitch;
+	uint64_t size;
+	uint32_t fb_id;
+	uint8_t *p_map;
+};
+
+static struct {
+	bool has_drm;
+	int front;
+	uint32_t *p_shadow;
+	struct dumb_fb fb[DUMB_BUFFERS];
+} dumb;
+
 static uint32_t drm_fmt_to_gbm_fmt(uint32_t fmt)
 {
 	switch (fmt) {
@@ -588,6 +614,146 @@ static void page_flip_handler(int fd, unsigned int frame,
 	*waiting_for_flip = *waiting_for_flip - 1;
 }
 
+//=============================================================================
+// software output
+//
+// Frames are rasterized on the CPU by the nanovg software back-end and
+// scanned out from DRM dumb buffers, so neither GBM nor EGL is touched.
+// The rasterizer blends against the pixels it has already drawn, and dumb
+// buffers are usually write-combined memory that is very slow to read, so
+// it draws into a cached shadow buffer that is copied out once per frame.
+// Without a usable DRM device the shadow buffer is the only framebuffer.
+
+static int init_dumb_fb(struct dumb_fb *fb, int width, int height)
+{
+	struct drm_mode_create_dumb create = { .width = width, .height = height, .bpp = 32 };
+	struct drm_mode_map_dumb map = { 0 };
+	uint32_t handles[4] = {0}, offsets[4] = {0}, pitches[4] = {0};
+
+	if (drmIoctl(drm.fd, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0) {
+		fprintf(stderr, "failed to create dumb buffer: %s\n", strerror(errno));
+		return -1;
+	}
+	fb->handle = create.handle;
+	fb->pitch = create.pitch;
+	fb->size = create.size;
+
+	handles[0] = fb->handle;
+	pitches[0] = fb->pitch;
+	if (drmModeAddFB2(drm.fd, width, height, drm.format[DISP_ID], handles, pitches, offsets, &fb->fb_id, 0)) {
+		fprintf(stderr, "failed to create fb: %s\n", strerror(errno));
+		return -1;
+	}
+
+	map.handle = fb->handle;
+	if (drmIoctl(drm.fd, DRM_IOCTL_MODE_MAP_DUMB, &map) < 0) {
+		fprintf(stderr, "failed to map dumb buffer: %s\n", strerror(errno));
+		return -1;
+	}
+
+	fb->p_map = mmap(NULL, fb->size, PROT_READ | PROT_WRITE, MAP_SHARED, drm.fd, map.offset);
+	if (fb->p_map == MAP_FAILED) {
+		fb->p_map = NULL;
+		fprintf(stderr, "failed to mmap dumb buffer: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(fb->p_map, 0, fb->size);
+	return 0;
+}
+
+static int init_dumb(egl_data_t* p_data, int width, int height)
+{
+	int i, ret;
+
+	p_data->screen_width = width;
+	p_data->screen_height = height;
+
+	dumb.has_drm = (init_drm(p_data) == 0);
+	if (dumb.has_drm && drm.format[DISP_ID] != DRM_FORMAT_XRGB8888 &&
+	    drm.format[DISP_ID] != DRM_FORMAT_ARGB8888) {
+		fprintf(stderr, "software output needs a 32 bit display format\n");
+		return -1;
+	}
+
+	if (!dumb.has_drm) {
+		// init_drm may have filled in a mode before failing
+		p_data->screen_width = width;
+		p_data->screen_height = height;
+		fprintf(stderr, "no DRM output, rendering to a %dx%d memory framebuffer\n",
+				width, height);
+	}
+
+	dumb.p_shadow = calloc((size_t)p_data->screen_width * p_data->screen_height, sizeof(uint32_t));
+	p_data->p_ctx = nvgCreateSW(NVG_SW_ANTIALIAS);
+	if (!dumb.p_shadow || !p_data->p_ctx) {
+		fprintf(stderr, "Failed to create nvg\n");
+		send_puts("EGL driver error: failed nvgCreateSW");
+		return -1;
+	}
+	nvgSWSetTarget(p_data->p_ctx, dumb.p_shadow, p_data->screen_width,
+	               p_data->screen_height, p_data->screen_width * sizeof(uint32_t));
+
+	if (!dumb.has_drm)
+		return 0;
+
+	for (i = 0; i < DUMB_BUFFERS; i++) {
+		ret = init_dumb_fb(&dumb.fb[i], p_data->screen_width, p_data->screen_height);
+		if (ret)
+			return ret;
+	}
+
+	dumb.front = 0;
+	ret = drmModeSetCrtc(drm.fd, drm.crtc_id[DISP_ID], dumb.fb[0].fb_id,
+			0, 0, &drm.connector_id[DISP_ID], 1, drm.mode[DISP_ID]);
+	if (ret) {
+		fprintf(stderr, "display %d failed to set mode: %s\n", DISP_ID, strerror(errno));
+		return ret;
+	}
+
+	return 0;
+}
+
+// copy the shadow buffer into the back dumb buffer and flip to it
+static int present_dumb(egl_data_t* p_data, drmEventContext* p_evctx)
+{
+	int back = (dumb.front + 1) % DUMB_BUFFERS;
+	struct dumb_fb *fb = &dumb.fb[back];
+	size_t row_bytes = p_data->screen_width * sizeof(uint32_t);
+	int waiting_for_flip = 1;
+	fd_set fds;
+	int y, ret;
+
+	if (!dumb.has_drm)
+		return 0;
+
+	for (y = 0; y < p_data->screen_height; y++) {
+		memcpy(fb->p_map + (size_t)y * fb->pitch,
+		       (uint8_t*)dumb.p_shadow + y * row_bytes, row_bytes);
+	}
+
+	ret = drmModePageFlip(drm.fd, drm.crtc_id[DISP_ID], fb->fb_id,
+			DRM_MODE_PAGE_FLIP_EVENT, &waiting_for_flip);
+	if (ret) {
+		fprintf(stderr, "failed to queue page flip: %s\n", strerror(errno));
+		return -1;
+	}
+
+	while (waiting_for_flip) {
+		FD_ZERO(&fds);
+		FD_SET(drm.fd, &fds);
+		ret = select(drm.fd + 1, &fds, NULL, NULL, NULL);
+		if (ret < 0) {
+			fprintf(stderr, "select err: %s\n", strerror(errno));
+			return ret;
+		}
+		drmHandleEvent(drm.fd, p_evctx);
+	}
+
+	dumb.front = back;
+	return 0;
+}
+
 //---------------------------------------------------------
 int main(int argc, char** argv)
 {
@@ -601,19 +767,47 @@ int main(int argc, char** argv)
 	};
 
   int ret;
+  int opt;
+  char* capture_path = NULL;
+  bool  software     = false;
+  long long tx_budget = 0;
+  int   fb_width     = DEFAULT_FB_WIDTH;
+  int   fb_height    = DEFAULT_FB_HEIGHT;
 
   test_endian();
 
+  // options first. -c <path> captures the incoming stream to a file.
+  // -s renders on the CPU into dumb buffers, -w and -h size the memory
+  // framebuffer it falls back to when there is no DRM device. -b <bytes>
+  // caps texture memory, evicting the least recently drawn textures
+  while ( (opt = getopt(argc, argv, "c:sw:h:b:")) != -1 ) {
+    switch ( opt ) {
+      case 'c': capture_path = optarg; break;
+      case 's': software = true; break;
+      case 'w': fb_width = atoi(optarg); break;
+      case 'h': fb_height = atoi(optarg); break;
+      case 'b': tx_budget = atoll(optarg); break;
+      default: break;
+    }
+  }
+
   // super simple arg check
-  if ( argc != 3 ) {
+  if ( argc - optind != 2 ) {
     send_puts("Argument check failed!");
     fprintf(stderr, "\r\nscenic_driver_egl should be launched via the ScenicDriverEGL library.\r\n\r\n");
     return 0;
   }
-  int num_scripts = atoi(argv[1]);
-  int debug_mode  = atoi(argv[2]);
+  int num_scripts = atoi(argv[optind]);
+  int debug_mode  = atoi(argv[optind + 1]);
 
   // initialize
+  if ( software ) {
+    ret = init_dumb(&egl_data, fb_width, fb_height);
+    if (ret) {
+      fprintf(stderr, "failed to initialize software output\n");
+      return ret;
+    }
+  } else {
   ret = init_drm(&egl_data);
 	if (ret) {
 		fprintf(stderr, "failed to initialize DRM\n");
@@ -638,21 +832,30 @@ int main(int argc, char** argv)
 		fprintf(stderr, "failed to initialize EGL\n");
 		return ret;
 	}
+  }
 
   // set up the scripts table
   memset(&data, 0, sizeof(driver_data_t));
   data.p_scripts = malloc(sizeof(void*) * num_scripts);
   memset(data.p_scripts, 0, sizeof(void*) * num_scripts);
+  data.p_script_lengths = malloc(sizeof(int) * num_scripts);
+  memset(data.p_script_lengths, 0, sizeof(int) * num_scripts);
   data.keep_going    = true;
   data.num_scripts   = num_scripts;
   data.p_ctx         = egl_data.p_ctx;
   data.screen_width  = egl_data.screen_width;
   data.screen_height = egl_data.screen_height;
+  data.tx_budget     = tx_budget;
 
   egl_data.frame_idx = 0;
 
+  if ( capture_path ) {
+    capture_open(capture_path, egl_data.screen_width, egl_data.screen_height);
+  }
+
   // test_draw(&egl_data);
   // glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  if ( !software ) {
 	glClear(GL_COLOR_BUFFER_BIT);
 	eglSwapBuffers(egl_data.display, egl_data.surface);
   struct gbm_bo *bo = gbm_surface_lock_front_buffer(gbm.surface);
@@ -666,6 +869,7 @@ int main(int argc, char** argv)
 			printf("display %d failed to set mode: %s\n", DISP_ID, strerror(errno));
 			return ret;
 		}
+  }
 
   // signal the app that the window is ready
   send_ready(0, egl_data.screen_width, egl_data.screen_height);
@@ -687,7 +891,13 @@ int main(int argc, char** argv)
     {
 
       // clear the buffer
-      glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+      if ( software ) {
+        nvgSWClear(data.p_ctx, data.clear_color);
+      } else {
+        glClearColor(data.clear_color.r, data.clear_color.g,
+                     data.clear_color.b, data.clear_color.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+      }
 
       // render the scene
       nvgBeginFrame(egl_data.p_ctx, egl_data.screen_width,
@@ -700,9 +910,19 @@ int main(int argc, char** argv)
       // test_draw(&egl_data);
 
       nvgEndFrame(data.p_ctx);
+      end_tx_frame(&data);
+
+      if ( software ) {
+        capture_frame();
+        ret = present_dumb(&egl_data, &evctx);
+        if (ret)
+          return ret;
+        continue;
+      }
 
       // Swap front and back buffers
       eglSwapBuffers(egl_data.display, egl_data.surface);
+      capture_frame();
 
       gbm.bo[next_idx] = gbm_surface_lock_front_buffer(gbm.surface);
 		  drm.fb[next_idx] = drm_fb_get_from_bo(gbm.bo[next_idx]);
@@ -742,5 +962,7 @@ int main(int argc, char** argv)
       egl_data.frame_idx = next_idx;
     }
   }
+
+  capture_close();
   return 0;
 }
@@ -100,11 +100,25 @@ void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 int fonsExpandAtlas(FONScontext* s, int width, int height);
 // Resets the whole stash.
 int fonsResetAtlas(FONScontext* stash, int width, int height);
+// Starts a new frame. Atlas space is reused starting with the glyphs drawn longest ago.
+void fonsNextFrame(FONScontext* s);
+// Returns the atlas area in use, glyphs in it, and how many were evicted and rasterized again.
+void fonsGetAtlasStats(FONScontext* s, int* used, int* glyphs, int* evicted, int* rerasterized);
 
 // Add fonts
 int fonsAddFont(FONScontext* s, const char* name, const char* path);
 int fonsAddFontMem(FONScontext* s, const char* name, unsigned char* data, int ndata, int freeData);
 int fonsGetFontByName(FONScontext* s, const char* name);
+// Frees a font's data and glyphs. Atlas shelves that only held its glyphs are
+// reused. Its id may be given to a font added later.
+int fonsRemoveFont(FONScontext* s, int font);
+// Returns the number of fonts and the memory their data and glyphs take.
+void fonsGetFontStats(FONScontext* s, int* fonts, int* bytes);
+// Draws the font from signed distance fields: each glyph is rasterized once,
+// at FONS_SDF_SIZE, and scaled to every size and blur. Set before the font
+// is drawn. Returns 0 if the glyph back-end can't make distance fields.
+int fonsSetFontSDF(FONScontext* s, int font, int enabled);
+int fonsGetFontSDF(FONScontext* s, int font);
 
 // State handling
 void fonsPushState(FONScontext* s);
@@ -131,6 +145,12 @@ void fonsVertMetrics(FONScontext* s, float* ascender, float* descender, float* l
 int fonsTextIterInit(FONScontext* stash, FONStextIter* iter, float x, float y, const char* str, const char* end, int bitmapOption);
 int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* quad);
 
+// Rasterizes the glyphs of the string that aren't in the atlas yet, at the
+// current font, size and blur. They are rendered side by side on worker
+// threads and then packed, so iterating the text afterwards finds them
+// ready. Returns the number of glyphs added.
+int fonsRasterizeText(FONScontext* s, const char* str, const char* end);
+
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
@@ -145,6 +165,51 @@ void fonsDrawDebug(FONScontext* s, float x, float y);
 
 #define FONS_NOTUSED(v)  (void)sizeof(v)
 
+// Distance field glyphs are rasterized at this pixel size, with a border of
+// FONS_SDF_PAD pixels. The field is FONS_SDF_ONEDGE on the outline and falls
+// to 0 FONS_SDF_PAD pixels outside of it.
+#ifndef FONS_SDF_SIZE
+#	define FONS_SDF_SIZE 40
+#endif
+#ifndef FONS_SDF_PAD
+#	define FONS_SDF_PAD 8
+#endif
+#define FONS_SDF_ONEDGE 128
+// The blur distance field glyphs are cached under. Sized glyphs only keep metrics
+#define FONS_SDF_BLUR (-1)
+
+// Large font files are mapped read-only instead of read into the heap. Pages
+// are only loaded as glyphs need them, and are shared with every other process
+// that maps the same file, including the next run of this one. A mapped file
+// must not be truncated or rewritten while the font is loaded: reading a page
+// that is gone raises SIGBUS. Smaller files are read, so only fonts of at
+// least FONS_MMAP_MIN_SIZE bytes depend on the file staying as it was.
+#if defined(__unix__) || defined(__APPLE__)
+#define FONS_USE_MMAP
+#ifndef FONS_MMAP_MIN_SIZE
+#	define FONS_MMAP_MIN_SIZE (1024*1024)
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Glyphs missing from the atlas can be rasterized on worker threads. The
+// FreeType back-end shares one library between its faces, so it stays serial.
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(FONS_USE_FREETYPE)
+#define FONS_USE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// What to do with a font's data when the font is deleted
+#define FONS_DATA_KEEP		0
+#define FONS_DATA_FREE		1
+#define FONS_DATA_UNMAP		2
+
 #ifdef FONS_USE_FREETYPE
 
 #include <ft2build.h>
@@ -185,6 +250,12 @@ int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char
 	return ftError == 0;
 }
 
+void fons__tt_freeFont(FONSttFontImpl *font)
+{
+	if (font->font) FT_Done_Face(font->font);
+	font->font = NULL;
+}
+
 void fons__tt_getFontVMetrics(FONSttFontImpl *font, int *ascent, int *descent, int *lineGap)
 {
 	*ascent = font->font->ascender;
@@ -245,6 +316,20 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
 	}
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							 float scale, int padding, int glyph)
+{
+	// not supported, fonsSetFontSDF refuses fonts when built with FreeType
+	FONS_NOTUSED(font);
+	FONS_NOTUSED(output);
+	FONS_NOTUSED(outWidth);
+	FONS_NOTUSED(outHeight);
+	FONS_NOTUSED(outStride);
+	FONS_NOTUSED(scale);
+	FONS_NOTUSED(padding);
+	FONS_NOTUSED(glyph);
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
 	FT_Vector ftKerning;
@@ -288,6 +373,12 @@ int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char
 	return stbError;
 }
 
+void fons__tt_freeFont(FONSttFontImpl *font)
+{
+	// stb_truetype only points into the font's data
+	FONS_NOTUSED(font);
+}
+
 void fons__tt_getFontVMetrics(FONSttFontImpl *font, int *ascent, int *descent, int *lineGap)
 {
 	stbtt_GetFontVMetrics(&font->font, ascent, descent, lineGap);
@@ -318,6 +409,20 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
 	stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							 float scale, int padding, int glyph)
+{
+	int x, y, w, h, xoff, yoff;
+	unsigned char* sdf = stbtt_GetGlyphSDF(&font->font, scale, glyph, padding, FONS_SDF_ONEDGE,
+										   FONS_SDF_ONEDGE / (float)padding, &w, &h, &xoff, &yoff);
+	if (sdf == NULL) return;	// empty glyph, or out of scratch memory
+	for (y = 0; y < h && y < outHeight; y++) {
+		for (x = 0; x < w && x < outWidth; x++)
+			output[y*outStride + x] = sdf[y*w + x];
+	}
+	stbtt_FreeSDF(sdf, font->font.userdata);
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
 	return stbtt_GetGlyphKernAdvance(&font->font, glyph1, glyph2);
@@ -337,8 +442,11 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_INIT_GLYPHS
 #	define FONS_INIT_GLYPHS 256
 #endif
-#ifndef FONS_INIT_ATLAS_NODES
-#	define FONS_INIT_ATLAS_NODES 256
+#ifndef FONS_INIT_ATLAS_SHELVES
+#	define FONS_INIT_ATLAS_SHELVES 32
+#endif
+#ifndef FONS_SHELF_ROUND
+#	define FONS_SHELF_ROUND 4
 #endif
 #ifndef FONS_VERTEX_COUNT
 #	define FONS_VERTEX_COUNT 1024
@@ -349,6 +457,18 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 #ifndef FONS_MAX_FALLBACKS
 #	define FONS_MAX_FALLBACKS 20
 #endif
+// Worker threads rasterizing glyphs, besides the caller
+#ifndef FONS_MAX_THREADS
+#	define FONS_MAX_THREADS 7
+#endif
+// Glyphs rasterized in one batch. Fewer than FONS_BATCH_MIN aren't worth
+// waking the workers for, they are rasterized when the text is drawn
+#ifndef FONS_BATCH_GLYPHS
+#	define FONS_BATCH_GLYPHS 256
+#endif
+#ifndef FONS_BATCH_MIN
+#	define FONS_BATCH_MIN 4
+#endif
 
 static unsigned int fons__hashint(unsigned int a)
 {
@@ -379,6 +499,8 @@ struct FONSglyph
 	short size, blur;
 	short x0,y0,x1,y1;
 	short xadv,xoff,yoff;
+	short shelf;
+	unsigned char evicted;
 };
 typedef struct FONSglyph FONSglyph;
 
@@ -398,6 +520,7 @@ struct FONSfont
 	int lut[FONS_HASH_LUT_SIZE];
 	int fallbacks[FONS_MAX_FALLBACKS];
 	int nfallbacks;
+	int sdf;
 };
 typedef struct FONSfont FONSfont;
 
@@ -412,20 +535,36 @@ struct FONSstate
 };
 typedef struct FONSstate FONSstate;
 
-struct FONSatlasNode {
-    short x, y, width;
+struct FONSatlasShelf {
+	short y, height;
+	short x;
+	unsigned char pinned;
+	unsigned int lastUsed;
 };
-typedef struct FONSatlasNode FONSatlasNode;
+typedef struct FONSatlasShelf FONSatlasShelf;
 
 struct FONSatlas
 {
 	int width, height;
-	FONSatlasNode* nodes;
-	int nnodes;
-	int cnodes;
+	FONSatlasShelf* shelves;
+	int nshelves;
+	int cshelves;
 };
 typedef struct FONSatlas FONSatlas;
 
+// A glyph rasterized by fonsRasterizeText into a bitmap of its own, the
+// size of its padded rect in the atlas
+struct FONSrasterJob
+{
+	FONSttFontImpl* font;	// the font or fallback that has the glyph
+	unsigned int codepoint;
+	int index;
+	float scale;
+	int gw, gh, pad, blur;
+	unsigned char* bitmap;
+};
+typedef struct FONSrasterJob FONSrasterJob;
+
 struct FONScontext
 {
 	FONSparams params;
@@ -446,6 +585,26 @@ struct FONScontext
 	int nstates;
 	void (*handleError)(void* uptr, int error, int val);
 	void* errorUptr;
+	unsigned int frame;
+	int nevicted;
+	int nrerasterized;
+	FONSrasterJob* jobs;
+	int njobs;
+	int cjobs;
+	unsigned char* bitmaps;
+	int cbitmaps;
+	FONSrasterJob* rendered;	// copied into the atlas by fons__getGlyph instead of rasterizing
+#ifdef FONS_USE_THREADS
+	pthread_t threads[FONS_MAX_THREADS];
+	int nthreads;
+	int started;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	int nextJob;
+	int pendingJobs;
+	int quit;
+#endif
 };
 
 #ifdef STB_TRUETYPE_IMPLEMENTATION
@@ -455,6 +614,10 @@ static void* fons__tmpalloc(size_t size, void* up)
 	unsigned char* ptr;
 	FONScontext* stash = (FONScontext*)up;
 
+	// Glyphs rasterized on worker threads can't share the scratch buffer
+	if (stash == NULL)
+		return malloc(size);
+
 	// 16-byte align the returned pointer
 	size = (size + 0xf) & ~0xf;
 
@@ -470,9 +633,9 @@ static void* fons__tmpalloc(size_t size, void* up)
 
 static void fons__tmpfree(void* ptr, void* up)
 {
-	(void)ptr;
-	(void)up;
-	// empty
+	if (up == NULL)
+		free(ptr);
+	// the scratch buffer is reset instead
 }
 
 #endif // STB_TRUETYPE_IMPLEMENTATION
@@ -516,16 +679,19 @@ static unsigned int fons__decutf8(unsigned int* state, unsigned int* codep, unsi
 	return *state;
 }
 
-// Atlas based on Skyline Bin Packer by Jukka Jylänki
+// Atlas of horizontal shelves. Each shelf holds glyphs of about its height
+// side by side. Glyphs are not freed one by one. When the atlas is full the
+// shelf drawn from longest ago is emptied and filled again, so the space of
+// cold glyphs is reused in place without touching the rest of the texture.
 
 static void fons__deleteAtlas(FONSatlas* atlas)
 {
 	if (atlas == NULL) return;
-	if (atlas->nodes != NULL) free(atlas->nodes);
+	if (atlas->shelves != NULL) free(atlas->shelves);
 	free(atlas);
 }
 
-static FONSatlas* fons__allocAtlas(int w, int h, int nnodes)
+static FONSatlas* fons__allocAtlas(int w, int h, int nshelves)
 {
 	FONSatlas* atlas = NULL;
 
@@ -537,18 +703,12 @@ static FONSatlas* fons__allocAtlas(int w, int h, int nnodes)
 	atlas->width = w;
 	atlas->height = h;
 
-	// Allocate space for skyline nodes
-	atlas->nodes = (FONSatlasNode*)malloc(sizeof(FONSatlasNode) * nnodes);
-	if (atlas->nodes == NULL) goto error;
-	memset(atlas->nodes, 0, sizeof(FONSatlasNode) * nnodes);
-	atlas->nnodes = 0;
-	atlas->cnodes = nnodes;
-
-	// Init root node.
-	atlas->nodes[0].x = 0;
-	atlas->nodes[0].y = 0;
-	atlas->nodes[0].width = (short)w;
-	atlas->nnodes++;
+	// Allocate space for shelves
+	atlas->shelves = (FONSatlasShelf*)malloc(sizeof(FONSatlasShelf) * nshelves);
+	if (atlas->shelves == NULL) goto error;
+	memset(atlas->shelves, 0, sizeof(FONSatlasShelf) * nshelves);
+	atlas->nshelves = 0;
+	atlas->cshelves = nshelves;
 
 	return atlas;
 
@@ -557,40 +717,9 @@ error:
 	return NULL;
 }
 
-static int fons__atlasInsertNode(FONSatlas* atlas, int idx, int x, int y, int w)
-{
-	int i;
-	// Insert node
-	if (atlas->nnodes+1 > atlas->cnodes) {
-		atlas->cnodes = atlas->cnodes == 0 ? 8 : atlas->cnodes * 2;
-		atlas->nodes = (FONSatlasNode*)realloc(atlas->nodes, sizeof(FONSatlasNode) * atlas->cnodes);
-		if (atlas->nodes == NULL)
-			return 0;
-	}
-	for (i = atlas->nnodes; i > idx; i--)
-		atlas->nodes[i] = atlas->nodes[i-1];
-	atlas->nodes[idx].x = (short)x;
-	atlas->nodes[idx].y = (short)y;
-	atlas->nodes[idx].width = (short)w;
-	atlas->nnodes++;
-
-	return 1;
-}
-
-static void fons__atlasRemoveNode(FONSatlas* atlas, int idx)
-{
-	int i;
-	if (atlas->nnodes == 0) return;
-	for (i = idx; i < atlas->nnodes-1; i++)
-		atlas->nodes[i] = atlas->nodes[i+1];
-	atlas->nnodes--;
-}
-
 static void fons__atlasExpand(FONSatlas* atlas, int w, int h)
 {
-	// Insert node for empty space
-	if (w > atlas->width)
-		fons__atlasInsertNode(atlas, atlas->nnodes, atlas->width, 0, w - atlas->width);
+	// Shelves get longer with the width, new ones go in the added height.
 	atlas->width = w;
 	atlas->height = h;
 }
@@ -599,111 +728,74 @@ static void fons__atlasReset(FONSatlas* atlas, int w, int h)
 {
 	atlas->width = w;
 	atlas->height = h;
-	atlas->nnodes = 0;
-
-	// Init root node.
-	atlas->nodes[0].x = 0;
-	atlas->nodes[0].y = 0;
-	atlas->nodes[0].width = (short)w;
-	atlas->nnodes++;
+	atlas->nshelves = 0;
 }
 
-static int fons__atlasAddSkylineLevel(FONSatlas* atlas, int idx, int x, int y, int w, int h)
+static int fons__atlasAddShelf(FONSatlas* atlas, int h, unsigned int frame)
 {
-	int i;
-
-	// Insert new node
-	if (fons__atlasInsertNode(atlas, idx, x, y+h, w) == 0)
-		return 0;
-
-	// Delete skyline segments that fall under the shadow of the new segment.
-	for (i = idx+1; i < atlas->nnodes; i++) {
-		if (atlas->nodes[i].x < atlas->nodes[i-1].x + atlas->nodes[i-1].width) {
-			int shrink = atlas->nodes[i-1].x + atlas->nodes[i-1].width - atlas->nodes[i].x;
-			atlas->nodes[i].x += (short)shrink;
-			atlas->nodes[i].width -= (short)shrink;
-			if (atlas->nodes[i].width <= 0) {
-				fons__atlasRemoveNode(atlas, i);
-				i--;
-			} else {
-				break;
-			}
-		} else {
-			break;
-		}
+	FONSatlasShelf* shelf;
+	int y = 0;
+	if (atlas->nshelves > 0) {
+		shelf = &atlas->shelves[atlas->nshelves-1];
+		y = shelf->y + shelf->height;
 	}
-
-	// Merge same height skyline segments that are next to each other.
-	for (i = 0; i < atlas->nnodes-1; i++) {
-		if (atlas->nodes[i].y == atlas->nodes[i+1].y) {
-			atlas->nodes[i].width += atlas->nodes[i+1].width;
-			fons__atlasRemoveNode(atlas, i+1);
-			i--;
-		}
+	if (y + h > atlas->height)
+		return -1;
+	if (atlas->nshelves+1 > atlas->cshelves) {
+		atlas->cshelves = atlas->cshelves == 0 ? 8 : atlas->cshelves * 2;
+		atlas->shelves = (FONSatlasShelf*)realloc(atlas->shelves, sizeof(FONSatlasShelf) * atlas->cshelves);
+		if (atlas->shelves == NULL)
+			return -1;
 	}
-
-	return 1;
+	shelf = &atlas->shelves[atlas->nshelves];
+	shelf->y = (short)y;
+	shelf->height = (short)h;
+	shelf->x = 0;
+	shelf->pinned = 0;
+	shelf->lastUsed = frame;
+	return atlas->nshelves++;
 }
 
-static int fons__atlasRectFits(FONSatlas* atlas, int i, int w, int h)
+// Returns the shelf the rect was put on, or -1 if there is no room.
+static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry, unsigned int frame)
 {
-	// Checks if there is enough space at the location of skyline span 'i',
-	// and return the max height of all skyline spans under that at that location,
-	// (think tetris block being dropped at that position). Or -1 if no space found.
-	int x = atlas->nodes[i].x;
-	int y = atlas->nodes[i].y;
-	int spaceLeft;
-	if (x + w > atlas->width)
-		return -1;
-	spaceLeft = w;
-	while (spaceLeft > 0) {
-		if (i == atlas->nnodes) return -1;
-		y = fons__maxi(y, atlas->nodes[i].y);
-		if (y + h > atlas->height) return -1;
-		spaceLeft -= atlas->nodes[i].width;
-		++i;
-	}
-	return y;
-}
-
-static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry)
-{
-	int besth = atlas->height, bestw = atlas->width, besti = -1;
-	int bestx = -1, besty = -1, i;
-
-	// Bottom left fit heuristic.
-	for (i = 0; i < atlas->nnodes; i++) {
-		int y = fons__atlasRectFits(atlas, i, rw, rh);
-		if (y != -1) {
-			if (y + rh < besth || (y + rh == besth && atlas->nodes[i].width < bestw)) {
-				besti = i;
-				bestw = atlas->nodes[i].width;
-				besth = y + rh;
-				bestx = atlas->nodes[i].x;
-				besty = y;
-			}
+	int i, best = -1, bestLoose = -1;
+
+	// Prefer the flattest shelf that has room, a new one if the existing
+	// shelves would waste more than a quarter of their height.
+	for (i = 0; i < atlas->nshelves; i++) {
+		FONSatlasShelf* shelf = &atlas->shelves[i];
+		if (shelf->height < rh || shelf->x + rw > atlas->width)
+			continue;
+		if (shelf->height <= rh + rh/4 + FONS_SHELF_ROUND) {
+			if (best == -1 || shelf->height < atlas->shelves[best].height)
+				best = i;
+		} else if (bestLoose == -1 || shelf->height < atlas->shelves[bestLoose].height) {
+			bestLoose = i;
 		}
 	}
+	if (best == -1 && rw <= atlas->width)
+		best = fons__atlasAddShelf(atlas, (rh + FONS_SHELF_ROUND-1) & ~(FONS_SHELF_ROUND-1), frame);
+	if (best == -1)
+		best = bestLoose;
+	if (best == -1)
+		return -1;
 
-	if (besti == -1)
-		return 0;
-
-	// Perform the actual packing.
-	if (fons__atlasAddSkylineLevel(atlas, besti, bestx, besty, rw, rh) == 0)
-		return 0;
-
-	*rx = bestx;
-	*ry = besty;
+	*rx = atlas->shelves[best].x;
+	*ry = atlas->shelves[best].y;
+	atlas->shelves[best].x += (short)rw;
 
-	return 1;
+	return best;
 }
 
 static void fons__addWhiteRect(FONScontext* stash, int w, int h)
 {
-	int x, y, gx, gy;
+	int x, y, gx, gy, shelf;
 	unsigned char* dst;
-	if (fons__atlasAddRect(stash->atlas, w, h, &gx, &gy) == 0)
+	shelf = fons__atlasAddRect(stash->atlas, w, h, &gx, &gy, stash->frame);
+	if (shelf == -1)
 		return;
+	stash->atlas->shelves[shelf].pinned = 1;
 
 	// Rasterize
 	dst = &stash->texData[gx + gy * stash->params.width];
@@ -730,6 +822,12 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 
 	stash->params = *params;
 
+#ifdef FONS_USE_THREADS
+	pthread_mutex_init(&stash->lock, NULL);
+	pthread_cond_init(&stash->work, NULL);
+	pthread_cond_init(&stash->done, NULL);
+#endif
+
 	// Allocate scratch buffer.
 	stash->scratch = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
 	if (stash->scratch == NULL) goto error;
@@ -742,7 +840,7 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 			goto error;
 	}
 
-	stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
+	stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_SHELVES);
 	if (stash->atlas == NULL) goto error;
 
 	// Allocate space for fonts.
@@ -782,9 +880,35 @@ static FONSstate* fons__getState(FONScontext* stash)
 	return &stash->states[stash->nstates-1];
 }
 
+// The font with the id, or NULL if there is none or it was removed.
+static FONSfont* fons__getFont(FONScontext* stash, int font)
+{
+	if (stash == NULL || font < 0 || font >= stash->nfonts) return NULL;
+	if (stash->fonts[font]->data == NULL) return NULL;
+	return stash->fonts[font];
+}
+
+int fonsSetFontSDF(FONScontext* stash, int font, int enabled)
+{
+	FONSfont* f = fons__getFont(stash, font);
+	if (f == NULL) return 0;
+#ifdef FONS_USE_FREETYPE
+	if (enabled) return 0;
+#endif
+	f->sdf = enabled;
+	return 1;
+}
+
+int fonsGetFontSDF(FONScontext* stash, int font)
+{
+	FONSfont* f = fons__getFont(stash, font);
+	return f != NULL ? f->sdf : 0;
+}
+
 int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 {
-	FONSfont* baseFont = stash->fonts[base];
+	FONSfont* baseFont = fons__getFont(stash, base);
+	if (baseFont == NULL || fons__getFont(stash, fallback) == NULL) return 0;
 	if (baseFont->nfallbacks < FONS_MAX_FALLBACKS) {
 		baseFont->fallbacks[baseFont->nfallbacks++] = fallback;
 		return 1;
@@ -855,17 +979,45 @@ void fonsClearState(FONScontext* stash)
 	state->align = FONS_ALIGN_LEFT | FONS_ALIGN_BASELINE;
 }
 
+// Releases a font's data and forgets its glyphs. The empty font keeps its
+// place in the fonts array, for the next font added.
+static void fons__emptyFont(FONSfont* font)
+{
+	int i;
+	if (font->data) {
+		fons__tt_freeFont(&font->font);
+#ifdef FONS_USE_MMAP
+		if (font->freeData == FONS_DATA_UNMAP) munmap(font->data, font->dataSize);
+#endif
+		if (font->freeData == FONS_DATA_FREE) free(font->data);
+	}
+	font->data = NULL;
+	font->dataSize = 0;
+	font->name[0] = '\0';
+	font->nglyphs = 0;
+	for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
+		font->lut[i] = -1;
+	font->nfallbacks = 0;
+	font->sdf = 0;
+}
+
 static void fons__freeFont(FONSfont* font)
 {
 	if (font == NULL) return;
+	fons__emptyFont(font);
 	if (font->glyphs) free(font->glyphs);
-	if (font->freeData && font->data) free(font->data);
 	free(font);
 }
 
 static int fons__allocFont(FONScontext* stash)
 {
 	FONSfont* font = NULL;
+	int i;
+	// Reuse the place of a removed font.
+	for (i = 0; i < stash->nfonts; i++) {
+		if (stash->fonts[i]->data == NULL)
+			return i;
+	}
 	if (stash->nfonts+1 > stash->cfonts) {
 		stash->cfonts = stash->cfonts == 0 ? 8 : stash->cfonts * 2;
 		stash->fonts = (FONSfont**)realloc(stash->fonts, sizeof(FONSfont*) * stash->cfonts);
@@ -892,6 +1044,43 @@ error:
 
 int fonsAddFont(FONScontext* stash, const char* name, const char* path)
 {
+#ifdef FONS_USE_MMAP
+	struct stat st;
+	unsigned char* data = NULL;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return FONS_INVALID;
+	size_t readed = 0;
+	ssize_t n;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > INT_MAX) {
+		close(fd);
+		return FONS_INVALID;
+	}
+	if (st.st_size >= FONS_MMAP_MIN_SIZE) {
+		data = (unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) return FONS_INVALID;
+		return fonsAddFontMem(stash, name, data, (int)st.st_size, FONS_DATA_UNMAP);
+	}
+
+	// Small files are copied, so the file can change under a loaded font.
+	data = (unsigned char*)malloc(st.st_size);
+	if (data == NULL) {
+		close(fd);
+		return FONS_INVALID;
+	}
+	while (readed < (size_t)st.st_size) {
+		n = read(fd, data + readed, st.st_size - readed);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		readed += n;
+	}
+	close(fd);
+	if (readed != (size_t)st.st_size) {
+		free(data);
+		return FONS_INVALID;
+	}
+	return fonsAddFontMem(stash, name, data, (int)st.st_size, FONS_DATA_FREE);
+#else
 	FILE* fp = 0;
 	int dataSize = 0;
 	size_t readed;
@@ -910,12 +1099,13 @@ int fonsAddFont(FONScontext* stash, const char* name, const char* path)
 	fp = 0;
 	if (readed != dataSize) goto error;
 
-	return fonsAddFontMem(stash, name, data, dataSize, 1);
+	return fonsAddFontMem(stash, name, data, dataSize, FONS_DATA_FREE);
 
 error:
 	if (data) free(data);
 	if (fp) fclose(fp);
 	return FONS_INVALID;
+#endif
 }
 
 int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData)
@@ -956,8 +1146,7 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
 	return idx;
 
 error:
-	fons__freeFont(font);
-	stash->nfonts--;
+	fons__emptyFont(font);
 	return FONS_INVALID;
 }
 
@@ -965,12 +1154,67 @@ int fonsGetFontByName(FONScontext* s, const char* name)
 {
 	int i;
 	for (i = 0; i < s->nfonts; i++) {
-		if (strcmp(s->fonts[i]->name, name) == 0)
+		if (s->fonts[i]->data != NULL && strcmp(s->fonts[i]->name, name) == 0)
 			return i;
 	}
 	return FONS_INVALID;
 }
 
+// Gives back the shelves that only held glyphs of the font. The space at the
+// bottom of the atlas grows by the empty shelves at the end, the others are
+// filled again from the left.
+static void fons__releaseShelves(FONScontext* stash, FONSfont* font)
+{
+	FONSatlas* atlas = stash->atlas;
+	unsigned char* state;
+	int i, j;
+
+	if (atlas->nshelves == 0) return;
+	// 1 has glyphs of the font, 2 has glyphs of others
+	state = (unsigned char*)calloc(atlas->nshelves, 1);
+	if (state == NULL) return;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* f = stash->fonts[i];
+		for (j = 0; j < f->nglyphs; j++) {
+			FONSglyph* glyph = &f->glyphs[j];
+			if (glyph->x0 >= 0 && glyph->shelf >= 0 && glyph->shelf < atlas->nshelves)
+				state[glyph->shelf] |= f == font ? 1 : 2;
+		}
+	}
+	for (i = 0; i < atlas->nshelves; i++) {
+		if (state[i] == 1 && !atlas->shelves[i].pinned) {
+			atlas->shelves[i].x = 0;
+			atlas->shelves[i].lastUsed = 0;
+		}
+	}
+	free(state);
+
+	while (atlas->nshelves > 0 && atlas->shelves[atlas->nshelves-1].x == 0 &&
+		   !atlas->shelves[atlas->nshelves-1].pinned)
+		atlas->nshelves--;
+}
+
+int fonsRemoveFont(FONScontext* stash, int font)
+{
+	FONSfont* f = fons__getFont(stash, font);
+	int i, j, n;
+	if (f == NULL) return 0;
+
+	// Other fonts stop falling back to it.
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* other = stash->fonts[i];
+		for (j = 0, n = 0; j < other->nfallbacks; j++) {
+			if (other->fallbacks[j] != font)
+				other->fallbacks[n++] = other->fallbacks[j];
+		}
+		other->nfallbacks = n;
+	}
+
+	fons__releaseShelves(stash, f);
+	fons__emptyFont(f);
+	return 1;
+}
+
 
 static FONSglyph* fons__allocGlyph(FONSfont* font)
 {
@@ -1049,22 +1293,156 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
+// True for the glyphs of a distance field font that only hold the metrics of
+// a size and blur. Their quads point into the FONS_SDF_SIZE glyph.
+static int fons__isSDFView(FONSfont* font, int iblur)
+{
+	return font->sdf && iblur != FONS_SDF_BLUR;
+}
+
+// Empties the shelves drawn from longest ago to make room for a glyph of
+// height h. That is one shelf tall enough, or a run of neighbouring shelves
+// that are merged. Shelves drawn from in this frame are kept, the texture is
+// updated before the frame's text is drawn.
+static int fons__evictShelves(FONScontext* stash, int h)
+{
+	FONSatlas* atlas = stash->atlas;
+	int i, j, first = -1, last = -1, bottom = 0, bestHeight = 0;
+	unsigned int bestUsed = 0;
+
+	h = (h + FONS_SHELF_ROUND-1) & ~(FONS_SHELF_ROUND-1);
+	if (atlas->nshelves > 0)
+		bottom = atlas->shelves[atlas->nshelves-1].y + atlas->shelves[atlas->nshelves-1].height;
+
+	for (i = 0; i < atlas->nshelves; i++) {
+		int height = 0;
+		unsigned int used = 0;
+		for (j = i; j < atlas->nshelves && height < h; j++) {
+			FONSatlasShelf* shelf = &atlas->shelves[j];
+			if (shelf->pinned || shelf->lastUsed == stash->frame)
+				break;
+			height += shelf->height;
+			if (shelf->lastUsed > used)
+				used = shelf->lastUsed;
+		}
+		if (j == atlas->nshelves)
+			height += atlas->height - bottom;
+		if (j == i || height < h)
+			continue;
+		if (first == -1 || used < bestUsed || (used == bestUsed && height < bestHeight)) {
+			first = i;
+			last = j-1;
+			bestUsed = used;
+			bestHeight = height;
+		}
+	}
+	if (first == -1)
+		return 0;
+
+	// The glyphs keep their metrics and are rasterized again when next drawn.
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++) {
+			FONSglyph* glyph = &font->glyphs[j];
+			if (glyph->x0 >= 0 && glyph->shelf >= first && glyph->shelf <= last) {
+				glyph->x0 = -1;
+				glyph->y0 = -1;
+				if (!fons__isSDFView(font, glyph->blur)) {
+					glyph->evicted = 1;
+					stash->nevicted++;
+				}
+			}
+		}
+	}
+
+	if (last == atlas->nshelves-1) {
+		// The space joins the free area at the bottom.
+		atlas->nshelves = first;
+	} else if (first == last) {
+		atlas->shelves[first].x = 0;
+	} else {
+		// Merge the run into a shelf for the glyph and one with the rest of the height.
+		int height = 0;
+		for (i = first; i <= last; i++) {
+			height += atlas->shelves[i].height;
+			atlas->shelves[i].height = 0;
+			atlas->shelves[i].x = 0;
+		}
+		atlas->shelves[first].height = (short)h;
+		atlas->shelves[first+1].y = (short)(atlas->shelves[first].y + h);
+		atlas->shelves[first+1].height = (short)(height - h);
+		for (i = first+2; i <= last; i++)
+			atlas->shelves[i].y = (short)(atlas->shelves[first].y + height);
+	}
+
+	return 1;
+}
+
+// The index of the codepoint's glyph in the font, or else in the first of its
+// fallbacks that has it. 0, the font's missing glyph, if none does.
+static int fons__glyphIndex(FONScontext* stash, FONSfont* font, unsigned int codepoint, FONSfont** renderFont)
+{
+	int i, g = fons__tt_getGlyphIndex(&font->font, codepoint);
+
+	*renderFont = font;
+	if (g != 0) return g;
+	for (i = 0; i < font->nfallbacks; ++i) {
+		FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
+		int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
+		if (fallbackIndex != 0) {
+			*renderFont = fallbackFont;
+			return fallbackIndex;
+		}
+	}
+	return 0;
+}
+
+// Renders a glyph into its gw by gh rect: the bitmap pad pixels in from the
+// edges (a distance field fills the rect), an empty one pixel border, then the blur.
+static void fons__renderGlyph(FONSttFontImpl* font, unsigned char* dst, int gw, int gh, int stride,
+							  float scale, int pad, int blur, int g)
+{
+	int x, y;
+
+	// Clear the spot, it may hold an evicted glyph
+	for (y = 0; y < gh; y++)
+		memset(&dst[y*stride], 0, gw);
+
+	if (blur == FONS_SDF_BLUR)
+		fons__tt_renderGlyphSDF(font, dst, gw, gh, stride, scale, pad, g);
+	else
+		fons__tt_renderGlyphBitmap(font, &dst[pad + pad*stride], gw-pad*2, gh-pad*2, stride, scale, scale, g);
+
+	// Make sure there is one pixel empty border.
+	for (y = 0; y < gh; y++) {
+		dst[y*stride] = 0;
+		dst[gw-1 + y*stride] = 0;
+	}
+	for (x = 0; x < gw; x++) {
+		dst[x] = 0;
+		dst[x + (gh-1)*stride] = 0;
+	}
+
+	if (blur > 0)
+		fons__blur(NULL, dst, gw, gh, stride, blur);
+}
+
 static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
 								 short isize, short iblur, int bitmapOption)
 {
-	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
+	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, y;
 	float scale;
 	FONSglyph* glyph = NULL;
 	unsigned int h;
 	float size = isize/10.0f;
-	int pad, added;
-	unsigned char* bdst;
+	int pad, shelf = -1;
 	unsigned char* dst;
 	FONSfont* renderFont = font;
+	int view = fons__isSDFView(font, iblur);
 
 	if (isize < 2) return NULL;
 	if (iblur > 20) iblur = 20;
-	pad = iblur+2;
+	pad = iblur == FONS_SDF_BLUR ? FONS_SDF_PAD : iblur+2;
 
 	// Reset allocator.
 	stash->nscratch = 0;
@@ -1075,9 +1453,13 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	while (i != -1) {
 		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
 			glyph = &font->glyphs[i];
-			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || (glyph->x0 >= 0 && glyph->y0 >= 0)) {
-			  return glyph;
+			if (glyph->x0 >= 0 && glyph->y0 >= 0) {
+				if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED)
+					stash->atlas->shelves[glyph->shelf].lastUsed = stash->frame;
+				return glyph;
 			}
+			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL)
+				return glyph;
 			// At this point, glyph exists but the bitmap data is not yet created.
 			break;
 		}
@@ -1085,36 +1467,42 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	}
 
 	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	g = fons__tt_getGlyphIndex(&font->font, codepoint);
-	// Try to find the glyph in fallback fonts.
-	if (g == 0) {
-		for (i = 0; i < font->nfallbacks; ++i) {
-			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
-			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
-			if (fallbackIndex != 0) {
-				g = fallbackIndex;
-				renderFont = fallbackFont;
-				break;
-			}
-		}
-		// It is possible that we did not find a fallback glyph.
-		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
-	}
+	// If no fallback has it either, the empty glyph 0 is cached.
+	g = fons__glyphIndex(stash, font, codepoint, &renderFont);
 	scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
 	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+	if (view) {
+		// The advance is for this size, the box is the one of the distance field glyph
+		float sdfScale = fons__tt_getPixelHeightScale(&renderFont->font, (float)FONS_SDF_SIZE);
+		fons__tt_buildGlyphBitmap(&renderFont->font, g, (float)FONS_SDF_SIZE, sdfScale, &advance, &lsb, &x0, &y0, &x1, &y1);
+		pad = FONS_SDF_PAD;
+	}
 	gw = x1-x0 + pad*2;
 	gh = y1-y0 + pad*2;
 
 	// Determines the spot to draw glyph in the atlas.
-	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
-		// Find free spot for the rect in the atlas
-		added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
-		if (added == 0 && stash->handleError != NULL) {
+	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && view) {
+		// Every size and blur of a distance field font is drawn from one glyph
+		int gi = glyph != NULL ? (int)(glyph - font->glyphs) : -1;
+		FONSglyph* sdf = fons__getGlyph(stash, font, codepoint, FONS_SDF_SIZE*10, FONS_SDF_BLUR, FONS_GLYPH_BITMAP_REQUIRED);
+		if (sdf == NULL) return NULL;
+		gx = sdf->x0;
+		gy = sdf->y0;
+		shelf = sdf->shelf;
+		// the glyphs may have moved
+		glyph = gi != -1 ? &font->glyphs[gi] : NULL;
+	} else if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
+		// Find free spot for the rect in the atlas, making room from cold glyphs if needed
+		shelf = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy, stash->frame);
+		if (shelf == -1 && fons__evictShelves(stash, gh))
+			shelf = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy, stash->frame);
+		if (shelf == -1 && stash->handleError != NULL) {
 			// Atlas is full, let the user to resize the atlas (or not), and try again.
 			stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-			added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+			shelf = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy, stash->frame);
 		}
-		if (added == 0) return NULL;
+		if (shelf == -1) return NULL;
+		stash->atlas->shelves[shelf].lastUsed = stash->frame;
 	} else {
 		// Negative coordinate indicates there is no bitmap data created.
 		gx = -1;
@@ -1128,6 +1516,7 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 		glyph->size = isize;
 		glyph->blur = iblur;
 		glyph->next = 0;
+		glyph->evicted = 0;
 
 		// Insert char to hash lookup.
 		glyph->next = font->lut[h];
@@ -1141,41 +1530,24 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	glyph->xadv = (short)(scale * advance * 10.0f);
 	glyph->xoff = (short)(x0 - pad);
 	glyph->yoff = (short)(y0 - pad);
+	glyph->shelf = (short)shelf;
 
-	if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
+	if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || view) {
 		return glyph;
 	}
 
-	// Rasterize
-	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
-
-	// Make sure there is one pixel empty border.
-	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		dst[y*stash->params.width] = 0;
-		dst[gw-1 + y*stash->params.width] = 0;
+	if (glyph->evicted) {
+		stash->nrerasterized++;
+		glyph->evicted = 0;
 	}
-	for (x = 0; x < gw; x++) {
-		dst[x] = 0;
-		dst[x + (gh-1)*stash->params.width] = 0;
-	}
-
-	// Debug code to color the glyph background
-/*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		for (x = 0; x < gw; x++) {
-			int a = (int)fdst[x+y*stash->params.width] + 20;
-			if (a > 255) a = 255;
-			fdst[x+y*stash->params.width] = a;
-		}
-	}*/
 
-	// Blur
-	if (iblur > 0) {
-		stash->nscratch = 0;
-		bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-		fons__blur(stash, bdst, gw, gh, stash->params.width, iblur);
+	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
+	if (stash->rendered != NULL && stash->rendered->gw == gw && stash->rendered->gh == gh) {
+		// Rasterized already by fonsRasterizeText
+		for (y = 0; y < gh; y++)
+			memcpy(&dst[y*stash->params.width], &stash->rendered->bitmap[y*gw], gw);
+	} else {
+		fons__renderGlyph(&renderFont->font, dst, gw, gh, stash->params.width, scale, pad, iblur, g);
 	}
 
 	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
@@ -1191,6 +1563,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 						   float scale, float spacing, float* x, float* y, FONSquad* q)
 {
 	float rx,ry,xoff,yoff,x0,y0,x1,y1;
+	float k = 1.0f;
+	int sdf = fons__isSDFView(font, glyph->blur);
 
 	if (prevGlyphIndex != -1) {
 		float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
@@ -1207,27 +1581,41 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 	x1 = (float)(glyph->x1-1);
 	y1 = (float)(glyph->y1-1);
 
+	// Distance field glyphs are scaled from FONS_SDF_SIZE, and not snapped to pixels.
+	if (sdf)
+		k = glyph->size / (FONS_SDF_SIZE*10.0f);
+
 	if (stash->params.flags & FONS_ZERO_TOPLEFT) {
-		rx = (float)(int)(*x + xoff);
-		ry = (float)(int)(*y + yoff);
+		if (sdf) {
+			rx = *x + xoff*k;
+			ry = *y + yoff*k;
+		} else {
+			rx = (float)(int)(*x + xoff);
+			ry = (float)(int)(*y + yoff);
+		}
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry + y1 - y0;
+		q->x1 = rx + (x1 - x0)*k;
+		q->y1 = ry + (y1 - y0)*k;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
 		q->s1 = x1 * stash->itw;
 		q->t1 = y1 * stash->ith;
 	} else {
-		rx = (float)(int)(*x + xoff);
-		ry = (float)(int)(*y - yoff);
+		if (sdf) {
+			rx = *x + xoff*k;
+			ry = *y - yoff*k;
+		} else {
+			rx = (float)(int)(*x + xoff);
+			ry = (float)(int)(*y - yoff);
+		}
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry - y1 + y0;
+		q->x1 = rx + (x1 - x0)*k;
+		q->y1 = ry - (y1 - y0)*k;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
@@ -1312,7 +1700,7 @@ float fonsDrawText(FONScontext* stash,
 	float width;
 
 	if (stash == NULL) return x;
-	if (state->font < 0 || state->font >= stash->nfonts) return x;
+	if (fons__getFont(stash, state->font) == NULL) return x;
 	font = stash->fonts[state->font];
 	if (font->data == NULL) return x;
 
@@ -1368,7 +1756,7 @@ int fonsTextIterInit(FONScontext* stash, FONStextIter* iter,
 	memset(iter, 0, sizeof(*iter));
 
 	if (stash == NULL) return 0;
-	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	if (fons__getFont(stash, state->font) == NULL) return 0;
 	iter->font = stash->fonts[state->font];
 	if (iter->font->data == NULL) return 0;
 
@@ -1433,6 +1821,203 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 	return 1;
 }
 
+static void fons__runJob(FONSrasterJob* job)
+{
+	// A copy that allocates from the heap, the scratch buffer is the caller's
+	FONSttFontImpl font = *job->font;
+#ifndef FONS_USE_FREETYPE
+	font.font.userdata = NULL;
+#endif
+	fons__renderGlyph(&font, job->bitmap, job->gw, job->gh, job->gw, job->scale, job->pad, job->blur, job->index);
+}
+
+#ifdef FONS_USE_THREADS
+
+// Runs jobs until there are none left to take. Called with the lock held
+static void fons__takeJobs(FONScontext* stash)
+{
+	while (stash->nextJob < stash->njobs) {
+		FONSrasterJob* job = &stash->jobs[stash->nextJob++];
+		pthread_mutex_unlock(&stash->lock);
+		fons__runJob(job);
+		pthread_mutex_lock(&stash->lock);
+		if (--stash->pendingJobs == 0)
+			pthread_cond_signal(&stash->done);
+	}
+}
+
+static void* fons__worker(void* arg)
+{
+	FONScontext* stash = (FONScontext*)arg;
+
+	pthread_mutex_lock(&stash->lock);
+	while (!stash->quit) {
+		fons__takeJobs(stash);
+		if (!stash->quit)
+			pthread_cond_wait(&stash->work, &stash->lock);
+	}
+	pthread_mutex_unlock(&stash->lock);
+	return NULL;
+}
+
+static void fons__startWorkers(FONScontext* stash)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, n = cores > 1 ? (int)cores - 1 : 0;
+
+	if (n > FONS_MAX_THREADS) n = FONS_MAX_THREADS;
+	for (i = 0; i < n; i++) {
+		if (pthread_create(&stash->threads[stash->nthreads], NULL, fons__worker, stash) == 0)
+			stash->nthreads++;
+	}
+	stash->started = 1;
+}
+
+#endif
+
+// Rasterizes the queued jobs, on the workers and the calling thread
+static void fons__runJobs(FONScontext* stash, int njobs)
+{
+#ifdef FONS_USE_THREADS
+	if (!stash->started)
+		fons__startWorkers(stash);
+	pthread_mutex_lock(&stash->lock);
+	stash->njobs = njobs;
+	stash->nextJob = 0;
+	stash->pendingJobs = njobs;
+	pthread_cond_broadcast(&stash->work);
+	fons__takeJobs(stash);
+	while (stash->pendingJobs > 0)
+		pthread_cond_wait(&stash->done, &stash->lock);
+	stash->njobs = 0;
+	pthread_mutex_unlock(&stash->lock);
+#else
+	int i;
+	for (i = 0; i < njobs; i++)
+		fons__runJob(&stash->jobs[i]);
+#endif
+}
+
+// Places the rasterized glyphs in the atlas. Returns how many fit
+static int fons__placeJobs(FONScontext* stash, FONSfont* font, short isize, short iblur, int njobs)
+{
+	int i;
+	for (i = 0; i < njobs; i++) {
+		FONSglyph* glyph;
+		stash->rendered = &stash->jobs[i];
+		glyph = fons__getGlyph(stash, font, stash->jobs[i].codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED);
+		stash->rendered = NULL;
+		if (glyph == NULL)
+			break;
+	}
+	return i;
+}
+
+// Queues the glyph unless it is in the atlas or already queued
+static int fons__queueGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
+							short isize, short iblur, int njobs)
+{
+	FONSfont* renderFont;
+	FONSrasterJob* job;
+	int i, g, advance, lsb, x0, y0, x1, y1;
+	int pad = iblur == FONS_SDF_BLUR ? FONS_SDF_PAD : iblur+2;
+	float size = isize/10.0f;
+
+	i = font->lut[fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1)];
+	while (i != -1) {
+		FONSglyph* glyph = &font->glyphs[i];
+		if (glyph->codepoint == codepoint && glyph->size == isize && glyph->blur == iblur) {
+			if (glyph->x0 >= 0)
+				return njobs;
+			break;
+		}
+		i = glyph->next;
+	}
+	for (i = 0; i < njobs; i++) {
+		if (stash->jobs[i].codepoint == codepoint)
+			return njobs;
+	}
+
+	if (njobs+1 > stash->cjobs) {
+		int cjobs = stash->cjobs == 0 ? 64 : stash->cjobs * 2;
+		FONSrasterJob* jobs = (FONSrasterJob*)realloc(stash->jobs, sizeof(FONSrasterJob) * cjobs);
+		if (jobs == NULL) return njobs;
+		stash->jobs = jobs;
+		stash->cjobs = cjobs;
+	}
+
+	// The same box fons__getGlyph makes room for
+	job = &stash->jobs[njobs];
+	g = fons__glyphIndex(stash, font, codepoint, &renderFont);
+	job->font = &renderFont->font;
+	job->codepoint = codepoint;
+	job->index = g;
+	job->scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
+	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, job->scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+	job->gw = x1-x0 + pad*2;
+	job->gh = y1-y0 + pad*2;
+	job->pad = pad;
+	job->blur = iblur;
+	job->bitmap = NULL;
+	return njobs+1;
+}
+
+int fonsRasterizeText(FONScontext* stash, const char* str, const char* end)
+{
+	FONSstate* state = fons__getState(stash);
+	FONSfont* font = fons__getFont(stash, state->font);
+	unsigned int codepoint = 0, utf8state = 0;
+	short isize = (short)(state->size*10.0f);
+	short iblur = (short)state->blur;
+	int i, njobs = 0, added = 0;
+
+	if (font == NULL || font->data == NULL || isize < 2) return 0;
+	if (end == NULL)
+		end = str + strlen(str);
+	if (iblur > 20) iblur = 20;
+	// Sizes of a distance field font are drawn from one glyph
+	if (font->sdf) {
+		isize = FONS_SDF_SIZE*10;
+		iblur = FONS_SDF_BLUR;
+	}
+
+	for (;;) {
+		int bytes = 0;
+
+		for (; str != end && njobs < FONS_BATCH_GLYPHS; str++) {
+			if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
+				continue;
+			njobs = fons__queueGlyph(stash, font, codepoint, isize, iblur, njobs);
+		}
+		if (njobs < FONS_BATCH_MIN)
+			break;
+
+		for (i = 0; i < njobs; i++)
+			bytes += stash->jobs[i].gw * stash->jobs[i].gh;
+		if (bytes > stash->cbitmaps) {
+			unsigned char* bitmaps = (unsigned char*)realloc(stash->bitmaps, bytes);
+			if (bitmaps == NULL) break;
+			stash->bitmaps = bitmaps;
+			stash->cbitmaps = bytes;
+		}
+		bytes = 0;
+		for (i = 0; i < njobs; i++) {
+			stash->jobs[i].bitmap = stash->bitmaps + bytes;
+			bytes += stash->jobs[i].gw * stash->jobs[i].gh;
+		}
+
+		fons__runJobs(stash, njobs);
+		i = fons__placeJobs(stash, font, isize, iblur, njobs);
+		added += i;
+		// The atlas is full, drawing the text deals with that
+		if (i < njobs || str == end)
+			break;
+		njobs = 0;
+	}
+
+	return added;
+}
+
 void fonsDrawDebug(FONScontext* stash, float x, float y)
 {
 	int i;
@@ -1463,19 +2048,19 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
 	fons__vertex(stash, x+w, y+h, 1, 1, 0xffffffff);
 
 	// Drawbug draw atlas
-	for (i = 0; i < stash->atlas->nnodes; i++) {
-		FONSatlasNode* n = &stash->atlas->nodes[i];
+	for (i = 0; i < stash->atlas->nshelves; i++) {
+		FONSatlasShelf* n = &stash->atlas->shelves[i];
 
 		if (stash->nverts+6 > FONS_VERTEX_COUNT)
 			fons__flush(stash);
 
-		fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+0, u, v, 0xc00000ff);
+		fons__vertex(stash, x+0, y+n->y+0, u, v, 0xc00000ff);
+		fons__vertex(stash, x+n->x, y+n->y+1, u, v, 0xc00000ff);
+		fons__vertex(stash, x+n->x, y+n->y+0, u, v, 0xc00000ff);
 
-		fons__vertex(stash, x+n->x+0, y+n->y+0, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+0, y+n->y+1, u, v, 0xc00000ff);
-		fons__vertex(stash, x+n->x+n->width, y+n->y+1, u, v, 0xc00000ff);
+		fons__vertex(stash, x+0, y+n->y+0, u, v, 0xc00000ff);
+		fons__vertex(stash, x+0, y+n->y+1, u, v, 0xc00000ff);
+		fons__vertex(stash, x+n->x, y+n->y+1, u, v, 0xc00000ff);
 	}
 
 	fons__flush(stash);
@@ -1500,7 +2085,7 @@ float fonsTextBounds(FONScontext* stash,
 	float minx, miny, maxx, maxy;
 
 	if (stash == NULL) return 0;
-	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	if (fons__getFont(stash, state->font) == NULL) return 0;
 	font = stash->fonts[state->font];
 	if (font->data == NULL) return 0;
 
@@ -1566,7 +2151,7 @@ void fonsVertMetrics(FONScontext* stash,
 	short isize;
 
 	if (stash == NULL) return;
-	if (state->font < 0 || state->font >= stash->nfonts) return;
+	if (fons__getFont(stash, state->font) == NULL) return;
 	font = stash->fonts[state->font];
 	isize = (short)(state->size*10.0f);
 	if (font->data == NULL) return;
@@ -1586,7 +2171,7 @@ void fonsLineBounds(FONScontext* stash, float y, float* miny, float* maxy)
 	short isize;
 
 	if (stash == NULL) return;
-	if (state->font < 0 || state->font >= stash->nfonts) return;
+	if (fons__getFont(stash, state->font) == NULL) return;
 	font = stash->fonts[state->font];
 	isize = (short)(state->size*10.0f);
 	if (font->data == NULL) return;
@@ -1636,6 +2221,18 @@ void fonsDeleteInternal(FONScontext* stash)
 	if (stash->params.renderDelete)
 		stash->params.renderDelete(stash->params.userPtr);
 
+#ifdef FONS_USE_THREADS
+	pthread_mutex_lock(&stash->lock);
+	stash->quit = 1;
+	pthread_cond_broadcast(&stash->work);
+	pthread_mutex_unlock(&stash->lock);
+	for (i = 0; i < stash->nthreads; i++)
+		pthread_join(stash->threads[i], NULL);
+	pthread_cond_destroy(&stash->work);
+	pthread_cond_destroy(&stash->done);
+	pthread_mutex_destroy(&stash->lock);
+#endif
+
 	for (i = 0; i < stash->nfonts; ++i)
 		fons__freeFont(stash->fonts[i]);
 
@@ -1643,6 +2240,8 @@ void fonsDeleteInternal(FONScontext* stash)
 	if (stash->fonts) free(stash->fonts);
 	if (stash->texData) free(stash->texData);
 	if (stash->scratch) free(stash->scratch);
+	if (stash->jobs) free(stash->jobs);
+	if (stash->bitmaps) free(stash->bitmaps);
 	free(stash);
 	fons__tt_done(stash);
 }
@@ -1702,8 +2301,8 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
 	fons__atlasExpand(stash->atlas, width, height);
 
 	// Add existing data as dirty.
-	for (i = 0; i < stash->atlas->nnodes; i++)
-		maxy = fons__maxi(maxy, stash->atlas->nodes[i].y);
+	for (i = 0; i < stash->atlas->nshelves; i++)
+		maxy = fons__maxi(maxy, stash->atlas->shelves[i].y + stash->atlas->shelves[i].height);
 	stash->dirtyRect[0] = 0;
 	stash->dirtyRect[1] = 0;
 	stash->dirtyRect[2] = stash->params.width;
@@ -1764,5 +2363,44 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 	return 1;
 }
 
+void fonsNextFrame(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	stash->frame++;
+}
+
+void fonsGetFontStats(FONScontext* stash, int* fonts, int* bytes)
+{
+	int i, n = 0, size = 0;
+	if (stash == NULL) return;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		size += (int)sizeof(FONSfont) + font->cglyphs * (int)sizeof(FONSglyph);
+		if (font->data == NULL) continue;
+		// mapped files count too, though their pages can be dropped
+		size += font->dataSize;
+		n++;
+	}
+	if (fonts) *fonts = n;
+	if (bytes) *bytes = size;
+}
+
+void fonsGetAtlasStats(FONScontext* stash, int* used, int* glyphs, int* evicted, int* rerasterized)
+{
+	int i, j, n = 0, area = 0;
+	if (stash == NULL) return;
+	for (i = 0; i < stash->atlas->nshelves; i++)
+		area += stash->atlas->shelves[i].x * stash->atlas->shelves[i].height;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++)
+			if (font->glyphs[j].x0 >= 0 && !fons__isSDFView(font, font->glyphs[j].blur)) n++;
+	}
+	if (used) *used = area;
+	if (glyphs) *glyphs = n;
+	if (evicted) *evicted = stash->nevicted;
+	if (rerasterized) *rerasterized = stash->nrerasterized;
+}
+
 
 #endif
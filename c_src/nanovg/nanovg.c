@@ -125,10 +125,12 @@ struct NVGcontext {
 	struct FONScontext* fs;
 	int fontImages[NVG_MAX_FONTIMAGES];
 	int fontImageIdx;
+	int fontAtlasResets;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	int vertexCount;
 };
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
@@ -374,6 +376,7 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	nvgReset(ctx);
 
 	nvg__setDevicePixelRatio(ctx, devicePixelRatio);
+	fonsNextFrame(ctx->fs);
 
 	ctx->params.renderViewport(ctx->params.userPtr, windowWidth, windowHeight, devicePixelRatio);
 
@@ -381,6 +384,22 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	ctx->vertexCount = 0;
+}
+
+void nvgFrameStats(NVGcontext* ctx, int* drawCalls, int* triangles, int* vertices)
+{
+	if (drawCalls) *drawCalls = ctx->drawCallCount;
+	if (triangles) *triangles = ctx->fillTriCount + ctx->strokeTriCount + ctx->textTriCount;
+	if (vertices) *vertices = ctx->vertexCount;
+}
+
+void nvgTextAtlasStats(NVGcontext* ctx, NVGtextAtlasStats* stats)
+{
+	memset(stats, 0, sizeof(NVGtextAtlasStats));
+	fonsGetAtlasSize(ctx->fs, &stats->width, &stats->height);
+	fonsGetAtlasStats(ctx->fs, &stats->used, &stats->glyphs, &stats->evictions, &stats->rerasterized);
+	stats->resets = ctx->fontAtlasResets;
 }
 
 void nvgCancelFrame(NVGcontext* ctx)
@@ -822,6 +841,18 @@ int nvgCreateImageRGBA(NVGcontext* ctx, int w, int h, int imageFlags, const unsi
 	return ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_RGBA, w, h, imageFlags, data);
 }
 
+int nvgCreateImageFormat(NVGcontext* ctx, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	return ctx->params.renderCreateTexture(ctx->params.userPtr, type, w, h, imageFlags, data);
+}
+
+int nvgCreateImageCompressed(NVGcontext* ctx, unsigned int format, int w, int h, int levels,
+							 const unsigned char** data, const int* sizes, int imageFlags)
+{
+	if (ctx->params.renderCreateCompressedTexture == NULL) return 0;
+	return ctx->params.renderCreateCompressedTexture(ctx->params.userPtr, format, w, h, levels, data, sizes, imageFlags);
+}
+
 void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data)
 {
 	int w, h;
@@ -829,6 +860,23 @@ void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data)
 	ctx->params.renderUpdateTexture(ctx->params.userPtr, image, 0,0, w,h, data);
 }
 
+void nvgUpdateImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	ctx->params.renderUpdateTexture(ctx->params.userPtr, image, x,y, w,h, data);
+}
+
+int nvgUpdateImageRect(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	if (ctx->params.renderUpdateTextureRect == NULL) return 0;
+	return ctx->params.renderUpdateTextureRect(ctx->params.userPtr, image, x,y, w,h, data);
+}
+
+int nvgImageGenerateMipmaps(NVGcontext* ctx, int image)
+{
+	if (ctx->params.renderGenerateMipmaps == NULL) return 0;
+	return ctx->params.renderGenerateMipmaps(ctx->params.userPtr, image);
+}
+
 void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h)
 {
 	ctx->params.renderGetTextureSize(ctx->params.userPtr, image, w, h);
@@ -953,6 +1001,36 @@ NVGpaint nvgImagePattern(NVGcontext* ctx,
 	return p;
 }
 
+NVGpaint nvgImageRegionPattern(NVGcontext* ctx, float cx, float cy, float w, float h, float angle,
+							   int image, float rx, float ry, float rw, float rh, float alpha)
+{
+	NVGpaint p;
+	int iw, ih;
+	float sx, sy, ox, oy, cs, sn;
+
+	nvgImageSize(ctx, image, &iw, &ih);
+	if (iw <= 0 || ih <= 0 || rw <= 0.0f || rh <= 0.0f)
+		return nvgImagePattern(ctx, cx, cy, w, h, angle, image, alpha);
+
+	// Scale the whole image so the region covers (w,h), then move the
+	// region's corner to (cx,cy) in the rotated pattern space.
+	sx = w / rw;
+	sy = h / rh;
+	ox = -rx * sx;
+	oy = -ry * sy;
+	cs = nvg__cosf(angle);
+	sn = nvg__sinf(angle);
+	p = nvgImagePattern(ctx, cx + cs*ox - sn*oy, cy + sn*ox + cs*oy, iw * sx, ih * sy, angle, image, alpha);
+
+	// Clamp half a texel in, so linear filtering stays inside the region.
+	p.region[0] = (rx + 0.5f) / iw;
+	p.region[1] = (ry + 0.5f) / ih;
+	p.region[2] = (rx + rw - 0.5f) / iw;
+	p.region[3] = (ry + rh - 0.5f) / ih;
+
+	return p;
+}
+
 // Scissoring
 void nvgScissor(NVGcontext* ctx, float x, float y, float w, float h)
 {
@@ -2241,6 +2319,7 @@ void nvgFill(NVGcontext* ctx)
 		path = &ctx->cache->paths[i];
 		ctx->fillTriCount += path->nfill-2;
 		ctx->fillTriCount += path->nstroke-2;
+		ctx->vertexCount += path->nfill + path->nstroke;
 		ctx->drawCallCount += 2;
 	}
 }
@@ -2282,6 +2361,7 @@ void nvgStroke(NVGcontext* ctx)
 	for (i = 0; i < ctx->cache->npaths; i++) {
 		path = &ctx->cache->paths[i];
 		ctx->strokeTriCount += path->nstroke-2;
+		ctx->vertexCount += path->nstroke;
 		ctx->drawCallCount++;
 	}
 }
@@ -2303,6 +2383,16 @@ int nvgFindFont(NVGcontext* ctx, const char* name)
 	return fonsGetFontByName(ctx->fs, name);
 }
 
+int nvgDeleteFont(NVGcontext* ctx, int font)
+{
+	return fonsRemoveFont(ctx->fs, font);
+}
+
+void nvgFontStats(NVGcontext* ctx, int* fonts, int* bytes)
+{
+	fonsGetFontStats(ctx->fs, fonts, bytes);
+}
+
 
 int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
 {
@@ -2315,6 +2405,11 @@ int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallba
 	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
 }
 
+int nvgFontSDF(NVGcontext* ctx, int font, int enabled)
+{
+	return fonsSetFontSDF(ctx->fs, font, enabled);
+}
+
 // State setting
 void nvgFontSize(NVGcontext* ctx, float size)
 {
@@ -2368,6 +2463,13 @@ static float nvg__getFontScale(NVGstate* state)
 	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
 }
 
+// the blur fontstash rasterizes glyphs with. None if the back-end blurs text
+// as it draws it, so every blur of a size shares the sharp glyphs
+static float nvg__glyphBlur(NVGcontext* ctx, float blur)
+{
+	return ctx->params.textBlur ? 0.0f : blur;
+}
+
 static void nvg__flushTextTexture(NVGcontext* ctx)
 {
 	int dirty[4];
@@ -2407,6 +2509,7 @@ static int nvg__allocTextAtlas(NVGcontext* ctx)
 		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, 0, NULL);
 	}
 	++ctx->fontImageIdx;
+	++ctx->fontAtlasResets;
 	fonsResetAtlas(ctx->fs, iw, ih);
 	return 1;
 }
@@ -2419,6 +2522,29 @@ static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
 	// Render triangles.
 	paint.image = ctx->fontImages[ctx->fontImageIdx];
 
+	if (fonsGetFontSDF(ctx->fs, state->fontId)) {
+		// The field falls by FONS_SDF_ONEDGE over FONS_SDF_PAD pixels of the
+		// FONS_SDF_SIZE glyph. Blur spreads the edge over more pixels and
+		// moves its middle inwards, so thin strokes fade like blurred
+		// bitmap glyphs do instead of just getting bolder.
+		float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+		float size = state->fontSize * scale;
+		float blur = state->fontBlur * scale;
+		float pixel = FONS_SDF_ONEDGE / 255.0f / FONS_SDF_PAD * FONS_SDF_SIZE / size;
+		paint.sdf[0] = FONS_SDF_ONEDGE / 255.0f + pixel * blur;
+		paint.sdf[1] = pixel * (1.0f + 3.0f * blur);
+	} else if (ctx->params.textBlur && state->fontBlur > 0.0f) {
+		// The same spread as fontstash's blur, which runs an exponential
+		// filter with this alpha forwards and back over the glyph twice.
+		// That has the variance of a Gaussian with 4(1-a)/a^2
+		float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+		float blur = nvg__minf(state->fontBlur * scale, 20.0f);
+		float a = 1.0f - expf(-2.3f / (blur * 0.57735f + 1.0f));
+		float sigma = 2.0f * sqrtf(1.0f - a) / a;
+		paint.blur[0] = sigma;
+		paint.blur[1] = nvg__minf(ceilf(sigma * 3.0f), NVG_BLUR_RADIUS);
+	}
+
 	// Apply global alpha
 	paint.innerColor.a *= state->alpha;
 	paint.outerColor.a *= state->alpha;
@@ -2427,6 +2553,7 @@ static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
 
 	ctx->drawCallCount++;
 	ctx->textTriCount += nverts/3;
+	ctx->vertexCount += nverts;
 }
 
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
@@ -2447,7 +2574,7 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -2496,6 +2623,53 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 	return iter.nextx / scale;
 }
 
+int nvgTextPrewarm(NVGcontext* ctx, int font, float size, float blur, const char* string, const char* end)
+{
+	FONStextIter iter;
+	FONSquad q;
+	float scale = ctx->devicePxRatio;
+	int ok = 1;
+
+	if (end == NULL)
+		end = string + strlen(string);
+
+	if (font == FONS_INVALID) return 1;
+
+	// the same size and blur nvgText asks fontstash for, so the glyphs are found again
+	fonsPushState(ctx->fs);
+	fonsSetSize(ctx->fs, size*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, blur*scale));
+	fonsSetFont(ctx->fs, font);
+
+	fonsRasterizeText(ctx->fs, string, end);
+	fonsTextIterInit(ctx->fs, &iter, 0, 0, string, end, FONS_GLYPH_BITMAP_REQUIRED);
+	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+		// starting another atlas is left to drawing, it drops the current one
+		if (iter.prevGlyphIndex == -1) {
+			ok = 0;
+			break;
+		}
+	}
+	fonsPopState(ctx->fs);
+
+	nvg__flushTextTexture(ctx);
+	return ok;
+}
+
+void nvgTextRasterize(NVGcontext* ctx, const char* string, const char* end)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+
+	if (state->fontId == FONS_INVALID) return;
+
+	// the glyphs nvgText asks for
+	fonsSetSize(ctx->fs, state->fontSize*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
+	fonsSetFont(ctx->fs, state->fontId);
+	fonsRasterizeText(ctx->fs, string, end);
+}
+
 void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
@@ -2548,7 +2722,7 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -2612,7 +2786,7 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -2700,6 +2874,8 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 				}
 			} else {
 				float nextWidth = iter.nextx - rowStartX;
+				// the row without this char, if a word has to be broken before it
+				float prevWidth = rowWidth, prevMaxX = rowMaxX;
 
 				// track last non-white space character
 				if (type == NVG_CHAR || type == NVG_CJK_CHAR) {
@@ -2727,9 +2903,9 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 						// The current word is longer than the row length, just break it from here.
 						rows[nrows].start = rowStart;
 						rows[nrows].end = iter.str;
-						rows[nrows].width = rowWidth * invscale;
+						rows[nrows].width = prevWidth * invscale;
 						rows[nrows].minx = rowMinX * invscale;
-						rows[nrows].maxx = rowMaxX * invscale;
+						rows[nrows].maxx = prevMaxX * invscale;
 						rows[nrows].next = iter.str;
 						nrows++;
 						if (nrows >= maxRows)
@@ -2799,7 +2975,7 @@ float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -2843,7 +3019,7 @@ void nvgTextBoxBounds(NVGcontext* ctx, float x, float y, float breakRowWidth, co
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 	fonsLineBounds(ctx->fs, 0, &rminy, &rmaxy);
@@ -2894,7 +3070,7 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
-	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetBlur(ctx->fs, nvg__glyphBlur(ctx, state->fontBlur*scale));
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
@@ -50,6 +50,9 @@ struct NVGpaint {
 	NVGcolor innerColor;
 	NVGcolor outerColor;
 	int image;
+	float region[4];		// Texture coordinates the sampling is clamped to, min x,y then max x,y. All zero for the whole image.
+	float sdf[2];			// Text from a distance field texture: the value on the outline, then the change over one pixel. Zero otherwise.
+	float blur[2];			// Text blurred as it is drawn: the standard deviation of the Gaussian, then its radius in whole pixels (at most NVG_BLUR_RADIUS). Zero otherwise.
 };
 typedef struct NVGpaint NVGpaint;
 
@@ -160,6 +163,25 @@ void nvgCancelFrame(NVGcontext* ctx);
 // Ends drawing flushing remaining render state.
 void nvgEndFrame(NVGcontext* ctx);
 
+// Returns the number of draw calls, triangles and vertices submitted since nvgBeginFrame().
+// Any of the pointers can be NULL.
+void nvgFrameStats(NVGcontext* ctx, int* drawCalls, int* triangles, int* vertices);
+
+// Glyph atlas state. Space of glyphs not drawn for a while is reused when
+// the atlas is full. Only a frame that needs more glyphs than fit at once
+// moves to a bigger atlas and rasterizes all of them again.
+struct NVGtextAtlasStats {
+	int width, height;	// size of the atlas
+	int used;			// pixels taken by glyphs and the space between them
+	int glyphs;			// glyphs in the atlas
+	int evictions;		// glyphs dropped to make room, since the context was created
+	int rerasterized;	// dropped glyphs that were drawn and rasterized again
+	int resets;			// times the atlas was replaced by a bigger one
+};
+typedef struct NVGtextAtlasStats NVGtextAtlasStats;
+
+void nvgTextAtlasStats(NVGcontext* ctx, NVGtextAtlasStats* stats);
+
 //
 // Composite operation
 //
@@ -379,9 +401,33 @@ int nvgCreateImageMem(NVGcontext* ctx, int imageFlags, unsigned char* data, int
 // Returns handle to the image.
 int nvgCreateImageRGBA(NVGcontext* ctx, int w, int h, int imageFlags, const unsigned char* data);
 
+// Creates image from image data in one of the NVGtexture formats, uploaded without
+// expanding it to RGBA first. Luminance images sample as gray, RGB images as opaque.
+// Returns handle to the image.
+int nvgCreateImageFormat(NVGcontext* ctx, int type, int w, int h, int imageFlags, const unsigned char* data);
+
+// Creates image from GPU compressed data. format is the GL internal format, such as
+// GL_COMPRESSED_RGB8_ETC2, and data/sizes hold the blocks of each of the mip levels.
+// Mipmaps are used only if all levels down to 1x1 are given.
+// Returns handle to the image, or 0 if the back-end doesn't support the format.
+int nvgCreateImageCompressed(NVGcontext* ctx, unsigned int format, int w, int h, int levels,
+							 const unsigned char** data, const int* sizes, int imageFlags);
+
 // Updates image data specified by image handle.
+// Updates leave the mipmaps of an image stale until nvgImageGenerateMipmaps is called.
 void nvgUpdateImage(NVGcontext* ctx, int image, const unsigned char* data);
 
+// Updates the rectangle (x,y,w,h) of an image. The data is laid out as the whole image.
+void nvgUpdateImageRegion(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data);
+
+// Updates the rectangle (x,y,w,h) of an image from tightly packed data holding just that rectangle.
+// Returns 0 if the back-end can't update the image.
+int nvgUpdateImageRect(NVGcontext* ctx, int image, int x, int y, int w, int h, const unsigned char* data);
+
+// Generates mipmaps for an image that has none, or was updated since they were made, and
+// switches it to mipmapped filtering. Returns 1 if the image has up to date mipmaps.
+int nvgImageGenerateMipmaps(NVGcontext* ctx, int image);
+
 // Returns the dimensions of a created image.
 void nvgImageSize(NVGcontext* ctx, int image, int* w, int* h);
 
@@ -420,6 +466,11 @@ NVGpaint nvgRadialGradient(NVGcontext* ctx, float cx, float cy, float inr, float
 NVGpaint nvgImagePattern(NVGcontext* ctx, float ox, float oy, float ex, float ey,
 						 float angle, int image, float alpha);
 
+// Same as nvgImagePattern() for the sub-image (rx,ry,rw,rh) of an image, such as an entry in a texture atlas.
+// (ex,ey) is the size of the sub-image and sampling never reaches outside of it.
+NVGpaint nvgImageRegionPattern(NVGcontext* ctx, float ox, float oy, float ex, float ey, float angle,
+							   int image, float rx, float ry, float rw, float rh, float alpha);
+
 //
 // Scissoring
 //
@@ -553,12 +604,26 @@ int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int
 // Finds a loaded font of specified name, and returns handle to it, or -1 if the font is not found.
 int nvgFindFont(NVGcontext* ctx, const char* name);
 
+// Deletes a font, freeing its data and glyphs. Atlas space that only its glyphs
+// used is reused. The handle may be given to a font created later.
+// Returns 0 if there was no such font.
+int nvgDeleteFont(NVGcontext* ctx, int font);
+
+// Returns the number of fonts and the bytes their data and glyph caches take.
+// Either pointer can be NULL.
+void nvgFontStats(NVGcontext* ctx, int* fonts, int* bytes);
+
 // Adds a fallback font by handle.
 int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont);
 
 // Adds a fallback font by name.
 int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont);
 
+// Draws the font from signed distance fields. Each glyph is rasterized once and
+// scaled to every size and blur, instead of once per size and blur. Set it before
+// the font is drawn. Returns 0 if fontstash was built without support for it.
+int nvgFontSDF(NVGcontext* ctx, int font, int enabled);
+
 // Sets the font size of current text style.
 void nvgFontSize(NVGcontext* ctx, float size);
 
@@ -612,12 +677,27 @@ void nvgTextMetrics(NVGcontext* ctx, float* ascender, float* descender, float* l
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
 int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows);
 
+// Rasterizes the glyphs of the string in the given font, size and blur into the font atlas and
+// uploads them, so the first frame that draws them doesn't have to. Size and blur are those of
+// text drawn without scaling. Can be called outside of a frame.
+// Returns 0 if the atlas filled up before all the glyphs were in it.
+int nvgTextPrewarm(NVGcontext* ctx, int font, float size, float blur, const char* string, const char* end);
+
+// Rasterizes the glyphs of the string that the current text style doesn't have in the atlas yet,
+// several at once on worker threads. Call it before drawing a long text in pieces, such as one
+// nvgText() per line, so its new glyphs are made in one batch and uploaded together.
+void nvgTextRasterize(NVGcontext* ctx, const char* string, const char* end);
+
 //
 // Internal Render API
 //
 enum NVGtexture {
 	NVG_TEXTURE_ALPHA = 0x01,
 	NVG_TEXTURE_RGBA = 0x02,
+	NVG_TEXTURE_LUMINANCE = 0x03,
+	NVG_TEXTURE_LUMINANCE_ALPHA = 0x04,
+	NVG_TEXTURE_RGB = 0x05,
+	NVG_TEXTURE_COMPRESSED = 0x06,	// GPU compressed RGB(A), can't be updated
 };
 
 struct NVGscissor {
@@ -645,13 +725,21 @@ struct NVGpath {
 };
 typedef struct NVGpath NVGpath;
 
+// Widest blur renderTriangles is asked for, in pixels either side
+#define NVG_BLUR_RADIUS 32
+
 struct NVGparams {
 	void* userPtr;
 	int edgeAntiAlias;
+	int textBlur;			// renderTriangles blurs text itself, see NVGpaint.blur. Otherwise fontstash stores blurred glyphs
+
 	int (*renderCreate)(void* uptr);
 	int (*renderCreateTexture)(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
+	int (*renderCreateCompressedTexture)(void* uptr, unsigned int format, int w, int h, int levels, const unsigned char** data, const int* sizes, int imageFlags);
 	int (*renderDeleteTexture)(void* uptr, int image);
 	int (*renderUpdateTexture)(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data);
+	int (*renderUpdateTextureRect)(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data);
+	int (*renderGenerateMipmaps)(void* uptr, int image);
 	int (*renderGetTextureSize)(void* uptr, int image, int* w, int* h);
 	void (*renderViewport)(void* uptr, float width, float height, float devicePixelRatio);
 	void (*renderCancel)(void* uptr);
@@ -51,6 +51,13 @@ enum NVGcreateFlags {
 
 #define NANOVG_GL_USE_STATE_FILTER (1)
 
+// Blurred text is drawn through an offscreen framebuffer, which GL2 may not have
+#if defined NANOVG_GL2
+#  define NANOVG_GL_USE_BLUR (0)
+#else
+#  define NANOVG_GL_USE_BLUR (1)
+#endif
+
 // Creates NanoVG contexts for different OpenGL (ES) versions.
 // Flags should be combination of the create flags above.
 
@@ -124,7 +131,8 @@ enum GLNVGshaderType {
 	NSVG_SHADER_FILLGRAD,
 	NSVG_SHADER_FILLIMG,
 	NSVG_SHADER_SIMPLE,
-	NSVG_SHADER_IMG
+	NSVG_SHADER_IMG,
+	NSVG_SHADER_BLUR
 };
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
@@ -147,6 +155,7 @@ struct GLNVGtexture {
 	int width, height;
 	int type;
 	int flags;
+	int mipmapsStale;	// updated since its mipmaps were generated
 };
 typedef struct GLNVGtexture GLNVGtexture;
 
@@ -165,6 +174,7 @@ enum GLNVGcallType {
 	GLNVG_CONVEXFILL,
 	GLNVG_STROKE,
 	GLNVG_TRIANGLES,
+	GLNVG_BLUR,
 };
 
 struct GLNVGcall {
@@ -176,6 +186,10 @@ struct GLNVGcall {
 	int triangleCount;
 	int uniformOffset;
 	GLNVGblend blendFunc;
+	int blurRect[4];	// x, y, width and height of a GLNVG_BLUR on the target
+	int blurInset;		// pixels around the edge of the pass not drawn back, for tiles
+	int blurPage;		// and where its pass is in the blur pages
+	int blurX, blurY;
 };
 typedef struct GLNVGcall GLNVGcall;
 
@@ -202,10 +216,11 @@ struct GLNVGfragUniforms {
 		float strokeThr;
 		int texType;
 		int type;
+		float region[4];
 	#else
 		// note: after modifying layout or size of uniform array,
 		// don't forget to also update the fragment shader source!
-		#define NANOVG_GL_UNIFORMARRAY_SIZE 11
+		#define NANOVG_GL_UNIFORMARRAY_SIZE 12
 		union {
 			struct {
 				float scissorMat[12]; // matrices are actually 3 vec4s
@@ -221,6 +236,7 @@ struct GLNVGfragUniforms {
 				float strokeThr;
 				float texType;
 				float type;
+				float region[4];
 			};
 			float uniformArray[NANOVG_GL_UNIFORMARRAY_SIZE][4];
 		};
@@ -244,6 +260,18 @@ struct GLNVGcontext {
 #endif
 	int fragSize;
 	int flags;
+#if NANOVG_GL_USE_BLUR
+	// Blurred text is drawn into passes packed in pages. The glyphs of a page
+	// go into blurMask, are blurred across into the page's texture before
+	// anything else of the frame is drawn, and then down onto the target in
+	// turn. blurFbo is zero if the framebuffer isn't supported
+	GLuint blurFbo;
+	GLuint blurMask;
+	GLuint* blurPages;
+	int nblurPages;
+	int blurWidth, blurHeight;
+	int blurMaxSize;
+#endif
 
 	// Per frame buffers
 	GLNVGcall* calls;
@@ -272,6 +300,10 @@ struct GLNVGcontext {
 typedef struct GLNVGcontext GLNVGcontext;
 
 static int glnvg__maxi(int a, int b) { return a > b ? a : b; }
+static int glnvg__mini(int a, int b) { return a < b ? a : b; }
+
+#define GLNVG__STR2(x) #x
+#define GLNVG__STR(x) GLNVG__STR2(x)
 
 #ifdef NANOVG_GLES2
 static unsigned int glnvg__nearestPow2(unsigned int num)
@@ -500,6 +532,68 @@ static void glnvg__getUniforms(GLNVGshader* shader)
 #endif
 }
 
+#if NANOVG_GL_USE_BLUR
+static void glnvg__blurTexImage(GLNVGcontext* gl, GLuint tex)
+{
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, gl->blurWidth, gl->blurHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// makes sure there are npages pages of at least w by h pixels
+static int glnvg__sizeBlur(GLNVGcontext* gl, int npages, int w, int h)
+{
+	int i, grow = w > gl->blurWidth || h > gl->blurHeight;
+
+	if (grow) {
+		// in steps, so text growing a little each frame doesn't reallocate them every time
+		gl->blurWidth = glnvg__mini(glnvg__maxi(gl->blurWidth, (w + 63) & ~63), gl->blurMaxSize);
+		gl->blurHeight = glnvg__mini(glnvg__maxi(gl->blurHeight, (h + 63) & ~63), gl->blurMaxSize);
+		glnvg__blurTexImage(gl, gl->blurMask);
+		for (i = 0; i < gl->nblurPages; i++)
+			glnvg__blurTexImage(gl, gl->blurPages[i]);
+	}
+	if (npages > gl->nblurPages) {
+		GLuint* pages = (GLuint*)realloc(gl->blurPages, sizeof(GLuint) * npages);
+		if (pages == NULL) return 0;
+		gl->blurPages = pages;
+		glGenTextures(npages - gl->nblurPages, &pages[gl->nblurPages]);
+		for (i = gl->nblurPages; i < npages; i++)
+			glnvg__blurTexImage(gl, pages[i]);
+		gl->nblurPages = npages;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return 1;
+}
+
+// Without a complete framebuffer, fontstash goes on blurring glyphs instead
+static void glnvg__createBlur(GLNVGcontext* gl)
+{
+	GLint fbo;
+	GLenum status;
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl->blurMaxSize);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+	glGenFramebuffers(1, &gl->blurFbo);
+	glGenTextures(1, &gl->blurMask);
+	glnvg__sizeBlur(gl, 0, 64, 64);
+	glBindFramebuffer(GL_FRAMEBUFFER, gl->blurFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->blurMask, 0);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteFramebuffers(1, &gl->blurFbo);
+		glDeleteTextures(1, &gl->blurMask);
+		gl->blurFbo = 0;
+		gl->blurMask = 0;
+	}
+}
+#endif
+
 static int glnvg__renderCreate(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
@@ -524,8 +618,9 @@ static int glnvg__renderCreate(void* uptr)
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	"#define USE_UNIFORMBUFFER 1\n"
 #else
-	"#define UNIFORMARRAY_SIZE 11\n"
+	"#define UNIFORMARRAY_SIZE 12\n"
 #endif
+	"#define BLUR_RADIUS " GLNVG__STR(NVG_BLUR_RADIUS) "\n"
 	"\n";
 
 	static const char* fillVertShader =
@@ -572,6 +667,7 @@ static int glnvg__renderCreate(void* uptr)
 		"		float strokeThr;\n"
 		"		int texType;\n"
 		"		int type;\n"
+		"		vec4 region;\n"
 		"	};\n"
 		"#else\n" // NANOVG_GL3 && !USE_UNIFORMBUFFER
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
@@ -600,6 +696,7 @@ static int glnvg__renderCreate(void* uptr)
 		"	#define strokeThr frag[10].y\n"
 		"	#define texType int(frag[10].z)\n"
 		"	#define type int(frag[10].w)\n"
+		"	#define region frag[11]\n"
 		"#endif\n"
 		"\n"
 		"float sdroundrect(vec2 pt, vec2 ext, float rad) {\n"
@@ -641,6 +738,8 @@ static int glnvg__renderCreate(void* uptr)
 		"	} else if (type == 1) {		// Image\n"
 		"		// Calculate color fron texture\n"
 		"		vec2 pt = (paintMat * vec3(fpos,1.0)).xy / extent;\n"
+		"		// Keep sub-images from sampling their neighbours\n"
+		"		if (region.z > 0.0) pt = clamp(pt, region.xy, region.zw);\n"
 		"#ifdef NANOVG_GL3\n"
 		"		vec4 color = texture(tex, pt);\n"
 		"#else\n"
@@ -663,8 +762,34 @@ static int glnvg__renderCreate(void* uptr)
 		"#endif\n"
 		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
 		"		if (texType == 2) color = vec4(color.x);"
+		"		// Distance field text, radius is the value on the outline and feather its change over a pixel\n"
+		"		if (texType == 3) color = vec4(clamp((color.x - radius) / feather + 0.5, 0.0, 1.0));\n"
 		"		color *= scissor;\n"
 		"		result = color * innerCol;\n"
+		"	} else if (type == 4) {		// Blur in one direction, extent is the step between taps, radius the standard deviation and feather the taps either side\n"
+		"		// Gaussian weights by recurrence, w(x+1) = w(x) * q(x) and q(x+1) = q(x) * c\n"
+		"		float c = exp(-1.0 / (radius*radius));\n"
+		"		float q = exp(-0.5 / (radius*radius));\n"
+		"		float w = 1.0;\n"
+		"#ifdef NANOVG_GL3\n"
+		"		vec4 sum = texture(tex, ftcoord);\n"
+		"#else\n"
+		"		vec4 sum = texture2D(tex, ftcoord);\n"
+		"#endif\n"
+		"		float wsum = 1.0;\n"
+		"		for (int i = 1; i <= BLUR_RADIUS; i++) {\n"
+		"			if (float(i) > feather) break;\n"
+		"			w *= q;\n"
+		"			q *= c;\n"
+		"			vec2 d = extent * float(i);\n"
+		"#ifdef NANOVG_GL3\n"
+		"			sum += (texture(tex, ftcoord + d) + texture(tex, ftcoord - d)) * w;\n"
+		"#else\n"
+		"			sum += (texture2D(tex, ftcoord + d) + texture2D(tex, ftcoord - d)) * w;\n"
+		"#endif\n"
+		"			wsum += 2.0 * w;\n"
+		"		}\n"
+		"		result = sum / wsum * innerCol * scissor;\n"
 		"	}\n"
 		"#ifdef NANOVG_GL3\n"
 		"	outColor = result;\n"
@@ -692,6 +817,10 @@ static int glnvg__renderCreate(void* uptr)
 #endif
 	glGenBuffers(1, &gl->vertBuf);
 
+#if NANOVG_GL_USE_BLUR
+	glnvg__createBlur(gl);
+#endif
+
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	// Create UBOs
 	glUniformBlockBinding(gl->shader.prog, gl->shader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
@@ -707,10 +836,66 @@ static int glnvg__renderCreate(void* uptr)
 	return 1;
 }
 
+static int glnvg__textureBpp(int type)
+{
+	switch (type) {
+	case NVG_TEXTURE_RGBA: return 4;
+	case NVG_TEXTURE_RGB: return 3;
+	case NVG_TEXTURE_LUMINANCE_ALPHA: return 2;
+	default: return 1;
+	}
+}
+
+// GL formats used to upload each texture type. GLES2 and GL2 have native
+// luminance formats, GL3 and GLES3 store one or two channels and swizzle.
+static void glnvg__textureFormat(int type, GLint* internalFormat, GLenum* format)
+{
+	switch (type) {
+	case NVG_TEXTURE_RGBA:
+		*internalFormat = GL_RGBA;
+		*format = GL_RGBA;
+		break;
+	case NVG_TEXTURE_RGB:
+		*internalFormat = GL_RGB;
+		*format = GL_RGB;
+		break;
+#if defined(NANOVG_GLES2) || defined (NANOVG_GL2)
+	case NVG_TEXTURE_LUMINANCE_ALPHA:
+		*internalFormat = GL_LUMINANCE_ALPHA;
+		*format = GL_LUMINANCE_ALPHA;
+		break;
+	default:
+		*internalFormat = GL_LUMINANCE;
+		*format = GL_LUMINANCE;
+		break;
+#elif defined(NANOVG_GLES3)
+	case NVG_TEXTURE_LUMINANCE_ALPHA:
+		*internalFormat = GL_RG8;
+		*format = GL_RG;
+		break;
+	default:
+		*internalFormat = GL_R8;
+		*format = GL_RED;
+		break;
+#else
+	case NVG_TEXTURE_LUMINANCE_ALPHA:
+		*internalFormat = GL_RG;
+		*format = GL_RG;
+		break;
+	default:
+		*internalFormat = GL_RED;
+		*format = GL_RED;
+		break;
+#endif
+	}
+}
+
 static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	GLNVGtexture* tex = glnvg__allocTexture(gl);
+	GLint internalFormat;
+	GLenum format;
 
 	if (tex == NULL) return 0;
 
@@ -751,15 +936,16 @@ static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int im
 	}
 #endif
 
-	if (type == NVG_TEXTURE_RGBA)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	else
-#if defined(NANOVG_GLES2) || defined (NANOVG_GL2)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
-#elif defined(NANOVG_GLES3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, data);
-#else
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, data);
+	glnvg__textureFormat(type, &internalFormat, &format);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, data);
+
+#if !defined(NANOVG_GLES2) && !defined(NANOVG_GL2)
+	// red and red/green textures read back as gray and gray/alpha
+	if (type == NVG_TEXTURE_LUMINANCE || type == NVG_TEXTURE_LUMINANCE_ALPHA) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, type == NVG_TEXTURE_LUMINANCE ? GL_ONE : GL_GREEN);
+	}
 #endif
 
 	if (imageFlags & NVG_IMAGE_GENERATE_MIPMAPS) {
@@ -823,8 +1009,10 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	GLNVGtexture* tex = glnvg__findTexture(gl, image);
+	GLint internalFormat;
+	GLenum format;
 
-	if (tex == NULL) return 0;
+	if (tex == NULL || tex->type == NVG_TEXTURE_COMPRESSED) return 0;
 	glnvg__bindTexture(gl, tex->tex);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
@@ -835,22 +1023,13 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 	glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
 #else
 	// No support for all of skip, need to update a whole row at a time.
-	if (tex->type == NVG_TEXTURE_RGBA)
-		data += y*tex->width*4;
-	else
-		data += y*tex->width;
+	data += y*tex->width*glnvg__textureBpp(tex->type);
 	x = 0;
 	w = tex->width;
 #endif
 
-	if (tex->type == NVG_TEXTURE_RGBA)
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	else
-#if defined(NANOVG_GLES2) || defined(NANOVG_GL2)
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
-#else
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, GL_RED, GL_UNSIGNED_BYTE, data);
-#endif
+	glnvg__textureFormat(tex->type, &internalFormat, &format);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, format, GL_UNSIGNED_BYTE, data);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 #ifndef NANOVG_GLES2
@@ -859,11 +1038,139 @@ static int glnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w
 	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 #endif
 
+	// GL2 rebuilds the mipmaps itself. The others wait for glnvg__renderGenerateMipmaps,
+	// so textures updated every frame don't pay for them unless they are drawn minified
+	tex->mipmapsStale = 1;
+
 	glnvg__bindTexture(gl, 0);
 
 	return 1;
 }
 
+// the data is just the rectangle, so this works without GL_UNPACK_ROW_LENGTH
+// and doesn't need whole rows on GLES2
+static int glnvg__renderUpdateTextureRect(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGtexture* tex = glnvg__findTexture(gl, image);
+	GLint internalFormat;
+	GLenum format;
+
+	if (tex == NULL || tex->type == NVG_TEXTURE_COMPRESSED) return 0;
+	if (x < 0 || y < 0 || x + w > tex->width || y + h > tex->height) return 0;
+	glnvg__bindTexture(gl, tex->tex);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glnvg__textureFormat(tex->type, &internalFormat, &format);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, w,h, format, GL_UNSIGNED_BYTE, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	tex->mipmapsStale = 1;
+
+	glnvg__bindTexture(gl, 0);
+
+	return 1;
+}
+
+static int glnvg__renderGenerateMipmaps(void* uptr, int image)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGtexture* tex = glnvg__findTexture(gl, image);
+
+	if (tex == NULL) return 0;
+	// compressed textures only have the levels they came with
+	if (tex->type == NVG_TEXTURE_COMPRESSED) return (tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) != 0;
+#if defined(NANOVG_GL2)
+	return (tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) != 0;
+#else
+	if ((tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) && !tex->mipmapsStale) return 1;
+#ifdef NANOVG_GLES2
+	if (glnvg__nearestPow2(tex->width) != (unsigned int)tex->width ||
+		glnvg__nearestPow2(tex->height) != (unsigned int)tex->height) return 0;
+#endif
+
+	glnvg__bindTexture(gl, tex->tex);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	if ((tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) == 0) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			(tex->flags & NVG_IMAGE_NEAREST) ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+		tex->flags |= NVG_IMAGE_GENERATE_MIPMAPS;
+	}
+	tex->mipmapsStale = 0;
+	glnvg__bindTexture(gl, 0);
+
+	return 1;
+#endif
+}
+
+static int glnvg__compressedFormatSupported(GLenum format)
+{
+	GLint count = 0, i;
+	GLint* formats;
+	int found = 0;
+
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+	if (count <= 0) return 0;
+	formats = (GLint*)malloc(sizeof(GLint) * count);
+	if (formats == NULL) return 0;
+	glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+	for (i = 0; i < count; i++) {
+		if ((GLenum)formats[i] == format) found = 1;
+	}
+	free(formats);
+	return found;
+}
+
+static int glnvg__renderCreateCompressedTexture(void* uptr, unsigned int format, int w, int h, int levels,
+												const unsigned char** data, const int* sizes, int imageFlags)
+{
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLNVGtexture* tex;
+	int i, lw = w, lh = h, full = 0;
+
+	if (!glnvg__compressedFormatSupported(format)) return 0;
+	tex = glnvg__allocTexture(gl);
+	if (tex == NULL) return 0;
+
+	glGenTextures(1, &tex->tex);
+	tex->width = w;
+	tex->height = h;
+	tex->type = NVG_TEXTURE_COMPRESSED;
+	tex->flags = imageFlags & ~NVG_IMAGE_GENERATE_MIPMAPS;
+	glnvg__bindTexture(gl, tex->tex);
+
+	// Compressed textures can't generate their mipmaps, so only use the ones given.
+	while (glGetError() != GL_NO_ERROR) {}
+	for (i = 0; i < levels; i++) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, format, lw, lh, 0, sizes[i], data[i]);
+		if (lw == 1 && lh == 1) {
+			full = 1;
+			break;
+		}
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+	if (glGetError() != GL_NO_ERROR) {
+		glnvg__bindTexture(gl, 0);
+		glnvg__deleteTexture(gl, tex->id);
+		return 0;
+	}
+
+	if (full) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			(imageFlags & NVG_IMAGE_NEAREST) ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+		tex->flags |= NVG_IMAGE_GENERATE_MIPMAPS;	// marks it as having them
+	} else {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (imageFlags & NVG_IMAGE_NEAREST) ? GL_NEAREST : GL_LINEAR);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (imageFlags & NVG_IMAGE_NEAREST) ? GL_NEAREST : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (imageFlags & NVG_IMAGE_REPEATX) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (imageFlags & NVG_IMAGE_REPEATY) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+
+	glnvg__bindTexture(gl, 0);
+
+	return tex->id;
+}
+
 static int glnvg__renderGetTextureSize(void* uptr, int image, int* w, int* h)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
@@ -944,14 +1251,15 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 			nvgTransformInverse(invxform, paint->xform);
 		}
 		frag->type = NSVG_SHADER_FILLIMG;
+		memcpy(frag->region, paint->region, sizeof(frag->region));
 
 		#if NANOVG_GL_USE_UNIFORMBUFFER
-		if (tex->type == NVG_TEXTURE_RGBA)
+		if (tex->type != NVG_TEXTURE_ALPHA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
 		else
 			frag->texType = 2;
 		#else
-		if (tex->type == NVG_TEXTURE_RGBA)
+		if (tex->type != NVG_TEXTURE_ALPHA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0.0f : 1.0f;
 		else
 			frag->texType = 2.0f;
@@ -1113,6 +1421,176 @@ static void glnvg__triangles(GLNVGcontext* gl, GLNVGcall* call)
 	glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
 }
 
+#if NANOVG_GL_USE_BLUR
+static void glnvg__vset(NVGvertex* vtx, float x, float y, float u, float v);
+
+// Packs the passes of the frame's blurs into pages in rows, sizes the pages
+// and moves each blur's glyphs and quads onto its place. Passes are
+// NVG_BLUR_RADIUS apart, so the taps of one never reach the glyphs of another
+static int glnvg__prepareBlur(GLNVGcontext* gl)
+{
+	int i, j, maxw = 0, limit, x = 0, y = 0, rowh = 0, page = 0, w = 0, h = 0;
+	const int gap = NVG_BLUR_RADIUS;
+
+	for (i = 0; i < gl->ncalls; i++) {
+		if (gl->calls[i].type == GLNVG_BLUR)
+			maxw = glnvg__maxi(maxw, gl->calls[i].blurRect[2]);
+	}
+	if (maxw == 0) return 0;
+	limit = glnvg__mini(glnvg__maxi(maxw, (int)gl->view[0]), gl->blurMaxSize);
+
+	for (i = 0; i < gl->ncalls; i++) {
+		GLNVGcall* call = &gl->calls[i];
+		if (call->type != GLNVG_BLUR) continue;
+		if (x > 0 && x + call->blurRect[2] > limit) {
+			x = 0;
+			y += rowh + gap;
+			rowh = 0;
+		}
+		if (y > 0 && y + call->blurRect[3] > gl->blurMaxSize) {
+			page++;
+			y = 0;
+		}
+		call->blurPage = page;
+		call->blurX = x;
+		call->blurY = y;
+		x += call->blurRect[2] + gap;
+		rowh = glnvg__maxi(rowh, call->blurRect[3]);
+		w = glnvg__maxi(w, x - gap);
+		h = glnvg__maxi(h, y + rowh);
+	}
+	if (!glnvg__sizeBlur(gl, page + 1, w, h)) return 0;
+
+	for (i = 0; i < gl->ncalls; i++) {
+		GLNVGcall* call = &gl->calls[i];
+		NVGvertex* quads;
+		GLNVGfragUniforms* frag;
+		float x0, y0, x1, y1, s0, t0, s1, t1;
+		if (call->type != GLNVG_BLUR) continue;
+
+		for (j = 0; j < call->triangleCount; j++) {
+			gl->verts[call->triangleOffset + j].x += call->blurX;
+			gl->verts[call->triangleOffset + j].y += call->blurY;
+		}
+		// the pass's place in the page, which is drawn upside down
+		x0 = (float)call->blurX;
+		y0 = (float)call->blurY;
+		x1 = x0 + call->blurRect[2];
+		y1 = y0 + call->blurRect[3];
+		s0 = x0 / gl->blurWidth;
+		s1 = x1 / gl->blurWidth;
+		t0 = (gl->blurHeight - y0) / gl->blurHeight;
+		t1 = (gl->blurHeight - y1) / gl->blurHeight;
+		quads = &gl->verts[call->triangleOffset + call->triangleCount];
+		glnvg__vset(&quads[0], x0, y0, s0, t0);
+		glnvg__vset(&quads[1], x1, y1, s1, t1);
+		glnvg__vset(&quads[2], x1, y0, s1, t0);
+		glnvg__vset(&quads[3], x0, y0, s0, t0);
+		glnvg__vset(&quads[4], x0, y1, s0, t1);
+		glnvg__vset(&quads[5], x1, y1, s1, t1);
+		// and the same on the target, less the inset of a tile
+		x0 += call->blurInset;
+		y0 += call->blurInset;
+		x1 -= call->blurInset;
+		y1 -= call->blurInset;
+		s0 = x0 / gl->blurWidth;
+		s1 = x1 / gl->blurWidth;
+		t0 = (gl->blurHeight - y0) / gl->blurHeight;
+		t1 = (gl->blurHeight - y1) / gl->blurHeight;
+		glnvg__vset(&quads[6], x0, y0, s0, t0);
+		glnvg__vset(&quads[7], x1, y1, s1, t1);
+		glnvg__vset(&quads[8], x1, y0, s1, t0);
+		glnvg__vset(&quads[9], x0, y0, s0, t0);
+		glnvg__vset(&quads[10], x0, y1, s0, t1);
+		glnvg__vset(&quads[11], x1, y1, s1, t1);
+		for (j = 6; j < 12; j++) {
+			quads[j].x += call->blurRect[0] - call->blurX;
+			quads[j].y += call->blurRect[1] - call->blurY;
+		}
+
+		// The step between taps. Both components are set, as convertPaint
+		// leaves the extent of a gradient or image fill in them
+		frag = nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize);
+		frag->extent[0] = 1.0f / gl->blurWidth;
+		frag->extent[1] = 0.0f;
+		frag = nvg__fragUniformPtr(gl, call->uniformOffset + 2*gl->fragSize);
+		frag->extent[0] = 0.0f;
+		frag->extent[1] = 1.0f / gl->blurHeight;
+	}
+	return 1;
+}
+
+// Draws the glyphs of every blur and blurs them across, a page at a time.
+// Done before anything else of the frame, so the target isn't left and
+// picked up again for each blur, which tiled GPUs pay for
+static void glnvg__blurPages(GLNVGcontext* gl)
+{
+	static const GLNVGblend over = {GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA};
+	float view[2] = {(float)gl->blurWidth, (float)gl->blurHeight};
+	GLint fbo, viewport[4];
+	GLfloat clear[4];
+	int i, page;
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gl->blurFbo);
+	glViewport(0, 0, gl->blurWidth, gl->blurHeight);
+	glClearColor(0, 0, 0, 0);
+	glUniform2fv(gl->shader.loc[GLNVG_LOC_VIEWSIZE], 1, view);
+
+	for (page = 0; page < gl->nblurPages; page++) {
+		int used = 0;
+		for (i = 0; i < gl->ncalls && !used; i++)
+			used = gl->calls[i].type == GLNVG_BLUR && gl->calls[i].blurPage == page;
+		if (!used) break;
+
+		// The glyphs' coverage, in white. Scissored to each pass, as glyphs
+		// off the target or off a tile would land on the passes next to it
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->blurMask, 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glnvg__blendFuncSeparate(gl, &over);
+		glEnable(GL_SCISSOR_TEST);
+		for (i = 0; i < gl->ncalls; i++) {
+			GLNVGcall* call = &gl->calls[i];
+			if (call->type != GLNVG_BLUR || call->blurPage != page) continue;
+			glScissor(call->blurX, gl->blurHeight - call->blurY - call->blurRect[3], call->blurRect[2], call->blurRect[3]);
+			glnvg__setUniforms(gl, call->uniformOffset, call->image);
+			glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
+		}
+		glDisable(GL_SCISSOR_TEST);
+
+		// Blurred across. Everything between the passes is cleared
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->blurPages[page], 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_BLEND);
+		for (i = 0; i < gl->ncalls; i++) {
+			GLNVGcall* call = &gl->calls[i];
+			if (call->type != GLNVG_BLUR || call->blurPage != page) continue;
+			glnvg__setUniforms(gl, call->uniformOffset + gl->fragSize, 0);
+			glnvg__bindTexture(gl, gl->blurMask);
+			glDrawArrays(GL_TRIANGLES, call->triangleOffset + call->triangleCount, 6);
+		}
+		glEnable(GL_BLEND);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clear[0], clear[1], clear[2], clear[3]);
+	glUniform2fv(gl->shader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
+	glnvg__checkError(gl, "blur pages");
+}
+
+// blurs a page's pass down, onto the target
+static void glnvg__blur(GLNVGcontext* gl, GLNVGcall* call)
+{
+	glnvg__setUniforms(gl, call->uniformOffset + 2*gl->fragSize, 0);
+	glnvg__bindTexture(gl, gl->blurPages[call->blurPage]);
+	glDrawArrays(GL_TRIANGLES, call->triangleOffset + call->triangleCount + 6, 6);
+}
+#endif
+
 static void glnvg__renderCancel(void* uptr) {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	gl->nverts = 0;
@@ -1171,6 +1649,9 @@ static void glnvg__renderFlush(void* uptr)
 	int i;
 
 	if (gl->ncalls > 0) {
+#if NANOVG_GL_USE_BLUR
+		int blur = glnvg__prepareBlur(gl);
+#endif
 
 		// Setup require GL state.
 		glUseProgram(gl->shader.prog);
@@ -1224,6 +1705,11 @@ static void glnvg__renderFlush(void* uptr)
 		glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
 #endif
 
+#if NANOVG_GL_USE_BLUR
+		if (blur)
+			glnvg__blurPages(gl);
+#endif
+
 		for (i = 0; i < gl->ncalls; i++) {
 			GLNVGcall* call = &gl->calls[i];
 			glnvg__blendFuncSeparate(gl,&call->blendFunc);
@@ -1235,6 +1721,10 @@ static void glnvg__renderFlush(void* uptr)
 				glnvg__stroke(gl, call);
 			else if (call->type == GLNVG_TRIANGLES)
 				glnvg__triangles(gl, call);
+#if NANOVG_GL_USE_BLUR
+			else if (call->type == GLNVG_BLUR && call->blurPage < gl->nblurPages)
+				glnvg__blur(gl, call);
+#endif
 		}
 
 		glDisableVertexAttribArray(0);
@@ -1480,13 +1970,132 @@ error:
 	if (gl->ncalls > 0) gl->ncalls--;
 }
 
+#if NANOVG_GL_USE_BLUR
+// One offscreen pass of blurred text, covering x0,y0 to x1,y1 on the target.
+// The inset around its edge is only read by the taps, not drawn back
+static void glnvg__blurPass(GLNVGcontext* gl, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							const NVGvertex* verts, int nverts, int x0, int y0, int x1, int y1, int inset)
+{
+	GLNVGcall* call;
+	GLNVGfragUniforms* frag;
+	NVGpaint glyphs;
+	NVGscissor unclipped;
+	int i;
+
+	call = glnvg__allocCall(gl);
+	if (call == NULL) return;
+
+	call->type = GLNVG_BLUR;
+	call->image = paint->image;
+	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
+	call->blurRect[0] = x0;
+	call->blurRect[1] = y0;
+	call->blurRect[2] = x1 - x0;
+	call->blurRect[3] = y1 - y0;
+	call->blurInset = inset;
+
+	// The glyphs, from the corner of the pass, and room for a quad over the
+	// pass and one over the target. glnvg__prepareBlur places them
+	call->triangleOffset = glnvg__allocVerts(gl, nverts + 12);
+	if (call->triangleOffset == -1) goto error;
+	call->triangleCount = nverts;
+	for (i = 0; i < nverts; i++)
+		glnvg__vset(&gl->verts[call->triangleOffset + i], verts[i].x - x0, verts[i].y - y0, verts[i].u, verts[i].v);
+
+	call->uniformOffset = glnvg__allocFragUniforms(gl, 3);
+	if (call->uniformOffset == -1) goto error;
+
+	// The glyphs in white, unclipped
+	glyphs = *paint;
+	glyphs.innerColor = glyphs.outerColor = nvgRGBAf(1, 1, 1, 1);
+	memset(&unclipped, 0, sizeof(unclipped));
+	unclipped.extent[0] = unclipped.extent[1] = -1.0f;
+	frag = nvg__fragUniformPtr(gl, call->uniformOffset);
+	glnvg__convertPaint(gl, frag, &glyphs, &unclipped, 1.0f, 1.0f, -1.0f);
+	frag->type = NSVG_SHADER_IMG;
+
+	// Across, still in white
+	frag = nvg__fragUniformPtr(gl, call->uniformOffset + gl->fragSize);
+	glnvg__convertPaint(gl, frag, &glyphs, &unclipped, 1.0f, 1.0f, -1.0f);
+	frag->type = NSVG_SHADER_BLUR;
+	frag->radius = paint->blur[0];
+	frag->feather = paint->blur[1];
+
+	// Down, in the paint's color and scissor
+	frag = nvg__fragUniformPtr(gl, call->uniformOffset + 2*gl->fragSize);
+	glnvg__convertPaint(gl, frag, paint, scissor, 1.0f, 1.0f, -1.0f);
+	frag->type = NSVG_SHADER_BLUR;
+	frag->radius = paint->blur[0];
+	frag->feather = paint->blur[1];
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (gl->ncalls > 0) gl->ncalls--;
+}
+
+// Text with paint->blur. The glyphs are drawn unblurred into an offscreen
+// pass with room for the blur around them, which is blurred across and then
+// down onto the target. A run bigger than a texture is split into tiles,
+// each with the blur's reach of glyphs around it
+static void glnvg__renderBlur(GLNVGcontext* gl, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							  const NVGvertex* verts, int nverts)
+{
+	float minx = 1e6f, miny = 1e6f, maxx = -1e6f, maxy = -1e6f;
+	int i, x, y, x0, y0, x1, y1, tile, r = (int)paint->blur[1];
+
+	for (i = 0; i < nverts; i++) {
+		minx = minx < verts[i].x ? minx : verts[i].x;
+		miny = miny < verts[i].y ? miny : verts[i].y;
+		maxx = maxx > verts[i].x ? maxx : verts[i].x;
+		maxy = maxy > verts[i].y ? maxy : verts[i].y;
+	}
+	// In whole pixels, so the pass lines up with the target. Only as far
+	// past the target, and the scissor, as the blur reaches
+	x0 = glnvg__maxi((int)floorf(minx) - r, -r);
+	y0 = glnvg__maxi((int)floorf(miny) - r, -r);
+	x1 = glnvg__mini((int)ceilf(maxx) + r, (int)gl->view[0] + r);
+	y1 = glnvg__mini((int)ceilf(maxy) + r, (int)gl->view[1] + r);
+	if (scissor->extent[0] > -0.5f) {
+		float ex = fabsf(scissor->xform[0]) * scissor->extent[0] + fabsf(scissor->xform[2]) * scissor->extent[1];
+		float ey = fabsf(scissor->xform[1]) * scissor->extent[0] + fabsf(scissor->xform[3]) * scissor->extent[1];
+		x0 = glnvg__maxi(x0, (int)floorf(scissor->xform[4] - ex) - r);
+		y0 = glnvg__maxi(y0, (int)floorf(scissor->xform[5] - ey) - r);
+		x1 = glnvg__mini(x1, (int)ceilf(scissor->xform[4] + ex) + r);
+		y1 = glnvg__mini(y1, (int)ceilf(scissor->xform[5] + ey) + r);
+	}
+	if (x0 >= x1 || y0 >= y1) return;
+	if (x1 - x0 <= gl->blurMaxSize && y1 - y0 <= gl->blurMaxSize) {
+		glnvg__blurPass(gl, paint, compositeOperation, scissor, verts, nverts, x0, y0, x1, y1, 0);
+		return;
+	}
+
+	tile = gl->blurMaxSize - 2*r;
+	for (y = y0; y < y1; y += tile) {
+		for (x = x0; x < x1; x += tile) {
+			glnvg__blurPass(gl, paint, compositeOperation, scissor, verts, nverts,
+							x - r, y - r, glnvg__mini(x + tile, x1) + r, glnvg__mini(y + tile, y1) + r, r);
+		}
+	}
+}
+#endif
+
 static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
 								   const NVGvertex* verts, int nverts)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
-	GLNVGcall* call = glnvg__allocCall(gl);
+	GLNVGcall* call;
 	GLNVGfragUniforms* frag;
 
+#if NANOVG_GL_USE_BLUR
+	if (paint->blur[0] > 0.0f && gl->blurFbo != 0) {
+		glnvg__renderBlur(gl, paint, compositeOperation, scissor, verts, nverts);
+		return;
+	}
+#endif
+
+	call = glnvg__allocCall(gl);
 	if (call == NULL) return;
 
 	call->type = GLNVG_TRIANGLES;
@@ -1506,6 +2115,11 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 	frag = nvg__fragUniformPtr(gl, call->uniformOffset);
 	glnvg__convertPaint(gl, frag, paint, scissor, 1.0f, 1.0f, -1.0f);
 	frag->type = NSVG_SHADER_IMG;
+	if (paint->sdf[1] > 0.0f) {
+		frag->texType = 3;
+		frag->radius = paint->sdf[0];
+		frag->feather = paint->sdf[1];
+	}
 
 	return;
 
@@ -1533,6 +2147,15 @@ static void glnvg__renderDelete(void* uptr)
 #endif
 	if (gl->vertBuf != 0)
 		glDeleteBuffers(1, &gl->vertBuf);
+#if NANOVG_GL_USE_BLUR
+	if (gl->blurFbo != 0) {
+		glDeleteFramebuffers(1, &gl->blurFbo);
+		glDeleteTextures(1, &gl->blurMask);
+	}
+	if (gl->nblurPages > 0)
+		glDeleteTextures(gl->nblurPages, gl->blurPages);
+	free(gl->blurPages);
+#endif
 
 	for (i = 0; i < gl->ntextures; i++) {
 		if (gl->textures[i].tex != 0 && (gl->textures[i].flags & NVG_IMAGE_NODELETE) == 0)
@@ -1568,8 +2191,11 @@ NVGcontext* nvgCreateGLES3(int flags)
 	memset(&params, 0, sizeof(params));
 	params.renderCreate = glnvg__renderCreate;
 	params.renderCreateTexture = glnvg__renderCreateTexture;
+	params.renderCreateCompressedTexture = glnvg__renderCreateCompressedTexture;
 	params.renderDeleteTexture = glnvg__renderDeleteTexture;
 	params.renderUpdateTexture = glnvg__renderUpdateTexture;
+	params.renderUpdateTextureRect = glnvg__renderUpdateTextureRect;
+	params.renderGenerateMipmaps = glnvg__renderGenerateMipmaps;
 	params.renderGetTextureSize = glnvg__renderGetTextureSize;
 	params.renderViewport = glnvg__renderViewport;
 	params.renderCancel = glnvg__renderCancel;
@@ -1586,6 +2212,11 @@ NVGcontext* nvgCreateGLES3(int flags)
 	ctx = nvgCreateInternal(&params);
 	if (ctx == NULL) goto error;
 
+#if NANOVG_GL_USE_BLUR
+	// renderCreate has found out if the blur's framebuffer works
+	nvgInternalParams(ctx)->textBlur = gl->blurFbo != 0;
+#endif
+
 	return ctx;
 
 error:
@@ -0,0 +1,1391 @@
+//
+// Software render back-end for nanovg
+//
+// Renders into a caller supplied buffer of 32 bit premultiplied ARGB pixels
+// (0xAARRGGBB as a native uint32_t, which is DRM_FORMAT_ARGB8888 on little
+// endian machines). No GL, EGL or GPU is involved.
+//
+// Paths are rasterized with exact area coverage: every edge adds its signed
+// area to an accumulation buffer covering the bounds of the draw, and a
+// running sum along each row gives the coverage of each pixel. This gives
+// the same anti-aliasing as nanovg's fringe geometry, so nanovg is asked not
+// to generate any (edgeAntiAlias is off). Spans are shaded and blended four
+// pixels at a time with GCC vector extensions, which map onto SSE or NEON.
+//
+// The paint model follows the GL back-end's fragment shader: box gradients,
+// image patterns with bilinear (or trilinear, once an image has mipmaps)
+// sampling, scissoring and textured triangles for text, blurred text included.
+// Only source-over compositing is implemented; other composite operations
+// are drawn as source-over.
+//
+// Usage is the same as nanovg_gl.h. Define NANOVG_SW_IMPLEMENTATION in
+// exactly one file before including this header.
+//
+
+#ifndef NANOVG_SW_H
+#define NANOVG_SW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Create flags
+enum NVGswCreateFlags {
+	// Anti-alias edges using their exact coverage. Without it a pixel is either
+	// fully in or fully out. Same value as NVG_ANTIALIAS.
+	NVG_SW_ANTIALIAS		= 1<<0,
+};
+
+NVGcontext* nvgCreateSW(int flags);
+void nvgDeleteSW(NVGcontext* ctx);
+
+// Sets the buffer to render into. stride is the length of a row in bytes.
+// The buffer must stay valid until the next call or until the context is
+// deleted.
+void nvgSWSetTarget(NVGcontext* ctx, void* pixels, int width, int height, int stride);
+
+// Fills the whole target with a (non premultiplied) color.
+void nvgSWClear(NVGcontext* ctx, NVGcolor color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANOVG_SW_H */
+
+#ifdef NANOVG_SW_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "nanovg.h"
+
+typedef float swnvg__v4f __attribute__((vector_size(16)));
+typedef uint32_t swnvg__v4u __attribute__((vector_size(16)));
+typedef int32_t swnvg__v4i __attribute__((vector_size(16)));
+
+enum SWNVGpaintType {
+	SWNVG_PAINT_SOLID,
+	SWNVG_PAINT_GRADIENT,
+	SWNVG_PAINT_IMAGE,
+};
+
+struct SWNVGtexture {
+	int id;
+	int width, height;
+	int type;
+	int flags;
+	// premultiplied RGBA whatever the source format, or one byte per
+	// pixel for alpha textures
+	unsigned char* data;
+	// mip levels 1 and up, one after the other, once they are generated.
+	// Updates leave them stale, like the GL back-end
+	unsigned char* mips;
+	int nlevels;
+	int mipmapsStale;
+};
+typedef struct SWNVGtexture SWNVGtexture;
+
+struct SWNVGpaint {
+	int type;
+	float innerCol[4];
+	float outerCol[4];
+	float paintMat[6];
+	float extent[2];
+	float radius;
+	float feather;
+	SWNVGtexture* tex;
+	float region[4];
+	float lod;
+	float sdf[2];
+	float blur[2];
+	int scissor;
+	float scissorMat[6];
+	float scissorExt[2];
+	float scissorScale[2];
+	float scissorBounds[4];
+};
+typedef struct SWNVGpaint SWNVGpaint;
+
+// the part of the accumulation buffer used by one draw
+struct SWNVGraster {
+	int x, y;
+	int w, h;
+	int stride;
+	float* acc;
+};
+typedef struct SWNVGraster SWNVGraster;
+
+struct SWNVGcontext {
+	int flags;
+	uint32_t* pixels;
+	int width, height;
+	int stride;
+	SWNVGtexture* textures;
+	int ntextures;
+	int ctextures;
+	int textureId;
+	// accumulation buffer. Always kept zeroed between draws
+	float* acc;
+	int cacc;
+	// one row of coverage and one row of planar RGBA colors
+	float* cover;
+	float* span;
+	int cspan;
+	// coverage of blurred text, before and after blurring across
+	float* blur;
+	int cblur;
+};
+typedef struct SWNVGcontext SWNVGcontext;
+
+static float swnvg__minf(float a, float b) { return a < b ? a : b; }
+static float swnvg__maxf(float a, float b) { return a > b ? a : b; }
+static float swnvg__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
+static int swnvg__mini(int a, int b) { return a < b ? a : b; }
+static int swnvg__maxi(int a, int b) { return a > b ? a : b; }
+
+//
+// Textures
+//
+
+static SWNVGtexture* swnvg__allocTexture(SWNVGcontext* sw)
+{
+	SWNVGtexture* tex = NULL;
+	int i;
+
+	for (i = 0; i < sw->ntextures; i++) {
+		if (sw->textures[i].id == 0) {
+			tex = &sw->textures[i];
+			break;
+		}
+	}
+	if (tex == NULL) {
+		if (sw->ntextures+1 > sw->ctextures) {
+			SWNVGtexture* textures;
+			int ctextures = swnvg__maxi(sw->ntextures+1, 4) + sw->ctextures/2; // 1.5x Overallocate
+			textures = (SWNVGtexture*)realloc(sw->textures, sizeof(SWNVGtexture)*ctextures);
+			if (textures == NULL) return NULL;
+			sw->textures = textures;
+			sw->ctextures = ctextures;
+		}
+		tex = &sw->textures[sw->ntextures++];
+	}
+
+	memset(tex, 0, sizeof(*tex));
+	tex->id = ++sw->textureId;
+
+	return tex;
+}
+
+static SWNVGtexture* swnvg__findTexture(SWNVGcontext* sw, int id)
+{
+	int i;
+	for (i = 0; i < sw->ntextures; i++)
+		if (sw->textures[i].id == id)
+			return &sw->textures[i];
+	return NULL;
+}
+
+static int swnvg__sourceBpp(int type)
+{
+	switch (type) {
+	case NVG_TEXTURE_RGBA: return 4;
+	case NVG_TEXTURE_RGB: return 3;
+	case NVG_TEXTURE_LUMINANCE_ALPHA: return 2;
+	default: return 1;
+	}
+}
+
+// copies a rect of pixels in, expanding luminance and RGB data to RGBA and
+// premultiplying data that isn't already. data is the top left pixel of the
+// rect, and rows of it are stride pixels apart
+static void swnvg__copyTexture(SWNVGtexture* tex, int x, int y, int w, int h, const unsigned char* data, int stride)
+{
+	int sbpp = swnvg__sourceBpp(tex->type);
+	int dbpp = tex->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+	int premultiply = (tex->type == NVG_TEXTURE_RGBA || tex->type == NVG_TEXTURE_LUMINANCE_ALPHA) &&
+		(tex->flags & NVG_IMAGE_PREMULTIPLIED) == 0;
+	int row, i;
+
+	for (row = y; row < y+h; row++) {
+		const unsigned char* src = data + (size_t)(row - y)*stride*sbpp;
+		unsigned char* dst = tex->data + ((size_t)row*tex->width + x)*dbpp;
+		if (sbpp == dbpp && !premultiply) {
+			memcpy(dst, src, (size_t)w*dbpp);
+			continue;
+		}
+		for (i = 0; i < w; i++) {
+			unsigned int r, g, b, a;
+			switch (tex->type) {
+			case NVG_TEXTURE_RGB: r = src[0]; g = src[1]; b = src[2]; a = 255; break;
+			case NVG_TEXTURE_LUMINANCE_ALPHA: r = g = b = src[0]; a = src[1]; break;
+			case NVG_TEXTURE_LUMINANCE: r = g = b = src[0]; a = 255; break;
+			default: r = src[0]; g = src[1]; b = src[2]; a = src[3]; break;
+			}
+			if (premultiply) {
+				r = (r*a + 127) / 255;
+				g = (g*a + 127) / 255;
+				b = (b*a + 127) / 255;
+			}
+			dst[0] = r;
+			dst[1] = g;
+			dst[2] = b;
+			dst[3] = a;
+			src += sbpp;
+			dst += 4;
+		}
+	}
+}
+
+// size and pixels of a mip level. Level 0 is the image itself
+static const unsigned char* swnvg__level(const SWNVGtexture* tex, int level, int* w, int* h)
+{
+	int bpp = tex->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+	const unsigned char* data = tex->mips;
+	int i;
+
+	*w = tex->width;
+	*h = tex->height;
+	if (level == 0) return tex->data;
+	for (i = 1; i < level; i++) {
+		*w = swnvg__maxi(*w >> 1, 1);
+		*h = swnvg__maxi(*h >> 1, 1);
+		data += (size_t)*w * *h * bpp;
+	}
+	*w = swnvg__maxi(*w >> 1, 1);
+	*h = swnvg__maxi(*h >> 1, 1);
+	return data;
+}
+
+// averages 2x2 blocks of each level into the next, as glGenerateMipmap does
+static int swnvg__generateMipmaps(SWNVGtexture* tex)
+{
+	int bpp = tex->type == NVG_TEXTURE_ALPHA ? 1 : 4;
+	int w = tex->width, h = tex->height, nlevels = 0;
+	size_t size = 0;
+	int level, x, y, c;
+
+	while (w > 1 || h > 1) {
+		w = swnvg__maxi(w >> 1, 1);
+		h = swnvg__maxi(h >> 1, 1);
+		size += (size_t)w*h*bpp;
+		nlevels++;
+	}
+	if (tex->mips == NULL && nlevels > 0) {
+		tex->mips = (unsigned char*)malloc(size);
+		if (tex->mips == NULL) return 0;
+	}
+	tex->nlevels = nlevels;
+	tex->mipmapsStale = 0;
+
+	for (level = 1; level <= nlevels; level++) {
+		int sw, sh, dw, dh;
+		const unsigned char* src = swnvg__level(tex, level-1, &sw, &sh);
+		unsigned char* dst = (unsigned char*)swnvg__level(tex, level, &dw, &dh);
+		for (y = 0; y < dh; y++) {
+			const unsigned char* row0 = src + (size_t)swnvg__mini(y*2, sh-1)*sw*bpp;
+			const unsigned char* row1 = src + (size_t)swnvg__mini(y*2+1, sh-1)*sw*bpp;
+			for (x = 0; x < dw; x++) {
+				int x0 = swnvg__mini(x*2, sw-1)*bpp, x1 = swnvg__mini(x*2+1, sw-1)*bpp;
+				for (c = 0; c < bpp; c++)
+					*dst++ = (row0[x0+c] + row0[x1+c] + row1[x0+c] + row1[x1+c] + 2) / 4;
+			}
+		}
+	}
+	return 1;
+}
+
+static int swnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__allocTexture(sw);
+	int bpp = type == NVG_TEXTURE_ALPHA ? 1 : 4;
+
+	if (tex == NULL) return 0;
+
+	tex->data = (unsigned char*)calloc((size_t)w*h, bpp);
+	if (tex->data == NULL) {
+		tex->id = 0;
+		return 0;
+	}
+	tex->width = w;
+	tex->height = h;
+	tex->type = type;
+	tex->flags = imageFlags;
+
+	if (data != NULL)
+		swnvg__copyTexture(tex, 0, 0, w, h, data, w);
+	if (imageFlags & NVG_IMAGE_GENERATE_MIPMAPS)
+		swnvg__generateMipmaps(tex);
+
+	return tex->id;
+}
+
+static int swnvg__renderDeleteTexture(void* uptr, int image)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	free(tex->data);
+	free(tex->mips);
+	memset(tex, 0, sizeof(*tex));
+	return 1;
+}
+
+static int swnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+
+	if (tex == NULL) return 0;
+	// data is the whole image, the same as the GL back-end gets
+	swnvg__copyTexture(tex, x, y, w, h, data + ((size_t)y*tex->width + x)*swnvg__sourceBpp(tex->type), tex->width);
+	tex->mipmapsStale = 1;
+	return 1;
+}
+
+static int swnvg__renderUpdateTextureRect(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+
+	if (tex == NULL) return 0;
+	if (x < 0 || y < 0 || x + w > tex->width || y + h > tex->height) return 0;
+	swnvg__copyTexture(tex, x, y, w, h, data, w);
+	tex->mipmapsStale = 1;
+	return 1;
+}
+
+static int swnvg__renderGenerateMipmaps(void* uptr, int image)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	if ((tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) && !tex->mipmapsStale) return 1;
+	if (!swnvg__generateMipmaps(tex)) return 0;
+	tex->flags |= NVG_IMAGE_GENERATE_MIPMAPS;
+	return 1;
+}
+
+static int swnvg__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	*w = tex->width;
+	*h = tex->height;
+	return 1;
+}
+
+// wraps or clamps a texel coordinate the way the GL back-end sets up its textures
+static int swnvg__texel(int i, int size, int repeat)
+{
+	if (repeat) {
+		i %= size;
+		return i < 0 ? i + size : i;
+	}
+	return i < 0 ? 0 : (i >= size ? size-1 : i);
+}
+
+// samples one level of a texture at normalized coordinates. Returns
+// premultiplied RGBA in 0..1
+static void swnvg__sampleLevel(const SWNVGtexture* tex, int level, float u, float v, float* rgba)
+{
+	int repeatx = tex->flags & NVG_IMAGE_REPEATX;
+	int repeaty = tex->flags & NVG_IMAGE_REPEATY;
+	int width, height;
+	const unsigned char* data = swnvg__level(tex, level, &width, &height);
+	int x0, y0, x1, y1, c;
+	float fx, fy;
+	const unsigned char *p00, *p10, *p01, *p11;
+
+	if (tex->flags & NVG_IMAGE_NEAREST) {
+		x0 = swnvg__texel((int)floorf(u * width), width, repeatx);
+		y0 = swnvg__texel((int)floorf(v * height), height, repeaty);
+		if (tex->type != NVG_TEXTURE_ALPHA) {
+			p00 = data + ((size_t)y0*width + x0)*4;
+			for (c = 0; c < 4; c++) rgba[c] = p00[c] * (1.0f/255.0f);
+		} else {
+			rgba[0] = rgba[1] = rgba[2] = rgba[3] = data[(size_t)y0*width + x0] * (1.0f/255.0f);
+		}
+		return;
+	}
+
+	u = u * width - 0.5f;
+	v = v * height - 0.5f;
+	fx = floorf(u);
+	fy = floorf(v);
+	x0 = (int)fx;
+	y0 = (int)fy;
+	fx = u - fx;
+	fy = v - fy;
+	x1 = swnvg__texel(x0+1, width, repeatx);
+	y1 = swnvg__texel(y0+1, height, repeaty);
+	x0 = swnvg__texel(x0, width, repeatx);
+	y0 = swnvg__texel(y0, height, repeaty);
+
+	if (tex->type != NVG_TEXTURE_ALPHA) {
+		p00 = data + ((size_t)y0*width + x0)*4;
+		p10 = data + ((size_t)y0*width + x1)*4;
+		p01 = data + ((size_t)y1*width + x0)*4;
+		p11 = data + ((size_t)y1*width + x1)*4;
+		for (c = 0; c < 4; c++) {
+			float top = p00[c] + (p10[c] - p00[c]) * fx;
+			float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+			rgba[c] = (top + (bottom - top) * fy) * (1.0f/255.0f);
+		}
+	} else {
+		float a00 = data[(size_t)y0*width + x0];
+		float a10 = data[(size_t)y0*width + x1];
+		float a01 = data[(size_t)y1*width + x0];
+		float a11 = data[(size_t)y1*width + x1];
+		float top = a00 + (a10 - a00) * fx;
+		float bottom = a01 + (a11 - a01) * fx;
+		rgba[0] = rgba[1] = rgba[2] = rgba[3] = (top + (bottom - top) * fy) * (1.0f/255.0f);
+	}
+}
+
+//
+// Paint
+//
+
+// samples a texture at normalized coordinates. lod is log2 of the texels
+// per pixel. Without mipmaps, or when magnified, it reads the image itself,
+// otherwise it blends the two nearest levels as GL_LINEAR_MIPMAP_LINEAR
+// does, or picks the nearest one for GL_NEAREST_MIPMAP_NEAREST
+static void swnvg__sample(const SWNVGtexture* tex, float u, float v, float lod, float* rgba)
+{
+	float next[4];
+	int level, c;
+
+	if (tex->mips == NULL || (tex->flags & NVG_IMAGE_GENERATE_MIPMAPS) == 0 || lod <= 0.0f) {
+		swnvg__sampleLevel(tex, 0, u, v, rgba);
+		return;
+	}
+	if (tex->flags & NVG_IMAGE_NEAREST) {
+		swnvg__sampleLevel(tex, swnvg__mini((int)(lod + 0.5f), tex->nlevels), u, v, rgba);
+		return;
+	}
+	level = (int)lod;
+	if (level >= tex->nlevels) {
+		swnvg__sampleLevel(tex, tex->nlevels, u, v, rgba);
+		return;
+	}
+	lod -= level;
+	swnvg__sampleLevel(tex, level, u, v, rgba);
+	swnvg__sampleLevel(tex, level+1, u, v, next);
+	for (c = 0; c < 4; c++)
+		rgba[c] += (next[c] - rgba[c]) * lod;
+}
+
+static void swnvg__premulColor(float* dst, NVGcolor c)
+{
+	dst[0] = c.r * c.a;
+	dst[1] = c.g * c.a;
+	dst[2] = c.b * c.a;
+	dst[3] = c.a;
+}
+
+static int swnvg__convertPaint(SWNVGcontext* sw, SWNVGpaint* p, NVGpaint* paint, NVGscissor* scissor, float fringe)
+{
+	float invxform[6];
+
+	memset(p, 0, sizeof(*p));
+	swnvg__premulColor(p->innerCol, paint->innerColor);
+	swnvg__premulColor(p->outerCol, paint->outerColor);
+
+	if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f) {
+		p->scissor = 0;
+		p->scissorBounds[0] = 0;
+		p->scissorBounds[1] = 0;
+		p->scissorBounds[2] = (float)sw->width;
+		p->scissorBounds[3] = (float)sw->height;
+	} else {
+		const float* t = scissor->xform;
+		float ex = fabsf(t[0])*scissor->extent[0] + fabsf(t[2])*scissor->extent[1] + 1.0f;
+		float ey = fabsf(t[1])*scissor->extent[0] + fabsf(t[3])*scissor->extent[1] + 1.0f;
+		p->scissor = 1;
+		nvgTransformInverse(p->scissorMat, scissor->xform);
+		p->scissorExt[0] = scissor->extent[0];
+		p->scissorExt[1] = scissor->extent[1];
+		p->scissorScale[0] = sqrtf(t[0]*t[0] + t[2]*t[2]) / fringe;
+		p->scissorScale[1] = sqrtf(t[1]*t[1] + t[3]*t[3]) / fringe;
+		p->scissorBounds[0] = t[4] - ex;
+		p->scissorBounds[1] = t[5] - ey;
+		p->scissorBounds[2] = t[4] + ex;
+		p->scissorBounds[3] = t[5] + ey;
+	}
+
+	memcpy(p->extent, paint->extent, sizeof(p->extent));
+	memcpy(p->sdf, paint->sdf, sizeof(p->sdf));
+	memcpy(p->blur, paint->blur, sizeof(p->blur));
+
+	if (paint->image != 0) {
+		p->tex = swnvg__findTexture(sw, paint->image);
+		if (p->tex == NULL) return 0;
+		if ((p->tex->flags & NVG_IMAGE_FLIPY) != 0) {
+			float m1[6], m2[6];
+			nvgTransformTranslate(m1, 0.0f, p->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, paint->xform);
+			nvgTransformScale(m2, 1.0f, -1.0f);
+			nvgTransformMultiply(m2, m1);
+			nvgTransformTranslate(m1, 0.0f, -p->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, m2);
+			nvgTransformInverse(invxform, m1);
+		} else {
+			nvgTransformInverse(invxform, paint->xform);
+		}
+		p->type = SWNVG_PAINT_IMAGE;
+		memcpy(p->region, paint->region, sizeof(p->region));
+		// texels the pattern moves per pixel in x and in y, the way GL
+		// picks the mip level
+		{
+			float tw = p->tex->width / p->extent[0], th = p->tex->height / p->extent[1];
+			float dx = sqrtf(invxform[0]*tw*invxform[0]*tw + invxform[1]*th*invxform[1]*th);
+			float dy = sqrtf(invxform[2]*tw*invxform[2]*tw + invxform[3]*th*invxform[3]*th);
+			p->lod = log2f(swnvg__maxf(dx, dy));
+		}
+	} else {
+		p->radius = paint->radius;
+		p->feather = paint->feather;
+		nvgTransformInverse(invxform, paint->xform);
+		// nvgFillColor and nvgStrokeColor make a gradient from a color to itself
+		if (memcmp(p->innerCol, p->outerCol, sizeof(p->innerCol)) == 0)
+			p->type = SWNVG_PAINT_SOLID;
+		else
+			p->type = SWNVG_PAINT_GRADIENT;
+	}
+	memcpy(p->paintMat, invxform, sizeof(invxform));
+
+	return 1;
+}
+
+static float swnvg__sdroundrect(float px, float py, float ex, float ey, float rad)
+{
+	float dx = fabsf(px) - (ex - rad);
+	float dy = fabsf(py) - (ey - rad);
+	float mx = swnvg__maxf(dx, 0.0f);
+	float my = swnvg__maxf(dy, 0.0f);
+	return swnvg__minf(swnvg__maxf(dx, dy), 0.0f) + sqrtf(mx*mx + my*my) - rad;
+}
+
+// multiplies a row of coverage by the scissor mask
+static void swnvg__scissorSpan(const SWNVGpaint* p, float* cover, int x, int y, int n)
+{
+	const float* m = p->scissorMat;
+	float px = x + 0.5f, py = y + 0.5f;
+	float sx = m[0]*px + m[2]*py + m[4];
+	float sy = m[1]*px + m[3]*py + m[5];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (cover[i] > 0.0f) {
+			float mx = 0.5f - (fabsf(sx) - p->scissorExt[0]) * p->scissorScale[0];
+			float my = 0.5f - (fabsf(sy) - p->scissorExt[1]) * p->scissorScale[1];
+			cover[i] *= swnvg__clampf(mx, 0.0f, 1.0f) * swnvg__clampf(my, 0.0f, 1.0f);
+		}
+		sx += m[0];
+		sy += m[1];
+	}
+}
+
+// evaluates a gradient or image paint for a row of pixels into planar RGBA
+static void swnvg__paintSpan(const SWNVGpaint* p, float* span, int stride, const float* cover, int x, int y, int n)
+{
+	const float* m = p->paintMat;
+	float px = x + 0.5f, py = y + 0.5f;
+	float tx = m[0]*px + m[2]*py + m[4];
+	float ty = m[1]*px + m[3]*py + m[5];
+	float color[4];
+	int i, c;
+
+	for (i = 0; i < n; i++, tx += m[0], ty += m[1]) {
+		if (cover[i] <= 0.0f) continue;
+		if (p->type == SWNVG_PAINT_GRADIENT) {
+			float d = swnvg__clampf((swnvg__sdroundrect(tx, ty, p->extent[0], p->extent[1], p->radius) + p->feather*0.5f) / p->feather, 0.0f, 1.0f);
+			for (c = 0; c < 4; c++)
+				span[c*stride + i] = p->innerCol[c] + (p->outerCol[c] - p->innerCol[c]) * d;
+		} else {
+			float u = tx / p->extent[0], v = ty / p->extent[1];
+			// keeps sub-images from sampling their neighbours
+			if (p->region[2] > 0.0f) {
+				u = swnvg__clampf(u, p->region[0], p->region[2]);
+				v = swnvg__clampf(v, p->region[1], p->region[3]);
+			}
+			swnvg__sample(p->tex, u, v, p->lod, color);
+			for (c = 0; c < 4; c++)
+				span[c*stride + i] = color[c] * p->innerCol[c];
+		}
+	}
+}
+
+//
+// Blending. Pixels are premultiplied 0xAARRGGBB, four at a time
+//
+
+static swnvg__v4f swnvg__channel(swnvg__v4u d, int shift)
+{
+	return __builtin_convertvector((d >> shift) & 0xff, swnvg__v4f);
+}
+
+static swnvg__v4u swnvg__pack(swnvg__v4f b, swnvg__v4f g, swnvg__v4f r, swnvg__v4f a)
+{
+	swnvg__v4u ub = __builtin_convertvector(b + 0.5f, swnvg__v4u);
+	swnvg__v4u ug = __builtin_convertvector(g + 0.5f, swnvg__v4u);
+	swnvg__v4u ur = __builtin_convertvector(r + 0.5f, swnvg__v4u);
+	swnvg__v4u ua = __builtin_convertvector(a + 0.5f, swnvg__v4u);
+	return ub | (ug << 8) | (ur << 16) | (ua << 24);
+}
+
+static uint32_t swnvg__blendPixel(uint32_t d, float cov, float r, float g, float b, float a)
+{
+	float inv = 1.0f - a*cov;
+	float db = (float)(d & 0xff), dg = (float)((d >> 8) & 0xff);
+	float dr = (float)((d >> 16) & 0xff), da = (float)(d >> 24);
+	cov *= 255.0f;
+	return (uint32_t)(db*inv + b*cov + 0.5f)
+		| ((uint32_t)(dg*inv + g*cov + 0.5f) << 8)
+		| ((uint32_t)(dr*inv + r*cov + 0.5f) << 16)
+		| ((uint32_t)(da*inv + a*cov + 0.5f) << 24);
+}
+
+// one color over a row with varying coverage
+static void swnvg__blendSolid(uint32_t* dst, const float* cover, int n, const float* col)
+{
+	uint32_t opaque = ((uint32_t)(col[3]*255.0f + 0.5f) << 24)
+		| ((uint32_t)(col[0]*255.0f + 0.5f) << 16)
+		| ((uint32_t)(col[1]*255.0f + 0.5f) << 8)
+		| (uint32_t)(col[2]*255.0f + 0.5f);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		swnvg__v4f c;
+		swnvg__v4u d;
+		memcpy(&c, cover + i, sizeof(c));
+		if (c[0] + c[1] + c[2] + c[3] <= 0.0f) continue;
+		if (col[3] >= 1.0f && c[0] >= 1.0f && c[1] >= 1.0f && c[2] >= 1.0f && c[3] >= 1.0f) {
+			dst[i] = dst[i+1] = dst[i+2] = dst[i+3] = opaque;
+			continue;
+		}
+		memcpy(&d, dst + i, sizeof(d));
+		{
+			swnvg__v4f inv = 1.0f - c * col[3];
+			swnvg__v4f s = c * 255.0f;
+			swnvg__v4u out = swnvg__pack(
+				swnvg__channel(d, 0) * inv + s * col[2],
+				swnvg__channel(d, 8) * inv + s * col[1],
+				swnvg__channel(d, 16) * inv + s * col[0],
+				swnvg__channel(d, 24) * inv + s * col[3]);
+			memcpy(dst + i, &out, sizeof(out));
+		}
+	}
+	for (; i < n; i++) {
+		if (cover[i] > 0.0f)
+			dst[i] = swnvg__blendPixel(dst[i], cover[i], col[0], col[1], col[2], col[3]);
+	}
+}
+
+// planar per pixel colors over a row with varying coverage
+static void swnvg__blendSpan(uint32_t* dst, const float* cover, int n, const float* span, int stride)
+{
+	const float* sr = span;
+	const float* sg = span + stride;
+	const float* sb = span + stride*2;
+	const float* sa = span + stride*3;
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		const swnvg__v4f zero = {0.0f, 0.0f, 0.0f, 0.0f};
+		swnvg__v4f c, r, g, b, a, inv;
+		swnvg__v4u d, out;
+		swnvg__v4i shaded;
+		memcpy(&c, cover + i, sizeof(c));
+		if (c[0] + c[1] + c[2] + c[3] <= 0.0f) continue;
+		// pixels without coverage weren't shaded, so mask out whatever their
+		// colors hold
+		shaded = c > zero;
+		memcpy(&r, sr + i, sizeof(r));
+		memcpy(&g, sg + i, sizeof(g));
+		memcpy(&b, sb + i, sizeof(b));
+		memcpy(&a, sa + i, sizeof(a));
+		r = (swnvg__v4f)((swnvg__v4i)r & shaded);
+		g = (swnvg__v4f)((swnvg__v4i)g & shaded);
+		b = (swnvg__v4f)((swnvg__v4i)b & shaded);
+		a = (swnvg__v4f)((swnvg__v4i)a & shaded);
+		memcpy(&d, dst + i, sizeof(d));
+		inv = 1.0f - a * c;
+		c *= 255.0f;
+		out = swnvg__pack(
+			swnvg__channel(d, 0) * inv + b * c,
+			swnvg__channel(d, 8) * inv + g * c,
+			swnvg__channel(d, 16) * inv + r * c,
+			swnvg__channel(d, 24) * inv + a * c);
+		memcpy(dst + i, &out, sizeof(out));
+	}
+	for (; i < n; i++) {
+		if (cover[i] > 0.0f)
+			dst[i] = swnvg__blendPixel(dst[i], cover[i], sr[i], sg[i], sb[i], sa[i]);
+	}
+}
+
+// shades and blends one row of coverage
+static void swnvg__shadeRow(SWNVGcontext* sw, const SWNVGpaint* p, float* cover, int x, int y, int n)
+{
+	uint32_t* dst = sw->pixels + (size_t)y*sw->stride + x;
+
+	if (p->scissor)
+		swnvg__scissorSpan(p, cover, x, y, n);
+
+	if (p->type == SWNVG_PAINT_SOLID) {
+		swnvg__blendSolid(dst, cover, n, p->innerCol);
+	} else {
+		swnvg__paintSpan(p, sw->span, sw->cspan, cover, x, y, n);
+		swnvg__blendSpan(dst, cover, n, sw->span, sw->cspan);
+	}
+}
+
+//
+// Coverage accumulation
+//
+
+static int swnvg__reserveSpan(SWNVGcontext* sw, int n)
+{
+	if (n > sw->cspan) {
+		float* cover = (float*)realloc(sw->cover, sizeof(float)*n);
+		float* span;
+		if (cover == NULL) return 0;
+		sw->cover = cover;
+		span = (float*)realloc(sw->span, sizeof(float)*n*4);
+		if (span == NULL) return 0;
+		sw->span = span;
+		sw->cspan = n;
+	}
+	return 1;
+}
+
+// clips the draw bounds to the target and scissor and makes sure the
+// accumulation buffer is large enough
+static int swnvg__beginRaster(SWNVGcontext* sw, SWNVGraster* r, const SWNVGpaint* p,
+							  float minx, float miny, float maxx, float maxy)
+{
+	int x0, y0, x1, y1, size;
+
+	if (sw->pixels == NULL) return 0;
+
+	minx = swnvg__maxf(minx, p->scissorBounds[0]);
+	miny = swnvg__maxf(miny, p->scissorBounds[1]);
+	maxx = swnvg__minf(maxx, p->scissorBounds[2]);
+	maxy = swnvg__minf(maxy, p->scissorBounds[3]);
+	// also rejects NaN bounds
+	if (!(minx < maxx && miny < maxy)) return 0;
+
+	x0 = swnvg__maxi((int)floorf(minx), 0);
+	y0 = swnvg__maxi((int)floorf(miny), 0);
+	x1 = swnvg__mini((int)ceilf(maxx), sw->width);
+	y1 = swnvg__mini((int)ceilf(maxy), sw->height);
+	if (x0 >= x1 || y0 >= y1) return 0;
+
+	r->x = x0;
+	r->y = y0;
+	r->w = x1 - x0;
+	r->h = y1 - y0;
+	// two spare columns take the spill from edges on the right border
+	r->stride = r->w + 2;
+
+	size = r->stride * r->h;
+	if (size > sw->cacc) {
+		free(sw->acc);
+		sw->acc = (float*)calloc(size, sizeof(float));
+		if (sw->acc == NULL) {
+			sw->cacc = 0;
+			return 0;
+		}
+		sw->cacc = size;
+	}
+	r->acc = sw->acc;
+
+	return swnvg__reserveSpan(sw, r->w);
+}
+
+// adds the signed area of an edge within the raster. Left of the raster
+// the edge is moved onto its left border, where it still changes the
+// winding of everything to its right. Right of it, it changes nothing.
+static void swnvg__accumulate(const SWNVGraster* r, float x0, float y0, float x1, float y1)
+{
+	float dir, dxdy, x, w = (float)r->w;
+	int y, ystart, yend;
+
+	if (y0 == y1) return;
+	if (y0 < y1) {
+		dir = 1.0f;
+	} else {
+		float t;
+		dir = -1.0f;
+		t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+	}
+	dxdy = (x1 - x0) / (y1 - y0);
+	x = x0;
+	if (y0 < 0.0f) {
+		x -= y0 * dxdy;
+		ystart = 0;
+	} else {
+		ystart = (int)y0;
+	}
+	yend = swnvg__mini(r->h, (int)ceilf(y1));
+
+	for (y = ystart; y < yend; y++) {
+		float* row = r->acc + (size_t)y*r->stride;
+		float dy = swnvg__minf((float)(y + 1), y1) - swnvg__maxf((float)y, y0);
+		float xnext = x + dxdy * dy;
+		float d = dy * dir;
+		// clamp away float error from the clipping
+		float xa = swnvg__clampf(x, 0.0f, w);
+		float xb = swnvg__clampf(xnext, 0.0f, w);
+		float xl = swnvg__minf(xa, xb);
+		float xr = swnvg__maxf(xa, xb);
+		float xlf = floorf(xl);
+		float xrc = ceilf(xr);
+		int xli = (int)xlf;
+		int xri = (int)xrc;
+
+		if (xri <= xli + 1) {
+			// within one pixel
+			float xmf = 0.5f * (xa + xb) - xlf;
+			row[xli] += d - d * xmf;
+			row[xli + 1] += d * xmf;
+		} else {
+			float s = 1.0f / (xr - xl);
+			float xlfrac = xl - xlf;
+			float a0 = 0.5f * s * (1.0f - xlfrac) * (1.0f - xlfrac);
+			float xrfrac = xr - xrc + 1.0f;
+			float am = 0.5f * s * xrfrac * xrfrac;
+			row[xli] += d * a0;
+			if (xri == xli + 2) {
+				row[xli + 1] += d * (1.0f - a0 - am);
+			} else {
+				float a1 = s * (1.5f - xlfrac);
+				float a2 = a1 + (xri - xli - 3) * s;
+				int xi;
+				row[xli + 1] += d * (a1 - a0);
+				for (xi = xli + 2; xi < xri - 1; xi++)
+					row[xi] += d * s;
+				row[xri - 1] += d * (1.0f - a2 - am);
+			}
+			row[xri] += d * am;
+		}
+		x = xnext;
+	}
+}
+
+static void swnvg__addEdge(const SWNVGraster* r, float x0, float y0, float x1, float y1)
+{
+	float w = (float)r->w;
+
+	x0 -= r->x; y0 -= r->y;
+	x1 -= r->x; y1 -= r->y;
+	if (y0 == y1) return;
+	if (x0 >= w && x1 >= w) return;
+
+	// drop the part right of the raster
+	if (x0 > w || x1 > w) {
+		float ym = y0 + (w - x0) * (y1 - y0) / (x1 - x0);
+		if (x0 > w) { x0 = w; y0 = ym; }
+		else { x1 = w; y1 = ym; }
+	}
+
+	// fold the part left of the raster onto its border
+	if (x0 < 0.0f && x1 < 0.0f) {
+		swnvg__accumulate(r, 0.0f, y0, 0.0f, y1);
+	} else if (x0 < 0.0f || x1 < 0.0f) {
+		float ym = y0 + (0.0f - x0) * (y1 - y0) / (x1 - x0);
+		if (x0 < 0.0f) {
+			swnvg__accumulate(r, 0.0f, y0, 0.0f, ym);
+			swnvg__accumulate(r, 0.0f, ym, x1, y1);
+		} else {
+			swnvg__accumulate(r, x0, y0, 0.0f, ym);
+			swnvg__accumulate(r, 0.0f, ym, 0.0f, y1);
+		}
+	} else {
+		swnvg__accumulate(r, x0, y0, x1, y1);
+	}
+}
+
+// adds a triangle with positive winding whatever its orientation
+static void swnvg__addTriangle(const SWNVGraster* r, const NVGvertex* a, const NVGvertex* b, const NVGvertex* c)
+{
+	float area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+	if (area == 0.0f) return;
+	if (area < 0.0f) {
+		const NVGvertex* t = b;
+		b = c;
+		c = t;
+	}
+	swnvg__addEdge(r, a->x, a->y, b->x, b->y);
+	swnvg__addEdge(r, b->x, b->y, c->x, c->y);
+	swnvg__addEdge(r, c->x, c->y, a->x, a->y);
+}
+
+// turns the accumulated area into coverage row by row, draws it, and
+// leaves the accumulation buffer zeroed for the next draw
+static void swnvg__endRaster(SWNVGcontext* sw, const SWNVGraster* r, const SWNVGpaint* p)
+{
+	int aa = sw->flags & NVG_SW_ANTIALIAS;
+	float* cover = sw->cover;
+	int x, y;
+
+	for (y = 0; y < r->h; y++) {
+		float* row = r->acc + (size_t)y*r->stride;
+		float sum = 0.0f;
+		int first = -1, last = -1;
+
+		for (x = 0; x < r->w; x++) {
+			float c;
+			sum += row[x];
+			c = fabsf(sum);
+			// non-zero winding. Overlaps count once
+			c = c > 1.0f ? 1.0f : c;
+			if (!aa) c = c >= 0.5f ? 1.0f : 0.0f;
+			// ignore the float dust left by edges that cancel out
+			if (c < 1.0f/512.0f) c = 0.0f;
+			cover[x] = c;
+			if (c > 0.0f) {
+				if (first < 0) first = x;
+				last = x;
+			}
+		}
+		memset(row, 0, sizeof(float)*r->stride);
+
+		if (first >= 0)
+			swnvg__shadeRow(sw, p, cover + first, r->x + first, r->y + y, last - first + 1);
+	}
+}
+
+//
+// Render callbacks
+//
+
+static int swnvg__renderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static void swnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	// everything is drawn straight into the target set by nvgSWSetTarget
+	NVG_NOTUSED(uptr);
+	NVG_NOTUSED(width);
+	NVG_NOTUSED(height);
+	NVG_NOTUSED(devicePixelRatio);
+}
+
+static void swnvg__renderCancel(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+}
+
+static void swnvg__renderFlush(void* uptr)
+{
+	// draws are not batched, so there is nothing left to do
+	NVG_NOTUSED(uptr);
+}
+
+static void swnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							  const float* bounds, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGpaint p;
+	SWNVGraster r;
+	int i, j;
+	NVG_NOTUSED(compositeOperation);
+
+	if (!swnvg__convertPaint(sw, &p, paint, scissor, fringe)) return;
+	if (!swnvg__beginRaster(sw, &r, &p, bounds[0], bounds[1], bounds[2], bounds[3])) return;
+
+	for (i = 0; i < npaths; i++) {
+		const NVGvertex* v = paths[i].fill;
+		int n = paths[i].nfill;
+		for (j = 0; j < n; j++) {
+			const NVGvertex* a = &v[j];
+			const NVGvertex* b = &v[j+1 < n ? j+1 : 0];
+			swnvg__addEdge(&r, a->x, a->y, b->x, b->y);
+		}
+	}
+
+	swnvg__endRaster(sw, &r, &p);
+}
+
+static void swnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								float strokeWidth, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGpaint p;
+	SWNVGraster r;
+	float minx = 1e6f, miny = 1e6f, maxx = -1e6f, maxy = -1e6f;
+	int i, j;
+	NVG_NOTUSED(compositeOperation);
+	NVG_NOTUSED(strokeWidth);
+
+	if (!swnvg__convertPaint(sw, &p, paint, scissor, fringe)) return;
+
+	for (i = 0; i < npaths; i++) {
+		const NVGvertex* v = paths[i].stroke;
+		for (j = 0; j < paths[i].nstroke; j++) {
+			minx = swnvg__minf(minx, v[j].x);
+			miny = swnvg__minf(miny, v[j].y);
+			maxx = swnvg__maxf(maxx, v[j].x);
+			maxy = swnvg__maxf(maxy, v[j].y);
+		}
+	}
+	if (!swnvg__beginRaster(sw, &r, &p, minx, miny, maxx, maxy)) return;
+
+	// strokes are triangle strips. Each triangle adds to the coverage, and
+	// the clamp in swnvg__endRaster draws overlapping joins only once
+	for (i = 0; i < npaths; i++) {
+		const NVGvertex* v = paths[i].stroke;
+		for (j = 0; j + 2 < paths[i].nstroke; j++)
+			swnvg__addTriangle(&r, &v[j], &v[j+1], &v[j+2]);
+	}
+
+	swnvg__endRaster(sw, &r, &p);
+}
+
+// true if the edge a->b owns pixel centers exactly on it. Each edge shared
+// by two triangles is owned by exactly one of them
+static int swnvg__ownsEdge(const NVGvertex* a, const NVGvertex* b)
+{
+	float dx = b->x - a->x, dy = b->y - a->y;
+	return dy > 0.0f || (dy == 0.0f && dx < 0.0f);
+}
+
+static float swnvg__edgeFunc(const NVGvertex* a, const NVGvertex* b, float px, float py)
+{
+	return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+// textured triangles, used for text. Pixel centers are sampled like the
+// GL back-end does, with no edge anti-aliasing
+static void swnvg__drawTriangle(SWNVGcontext* sw, const SWNVGpaint* p, const NVGvertex* v0, const NVGvertex* v1, const NVGvertex* v2)
+{
+	float area = swnvg__edgeFunc(v0, v1, v2->x, v2->y);
+	float* cover = sw->cover;
+	float* span = sw->span;
+	int stride = sw->cspan;
+	int x0, y0, x1, y1, x, y, c;
+	int own0, own1, own2;
+	float color[4];
+
+	if (area == 0.0f) return;
+	if (area < 0.0f) {
+		const NVGvertex* t = v1;
+		v1 = v2;
+		v2 = t;
+		area = -area;
+	}
+	own0 = swnvg__ownsEdge(v1, v2);
+	own1 = swnvg__ownsEdge(v2, v0);
+	own2 = swnvg__ownsEdge(v0, v1);
+
+	x0 = (int)floorf(swnvg__maxf(swnvg__minf(v0->x, swnvg__minf(v1->x, v2->x)), p->scissorBounds[0]));
+	y0 = (int)floorf(swnvg__maxf(swnvg__minf(v0->y, swnvg__minf(v1->y, v2->y)), p->scissorBounds[1]));
+	x1 = (int)ceilf(swnvg__minf(swnvg__maxf(v0->x, swnvg__maxf(v1->x, v2->x)), p->scissorBounds[2]));
+	y1 = (int)ceilf(swnvg__minf(swnvg__maxf(v0->y, swnvg__maxf(v1->y, v2->y)), p->scissorBounds[3]));
+	x0 = swnvg__maxi(x0, 0);
+	y0 = swnvg__maxi(y0, 0);
+	x1 = swnvg__mini(x1, sw->width);
+	y1 = swnvg__mini(y1, sw->height);
+	if (x0 >= x1 || y0 >= y1) return;
+	if (!swnvg__reserveSpan(sw, x1 - x0)) return;
+	cover = sw->cover;
+	span = sw->span;
+	stride = sw->cspan;
+
+	for (y = y0; y < y1; y++) {
+		float py = y + 0.5f;
+		int first = -1, last = -1;
+		for (x = x0; x < x1; x++) {
+			float px = x + 0.5f;
+			float w0 = swnvg__edgeFunc(v1, v2, px, py);
+			float w1 = swnvg__edgeFunc(v2, v0, px, py);
+			float w2 = swnvg__edgeFunc(v0, v1, px, py);
+			int i = x - x0;
+			if ((w0 > 0.0f || (w0 == 0.0f && own0)) &&
+				(w1 > 0.0f || (w1 == 0.0f && own1)) &&
+				(w2 > 0.0f || (w2 == 0.0f && own2))) {
+				float u = (w0*v0->u + w1*v1->u + w2*v2->u) / area;
+				float v = (w0*v0->v + w1*v1->v + w2*v2->v) / area;
+				if (p->tex != NULL) {
+					// triangles are text, from the glyph atlas, which has no mipmaps
+					swnvg__sample(p->tex, u, v, 0.0f, color);
+					if (p->sdf[1] > 0.0f) {
+						// distance field text, like the texType 3 branch of the GL shader
+						float a = swnvg__clampf((color[0] - p->sdf[0]) / p->sdf[1] + 0.5f, 0.0f, 1.0f);
+						color[0] = color[1] = color[2] = color[3] = a;
+					}
+				} else {
+					color[0] = color[1] = color[2] = color[3] = 1.0f;
+				}
+				for (c = 0; c < 4; c++)
+					span[c*stride + i] = color[c] * p->innerCol[c];
+				cover[i] = 1.0f;
+				if (first < 0) first = i;
+				last = i;
+			} else {
+				cover[i] = 0.0f;
+			}
+		}
+		if (first < 0) continue;
+		if (p->scissor)
+			swnvg__scissorSpan(p, cover + first, x0 + first, y, last - first + 1);
+		swnvg__blendSpan(sw->pixels + (size_t)y*sw->stride + x0 + first, cover + first, last - first + 1, span + first, stride);
+	}
+}
+
+// adds a glyph triangle's coverage to the w by h mask at x0,y0, the way the
+// GL back-end draws it into its offscreen pass
+static void swnvg__maskTriangle(const SWNVGpaint* p, float* mask, int x0, int y0, int w, int h,
+								const NVGvertex* v0, const NVGvertex* v1, const NVGvertex* v2)
+{
+	float area = swnvg__edgeFunc(v0, v1, v2->x, v2->y);
+	int tx0, ty0, tx1, ty1, x, y;
+	int own0, own1, own2;
+	float color[4];
+
+	if (area == 0.0f) return;
+	if (area < 0.0f) {
+		const NVGvertex* t = v1;
+		v1 = v2;
+		v2 = t;
+		area = -area;
+	}
+	own0 = swnvg__ownsEdge(v1, v2);
+	own1 = swnvg__ownsEdge(v2, v0);
+	own2 = swnvg__ownsEdge(v0, v1);
+
+	tx0 = swnvg__maxi((int)floorf(swnvg__minf(v0->x, swnvg__minf(v1->x, v2->x))), x0);
+	ty0 = swnvg__maxi((int)floorf(swnvg__minf(v0->y, swnvg__minf(v1->y, v2->y))), y0);
+	tx1 = swnvg__mini((int)ceilf(swnvg__maxf(v0->x, swnvg__maxf(v1->x, v2->x))), x0 + w);
+	ty1 = swnvg__mini((int)ceilf(swnvg__maxf(v0->y, swnvg__maxf(v1->y, v2->y))), y0 + h);
+
+	for (y = ty0; y < ty1; y++) {
+		float py = y + 0.5f;
+		float* row = mask + (size_t)(y - y0)*w - x0;
+		for (x = tx0; x < tx1; x++) {
+			float px = x + 0.5f;
+			float w0 = swnvg__edgeFunc(v1, v2, px, py);
+			float w1 = swnvg__edgeFunc(v2, v0, px, py);
+			float w2 = swnvg__edgeFunc(v0, v1, px, py);
+			if ((w0 > 0.0f || (w0 == 0.0f && own0)) &&
+				(w1 > 0.0f || (w1 == 0.0f && own1)) &&
+				(w2 > 0.0f || (w2 == 0.0f && own2))) {
+				float u = (w0*v0->u + w1*v1->u + w2*v2->u) / area;
+				float v = (w0*v0->v + w1*v1->v + w2*v2->v) / area;
+				swnvg__sample(p->tex, u, v, 0.0f, color);
+				// over what is there, like overlapping glyphs blend
+				row[x] = color[3] + row[x] * (1.0f - color[3]);
+			}
+		}
+	}
+}
+
+// one direction of the blur, from src into dst. step is the distance between
+// taps in floats, count the taps along the direction and n the number of
+// lines across it, lineStride apart
+static void swnvg__blurLines(const float* src, float* dst, int step, int count, int n, int lineStride,
+							 const float* weights, int r)
+{
+	int i, j, k;
+	for (i = 0; i < n; i++) {
+		const float* s = src + (size_t)i*lineStride;
+		float* d = dst + (size_t)i*lineStride;
+		for (j = 0; j < count; j++) {
+			float sum = 0.0f;
+			int k0 = swnvg__maxi(-r, -j), k1 = swnvg__mini(r, count - 1 - j);
+			for (k = k0; k <= k1; k++)
+				sum += s[(j + k)*step] * weights[k + r];
+			d[j*step] = sum;
+		}
+	}
+}
+
+// Blurred text. Like the GL back-end, the glyphs' coverage is drawn around
+// them with room for the blur, blurred across and then down with a Gaussian,
+// and blended in the paint's color
+static void swnvg__blurTriangles(SWNVGcontext* sw, const SWNVGpaint* p, const NVGvertex* verts, int nverts)
+{
+	float weights[NVG_BLUR_RADIUS*2 + 1];
+	float minx = 1e6f, miny = 1e6f, maxx = -1e6f, maxy = -1e6f, wsum = 0.0f;
+	float *mask, *across;
+	int i, x, y, x0, y0, x1, y1, w, h, r = (int)p->blur[1];
+
+	if (p->tex == NULL) return;
+	for (i = 0; i < nverts; i++) {
+		minx = swnvg__minf(minx, verts[i].x);
+		miny = swnvg__minf(miny, verts[i].y);
+		maxx = swnvg__maxf(maxx, verts[i].x);
+		maxy = swnvg__maxf(maxy, verts[i].y);
+	}
+	x0 = swnvg__maxi((int)floorf(minx) - r, -r);
+	y0 = swnvg__maxi((int)floorf(miny) - r, -r);
+	x1 = swnvg__mini((int)ceilf(maxx) + r, sw->width + r);
+	y1 = swnvg__mini((int)ceilf(maxy) + r, sw->height + r);
+	if (x0 >= x1 || y0 >= y1) return;
+	w = x1 - x0;
+	h = y1 - y0;
+
+	if (w*h*2 > sw->cblur) {
+		float* blur = (float*)realloc(sw->blur, sizeof(float)*w*h*2);
+		if (blur == NULL) return;
+		sw->blur = blur;
+		sw->cblur = w*h*2;
+	}
+	mask = sw->blur;
+	across = sw->blur + w*h;
+	memset(mask, 0, sizeof(float)*w*h);
+	for (i = 0; i + 2 < nverts; i += 3)
+		swnvg__maskTriangle(p, mask, x0, y0, w, h, &verts[i], &verts[i+1], &verts[i+2]);
+
+	for (i = -r; i <= r; i++) {
+		weights[i + r] = expf(-0.5f * i*i / (p->blur[0]*p->blur[0]));
+		wsum += weights[i + r];
+	}
+	for (i = 0; i <= 2*r; i++)
+		weights[i] /= wsum;
+	swnvg__blurLines(mask, across, 1, w, h, w, weights, r);
+	swnvg__blurLines(across, mask, w, h, w, 1, weights, r);
+
+	// only the part on the target, and in the scissor
+	x = swnvg__maxi(x0, swnvg__maxi(0, (int)floorf(p->scissorBounds[0])));
+	y = swnvg__maxi(y0, swnvg__maxi(0, (int)floorf(p->scissorBounds[1])));
+	x1 = swnvg__mini(x1, swnvg__mini(sw->width, (int)ceilf(p->scissorBounds[2])));
+	y1 = swnvg__mini(y1, swnvg__mini(sw->height, (int)ceilf(p->scissorBounds[3])));
+	if (x >= x1 || !swnvg__reserveSpan(sw, x1 - x)) return;
+	for (; y < y1; y++) {
+		memcpy(sw->cover, mask + (size_t)(y - y0)*w + (x - x0), sizeof(float)*(x1 - x));
+		if (p->scissor)
+			swnvg__scissorSpan(p, sw->cover, x, y, x1 - x);
+		swnvg__blendSolid(sw->pixels + (size_t)y*sw->stride + x, sw->cover, x1 - x, p->innerCol);
+	}
+}
+
+static void swnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								   const NVGvertex* verts, int nverts)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGpaint p;
+	int i;
+	NVG_NOTUSED(compositeOperation);
+
+	if (sw->pixels == NULL) return;
+	if (!swnvg__convertPaint(sw, &p, paint, scissor, 1.0f)) return;
+
+	if (p.blur[0] > 0.0f) {
+		swnvg__blurTriangles(sw, &p, verts, nverts);
+		return;
+	}
+
+	for (i = 0; i + 2 < nverts; i += 3)
+		swnvg__drawTriangle(sw, &p, &verts[i], &verts[i+1], &verts[i+2]);
+}
+
+static void swnvg__renderDelete(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	int i;
+	if (sw == NULL) return;
+
+	for (i = 0; i < sw->ntextures; i++) {
+		free(sw->textures[i].data);
+		free(sw->textures[i].mips);
+	}
+	free(sw->textures);
+	free(sw->acc);
+	free(sw->cover);
+	free(sw->span);
+	free(sw->blur);
+	free(sw);
+}
+
+NVGcontext* nvgCreateSW(int flags)
+{
+	NVGparams params;
+	NVGcontext* ctx = NULL;
+	SWNVGcontext* sw = (SWNVGcontext*)malloc(sizeof(SWNVGcontext));
+	if (sw == NULL) goto error;
+	memset(sw, 0, sizeof(SWNVGcontext));
+
+	memset(&params, 0, sizeof(params));
+	params.renderCreate = swnvg__renderCreate;
+	params.renderCreateTexture = swnvg__renderCreateTexture;
+	params.renderDeleteTexture = swnvg__renderDeleteTexture;
+	params.renderUpdateTexture = swnvg__renderUpdateTexture;
+	params.renderUpdateTextureRect = swnvg__renderUpdateTextureRect;
+	params.renderGenerateMipmaps = swnvg__renderGenerateMipmaps;
+	params.renderGetTextureSize = swnvg__renderGetTextureSize;
+	params.renderViewport = swnvg__renderViewport;
+	params.renderCancel = swnvg__renderCancel;
+	params.renderFlush = swnvg__renderFlush;
+	params.renderFill = swnvg__renderFill;
+	params.renderStroke = swnvg__renderStroke;
+	params.renderTriangles = swnvg__renderTriangles;
+	params.renderDelete = swnvg__renderDelete;
+	params.userPtr = sw;
+	// coverage is exact, so the fringe geometry would only be wasted work
+	params.edgeAntiAlias = 0;
+	params.textBlur = 1;
+
+	sw->flags = flags;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) goto error;
+
+	return ctx;
+
+error:
+	// 'sw' is freed by nvgDeleteInternal.
+	if (ctx != NULL) nvgDeleteInternal(ctx);
+	return NULL;
+}
+
+void nvgDeleteSW(NVGcontext* ctx)
+{
+	nvgDeleteInternal(ctx);
+}
+
+void nvgSWSetTarget(NVGcontext* ctx, void* pixels, int width, int height, int stride)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalParams(ctx)->userPtr;
+	sw->pixels = (uint32_t*)pixels;
+	sw->width = width;
+	sw->height = height;
+	sw->stride = stride / 4;
+}
+
+void nvgSWClear(NVGcontext* ctx, NVGcolor color)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalParams(ctx)->userPtr;
+	float c[4];
+	uint32_t value;
+	int x, y;
+
+	if (sw->pixels == NULL) return;
+	swnvg__premulColor(c, color);
+	value = ((uint32_t)(c[3]*255.0f + 0.5f) << 24)
+		| ((uint32_t)(c[0]*255.0f + 0.5f) << 16)
+		| ((uint32_t)(c[1]*255.0f + 0.5f) << 8)
+		| (uint32_t)(c[2]*255.0f + 0.5f);
+
+	for (y = 0; y < sw->height; y++) {
+		uint32_t* row = sw->pixels + (size_t)y*sw->stride;
+		if (value == 0) {
+			memset(row, 0, sizeof(uint32_t)*sw->width);
+			continue;
+		}
+		for (x = 0; x < sw->width; x++)
+			row[x] = value;
+	}
+}
+
+#endif /* NANOVG_SW_IMPLEMENTATION */
@@ -0,0 +1,153 @@
+/*
+Minimal PNG writer used by the replay and scene tools.
+The zlib stream uses stored (uncompressed) deflate blocks.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "png.h"
+
+// largest payload of a single stored deflate block
+#define MAX_STORED_BLOCK    65535
+
+static uint32_t crc_table[256];
+static bool     crc_table_ready = false;
+
+//---------------------------------------------------------
+static void make_crc_table() {
+  for ( uint32_t n = 0; n < 256; n++ ) {
+    uint32_t c = n;
+    for ( int k = 0; k < 8; k++ ) {
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    crc_table[n] = c;
+  }
+  crc_table_ready = true;
+}
+
+static uint32_t update_crc( uint32_t crc, const unsigned char* p, size_t len ) {
+  for ( size_t i = 0; i < len; i++ ) {
+    crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+//---------------------------------------------------------
+static void put_u32_be( unsigned char* p, uint32_t v ) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static unsigned char* put_chunk( unsigned char* p, const char* type,
+                                 const unsigned char* p_data, uint32_t len ) {
+  uint32_t crc = 0xFFFFFFFF;
+
+  put_u32_be(p, len);
+  memcpy(p + 4, type, 4);
+  if ( len ) memcpy(p + 8, p_data, len);
+
+  crc = update_crc(crc, p + 4, len + 4);
+  put_u32_be(p + 8 + len, crc ^ 0xFFFFFFFF);
+  return p + 12 + len;
+}
+
+//---------------------------------------------------------
+unsigned char* encode_png( int width, int height, const unsigned char* p_rgba,
+                           size_t* p_size ) {
+  static const unsigned char signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+
+  if ( !crc_table_ready ) make_crc_table();
+
+  // each row is prefixed with a filter byte of zero (none)
+  size_t row_bytes = (size_t)width * 4 + 1;
+  size_t raw_size  = row_bytes * height;
+  size_t blocks    = (raw_size + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+  if ( blocks == 0 ) blocks = 1;
+
+  // zlib header + per block header + raw data + adler32
+  size_t         z_size = 2 + blocks * 5 + raw_size + 4;
+  unsigned char* p_z    = malloc(z_size);
+  unsigned char* p_raw  = malloc(raw_size);
+  unsigned char* p_png  = malloc(sizeof(signature) + 3 * 12 + 13 + z_size);
+  if ( !p_z || !p_raw || !p_png ) {
+    free(p_z);
+    free(p_raw);
+    free(p_png);
+    return NULL;
+  }
+
+  for ( int y = 0; y < height; y++ ) {
+    p_raw[y * row_bytes] = 0;
+    memcpy(p_raw + y * row_bytes + 1, p_rgba + (size_t)y * width * 4, width * 4);
+  }
+
+  // zlib stream of stored blocks
+  unsigned char* p = p_z;
+  *p++ = 0x78;
+  *p++ = 0x01;
+  size_t   remaining = raw_size;
+  size_t   offset    = 0;
+  uint32_t a = 1, b = 0;
+  do {
+    uint16_t len = remaining > MAX_STORED_BLOCK ? MAX_STORED_BLOCK : remaining;
+    remaining -= len;
+    *p++ = remaining == 0 ? 1 : 0;
+    *p++ = len & 0xFF;
+    *p++ = len >> 8;
+    *p++ = ~len & 0xFF;
+    *p++ = (~len >> 8) & 0xFF;
+    memcpy(p, p_raw + offset, len);
+    for ( uint16_t i = 0; i < len; i++ ) {
+      a = (a + p[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    p += len;
+    offset += len;
+  } while ( remaining > 0 );
+  put_u32_be(p, (b << 16) | a);
+  p += 4;
+
+  unsigned char ihdr[13];
+  put_u32_be(ihdr, width);
+  put_u32_be(ihdr + 4, height);
+  ihdr[8]  = 8;     // bit depth
+  ihdr[9]  = 6;     // RGBA
+  ihdr[10] = 0;     // deflate
+  ihdr[11] = 0;     // adaptive filtering
+  ihdr[12] = 0;     // no interlace
+
+  unsigned char* p_out = p_png;
+  memcpy(p_out, signature, sizeof(signature));
+  p_out += sizeof(signature);
+  p_out = put_chunk(p_out, "IHDR", ihdr, sizeof(ihdr));
+  p_out = put_chunk(p_out, "IDAT", p_z, p - p_z);
+  p_out = put_chunk(p_out, "IEND", NULL, 0);
+  *p_size = p_out - p_png;
+
+  free(p_z);
+  free(p_raw);
+  return p_png;
+}
+
+//---------------------------------------------------------
+bool write_png( const char* path, int width, int height,
+                const unsigned char* p_rgba ) {
+  size_t         size;
+  unsigned char* p_png = encode_png(width, height, p_rgba, &size);
+  if ( !p_png ) return false;
+
+  FILE* f = fopen(path, "wb");
+  if ( !f ) {
+    free(p_png);
+    return false;
+  }
+  bool ok = fwrite(p_png, 1, size, f) == size;
+  fclose(f);
+  free(p_png);
+  return ok;
+}
@@ -0,0 +1,26 @@
+/*
+Minimal PNG writer used by the replay tool to dump frames and by the
+benchmark scene generator to make test textures.
+
+The image data is stored uncompressed, which keeps the writer small and
+free of dependencies. Files are larger than they need to be, but they are
+only ever used for diffing frames.
+*/
+
+#ifndef _PNG_H
+#define _PNG_H
+
+#include <stddef.h>
+
+#ifndef bool
+#include <stdbool.h>
+#endif
+
+// both take top-down, tightly packed RGBA8 pixels. encode_png returns
+// a malloc'd buffer that the caller must free
+unsigned char* encode_png(int width, int height, const unsigned char* p_rgba,
+                          size_t* p_size);
+bool write_png(const char* path, int width, int height,
+               const unsigned char* p_rgba);
+
+#endif
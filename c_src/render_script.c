@@ -17,89 +17,10 @@ functions to play a compiled render script
   #include "nanovg/nanovg.h"
   #include "types.h"
   #include "comms.h"
+  #include "font.h"
   #include "render_script.h"
   #include "tx.h"
 
-
-  // state control
-  #define OP_PUSH_STATE              0X01
-  #define OP_POP_STATE               0X02
-  #define OP_RESET_STATE             0X03
-
-  #define OP_RUN_SCRIPT              0X04
-
-  // RENDER STYLES
-  #define OP_PAINT_LINEAR            0X06
-  #define OP_PAINT_BOX               0X07
-  #define OP_PAINT_RADIAL            0X08
-  #define OP_PAINT_IMAGE             0X09
-  #define OP_PAINT_DYNAMIC           0X0A
-
-//  #define OP_ANTI_ALIAS              0X0A
-
-  #define OP_STROKE_WIDTH            0X0C
-  #define OP_STROKE_COLOR            0X0D
-  #define OP_STROKE_PAINT            0X0E
-
-  #define OP_FILL_COLOR              0X10
-  #define OP_FILL_PAINT              0x11
-
-  #define OP_MITER_LIMIT             0X14
-  #define OP_LINE_CAP                0X15
-  #define OP_LINE_JOIN               0X16
-  #define OP_GLOBAL_ALPHA            0X17
-
-  // SCISSORING
-  #define OP_SCISSOR                 0X1B
-  #define OP_INTERSECT_SCISSOR       0X1C
-  #define OP_RESET_SCISSOR           0X1D
-
-  // PATH OPERATIONS
-  #define OP_PATH_BEGIN              0X20
-
-  #define OP_PATH_MOVE_TO            0X21
-  #define OP_PATH_LINE_TO            0X22
-  #define OP_PATH_BEZIER_TO          0X23
-  #define OP_PATH_QUADRATIC_TO       0X24
-  #define OP_PATH_ARC_TO             0X25
-  #define OP_PATH_CLOSE              0X26
-  #define OP_PATH_WINDING            0X27
-
-  #define OP_FILL                    0X29
-  #define OP_STROKE                  0X2A
-
-  #define OP_TRIANGLE                0X2C
-  #define OP_ARC                     0X2D
-  #define OP_RECT                    0X2E
-  #define OP_ROUND_RECT              0X2F
-  #define OP_ROUND_RECT_VAR          0X30
-  #define OP_ELLIPSE                 0X31
-  #define OP_CIRCLE                  0X32
-  #define OP_SECTOR                  0X33
-
-  #define OP_TEXT                    0x34
-
-
-  // TRANSFORM OPERATIONS
-  #define OP_TX_RESET                0X36
-  #define OP_TX_IDENTITY             0X37
-  #define OP_TX_MATRIX               0X38
-  #define OP_TX_TRANSLATE            0X39
-  #define OP_TX_SCALE                0X3A
-  #define OP_TX_ROTATE               0X3B
-  #define OP_TX_SKEW_X               0X3C
-  #define OP_TX_SKEW_Y               0X3D
-
-
-  #define OP_FONT                    0X40
-  #define OP_FONT_BLUR               0X41
-  #define OP_FONT_SIZE               0X42
-  #define OP_TEXT_ALIGN              0X43
-  #define OP_TEXT_HEIGHT             0X44
-
-
-  #define OP_TERMINATE               0XFF
-
   static const float        TAU  = NVG_PI * 2;
 
   NVGpaint current_paint;
@@ -108,10 +29,14 @@ functions to play a compiled render script
 // access functions for scripts
 
 
+static void release_refs( NVGcontext* p_ctx, void* p_script, int length );
+
 void delete_script( driver_data_t* p_data, GLuint id ) {
   if (p_data->p_scripts[id]) {
+    release_refs( p_data->p_ctx, p_data->p_scripts[id], p_data->p_script_lengths[id] );
     free(p_data->p_scripts[id]);
   p_data->p_scripts[id] = NULL;
+  p_data->p_script_lengths[id] = 0;
   }
 }
 
@@ -121,11 +46,6 @@ void delete_all( driver_data_t* p_data ){
   }
 }
 
-void put_script( driver_data_t* p_data, GLuint id, void* p_script ) {
-  delete_script( p_data, id );
-  p_data->p_scripts[id] = p_script;
-}
-
 void* get_script( driver_data_t* p_data, GLuint id ) {
   return p_data->p_scripts[id];
 }
@@ -303,7 +223,7 @@ typedef struct __attribute__((__packed__))
   GLfloat     ey;
   GLfloat     angle;
   GLuint      alpha;
-  GLuint      key_size;
+  GLuint      handle;     // registered with CMD_NEW_TX_ID
 } image_pattern_t;
 
 typedef struct __attribute__((__packed__))
@@ -311,6 +231,123 @@ typedef struct __attribute__((__packed__))
   GLuint      size;
 } text_t;
 
+//=============================================================================
+// storing scripts
+
+// the op after the one at p_script, which points past the op code. NULL at
+// the end of the script or at an op the runner doesn't know either
+static void* next_op( GLuint op, void* p_script ) {
+  switch( op ) {
+    case OP_PUSH_STATE:
+    case OP_POP_STATE:
+    case OP_RESET_STATE:
+    case OP_STROKE_PAINT:
+    case OP_FILL_PAINT:
+    case OP_RESET_SCISSOR:
+    case OP_PATH_BEGIN:
+    case OP_PATH_CLOSE:
+    case OP_FILL:
+    case OP_STROKE:
+    case OP_ROUND_RECT_VAR:
+    case OP_TX_RESET:
+    case OP_TX_IDENTITY:        return p_script;
+
+    case OP_RUN_SCRIPT:
+    case OP_STROKE_WIDTH:
+    case OP_MITER_LIMIT:
+    case OP_LINE_CAP:
+    case OP_LINE_JOIN:
+    case OP_GLOBAL_ALPHA:
+    case OP_PATH_WINDING:
+    case OP_CIRCLE:
+    case OP_TX_ROTATE:
+    case OP_TX_SKEW_X:
+    case OP_TX_SKEW_Y:
+    case OP_FONT_BLUR:
+    case OP_FONT_SIZE:
+    case OP_TEXT_ALIGN:
+    case OP_TEXT_HEIGHT:        return p_script + sizeof(GLuint);
+
+    case OP_PAINT_LINEAR:       return p_script + sizeof(linear_gradient_t);
+    case OP_PAINT_BOX:          return p_script + sizeof(box_gradient_t);
+    case OP_PAINT_RADIAL:       return p_script + sizeof(radial_gradient_t);
+    case OP_PAINT_IMAGE:
+    case OP_PAINT_DYNAMIC:      return p_script + sizeof(image_pattern_t);
+    case OP_STROKE_COLOR:
+    case OP_FILL_COLOR:         return p_script + sizeof(color_t);
+    case OP_SCISSOR:
+    case OP_INTERSECT_SCISSOR:
+    case OP_RECT:               return p_script + sizeof(wh_t);
+    case OP_PATH_MOVE_TO:
+    case OP_PATH_LINE_TO:
+    case OP_TX_TRANSLATE:
+    case OP_TX_SCALE:           return p_script + sizeof(xy_t);
+    case OP_PATH_BEZIER_TO:     return p_script + sizeof(bezier_to_t);
+    case OP_PATH_QUADRATIC_TO:  return p_script + sizeof(quadratic_to_t);
+    case OP_PATH_ARC_TO:        return p_script + sizeof(arc_to_t);
+    case OP_TRIANGLE:           return p_script + sizeof(triangle_t);
+    case OP_ARC:
+    case OP_SECTOR:             return p_script + sizeof(arc_sector_t);
+    case OP_ROUND_RECT:         return p_script + sizeof(whr_t);
+    case OP_ELLIPSE:            return p_script + sizeof(ellipse_t);
+    case OP_TX_MATRIX:          return p_script + sizeof(matrix_t);
+
+    // text is padded to 32-bits
+    case OP_TEXT:
+      return p_script + sizeof(text_t) + ((((text_t*)p_script)->size + 3) & ~3);
+    case OP_FONT:
+    case OP_FONT_SLOT:
+      return p_script + sizeof(GLuint) + *(GLuint*)p_script;
+
+    default:                    return NULL;
+  }
+}
+
+// gives each font name in the script a slot, and rewrites the OP_FONT ops
+// to use it. The names are padded to at least a word, which the slot takes.
+// Texture handles are counted, so a handle isn't dropped while it is drawn
+static void resolve_refs( NVGcontext* p_ctx, void* p_script, int length ) {
+  void* p_end = p_script + length;
+  while ( p_script + sizeof(GLuint) <= p_end ) {
+    GLuint* p_op = p_script;
+    p_script = next_op( *p_op, p_script + sizeof(GLuint) );
+    if ( !p_script || p_script > p_end ) return;
+
+    if ( *p_op == OP_FONT && p_op[1] >= sizeof(GLuint) && ((char*)p_script)[-1] == 0 ) {
+      p_op[2] = ref_font_slot( p_ctx, (const char*)&p_op[2] );
+      p_op[0] = OP_FONT_SLOT;
+    } else if ( *p_op == OP_PAINT_IMAGE || *p_op == OP_PAINT_DYNAMIC ) {
+      ref_tx_handle( ((image_pattern_t*)&p_op[1])->handle );
+    }
+  }
+}
+
+// drops the references resolve_refs took. Walks the script the same way,
+// so it stops wherever resolve_refs did, terminated or not
+static void release_refs( NVGcontext* p_ctx, void* p_script, int length ) {
+  void* p_end = p_script + length;
+  while ( p_script + sizeof(GLuint) <= p_end ) {
+    GLuint* p_op = p_script;
+    p_script = next_op( *p_op, p_script + sizeof(GLuint) );
+    if ( !p_script || p_script > p_end ) return;
+
+    if ( *p_op == OP_FONT_SLOT ) {
+      unref_font_slot( p_ctx, p_op[2] );
+    } else if ( *p_op == OP_PAINT_IMAGE || *p_op == OP_PAINT_DYNAMIC ) {
+      unref_tx_handle( ((image_pattern_t*)&p_op[1])->handle );
+    }
+  }
+}
+
+// the new script takes its references before the old one lets go, so a
+// graph sent again doesn't drop the fonts and handles it keeps using
+void put_script( driver_data_t* p_data, GLuint id, void* p_script, int length ) {
+  resolve_refs( p_data->p_ctx, p_script, length );
+  delete_script( p_data, id );
+  p_data->p_scripts[id] = p_script;
+  p_data->p_script_lengths[id] = length;
+}
+
 //=============================================================================
 // operations
 
@@ -368,42 +405,61 @@ void* paint_radial( NVGcontext* p_ctx, void* p_script ) {
   return p_script + sizeof(radial_gradient_t);
 }
 
+// the paint for a loaded texture. Textures packed in an atlas page are
+// drawn from their part of the page
+static NVGpaint image_pattern( NVGcontext* p_ctx, image_pattern_t* img, int id,
+                               tx_rect_t* p_rect, float alpha ) {
+  // if ox, oy, ex, ey are all zero, then use the
+  // natural h/w of the image
+  float ox = img->ox;
+  float oy = img->oy;
+  float ex = img->ex;
+  float ey = img->ey;
+  int w = p_rect->w;
+  int h = p_rect->h;
+  if ( w == 0 ) nvgImageSize(p_ctx, id, &w, &h);
+  if ( ox == 0.0 && oy == 0.0 && ex == 0.0 && ey == 0.0 ) {
+    ex = w;
+    ey = h;
+  }
+
+  // one image pixel covers less than a screen pixel under the current
+  // transform. The texture gets its mipmaps if it allows them
+  float xform[6];
+  nvgCurrentTransform(p_ctx, xform);
+  float sx = sqrtf(xform[0] * xform[0] + xform[1] * xform[1]);
+  float sy = sqrtf(xform[2] * xform[2] + xform[3] * xform[3]);
+  if ( fabsf(ex) * sx < w * 0.99f || fabsf(ey) * sy < h * 0.99f ) {
+    mipmap_tx_handle(p_ctx, img->handle, &id, p_rect);
+  }
+
+  if ( p_rect->w == 0 ) {
+    return nvgImagePattern( p_ctx, ox, oy, ex, ey, img->angle, id, alpha );
+  }
+  return nvgImageRegionPattern( p_ctx, ox, oy, ex, ey, img->angle, id,
+    p_rect->x, p_rect->y, p_rect->w, p_rect->h, alpha );
+}
+
 void* paint_image( NVGcontext* p_ctx, void* p_script, driver_data_t* p_data ) {
   image_pattern_t* img = (image_pattern_t*)p_script;
   p_script += sizeof(image_pattern_t);
 
   float alpha = (float)img->alpha / 255.0;
 
-  // get the image id from the hash.
-  int id = get_tx_id(p_data->p_tx_ids, p_script);
+  // get the image id from the handle.
+  tx_rect_t rect;
+  const char* p_key;
+  int id = use_tx_handle(img->handle, &rect, &p_key);
 
-  // if the id is -1, then it isn't loaded
+  // if the id is -1, then it isn't loaded. A blob that is still being
+  // decoded isn't a miss, it just isn't drawn yet
   if ( id < 0 ) {
-    send_static_texture_miss( p_script );
+    if ( p_key && !is_tx_pending(p_key) ) send_static_texture_miss( p_key );
   } else {
-
-    // if ox, oy, ex, ey are all zero, then use the
-    // natural h/w of the image
-    float ox = img->ox;
-    float oy = img->oy;
-    float ex = img->ex;
-    float ey = img->ey;
-    if ( ox == 0.0 && oy == 0.0 && ex == 0.0 && ey == 0.0 ) {
-      int w, h;
-      nvgImageSize(p_ctx, id, &w, &h);
-      ex = w;
-      ey = h;
-    }
-
-    // the id is loaded and found
-    current_paint = nvgImagePattern(
-      p_ctx,
-      ox, oy, ex, ey,
-      img->angle, id, alpha
-    );
+    current_paint = image_pattern( p_ctx, img, id, &rect, alpha );
   }
 
-  return p_script + img->key_size;
+  return p_script;
 }
 
 void* paint_dynamic(NVGcontext* p_ctx, void* p_script, driver_data_t* p_data)
@@ -413,37 +469,22 @@ void* paint_dynamic(NVGcontext* p_ctx, void* p_script, driver_data_t* p_data)
 
   float alpha = (float) img->alpha / 255.0;
 
-  // get the image id from the hash.
-  int id = get_tx_id(p_data->p_tx_ids, p_script);
+  // get the image id from the handle.
+  tx_rect_t rect;
+  const char* p_key;
+  int id = use_tx_handle(img->handle, &rect, &p_key);
 
   // if the id is -1, then it isn't loaded
   if (id < 0)
   {
-    send_dynamic_texture_miss(p_script);
+    if (p_key) send_dynamic_texture_miss(p_key);
   }
   else
   {
-
-    // if ox, oy, ex, ey are all zero, then use the
-    // natural h/w of the image
-    float ox = img->ox;
-    float oy = img->oy;
-    float ex = img->ex;
-    float ey = img->ey;
-    if (ox == 0.0 && oy == 0.0 && ex == 0.0 && ey == 0.0)
-    {
-      int w, h;
-      nvgImageSize(p_ctx, id, &w, &h);
-      ex = w;
-      ey = h;
-    }
-
-    // the id is loaded and found
-    current_paint =
-        nvgImagePattern(p_ctx, ox, oy, ex, ey, img->angle, id, alpha);
+    current_paint = image_pattern(p_ctx, img, id, &rect, alpha);
   }
 
-  return p_script + img->key_size;
+  return p_script;
 }
 
 //---------------------------------------------------------
@@ -677,6 +718,9 @@ void* text( NVGcontext* p_ctx, void* p_script ) {
   NVGtextRow rows[3];
   int nrows, i;
 
+  // make the new glyphs of all the lines at once
+  nvgTextRasterize(p_ctx, start, end);
+
   // up to this code to break the lines...
   while ((nrows = nvgTextBreakLines(p_ctx, start, end, 1000, rows, 3))) {
     for (i = 0; i < nrows; i++) {
@@ -760,6 +804,22 @@ void* font( NVGcontext* p_ctx, void* p_script ) {
   return p_script + name_length;
 }
 
+// OP_FONT after put_script resolved the name
+void* font_slot( NVGcontext* p_ctx, void* p_script ) {
+  GLuint  name_length = *(GLuint*)p_script;
+  p_script += sizeof(GLuint);
+
+  const char* p_name;
+  int font_id = use_font_slot( *(GLuint*)p_script, &p_name );
+  if ( font_id >= 0 ) {
+    nvgFontFaceId(p_ctx, font_id);
+  } else if ( p_name ) {
+    send_font_miss( p_name );
+  }
+
+  return p_script + name_length;
+}
+
 void* font_blur( NVGcontext* p_ctx, void* p_script ) {
   nvgFontBlur(p_ctx, *(float*)p_script);
   return p_script + sizeof(float);
@@ -891,6 +951,7 @@ void run_script( GLuint script_id, driver_data_t* p_data ) {
 
       // font styles
       case OP_FONT:                     p_script = font( p_ctx, p_script ); break;
+      case OP_FONT_SLOT:                p_script = font_slot( p_ctx, p_script ); break;
       case OP_FONT_BLUR:                p_script = font_blur( p_ctx, p_script ); break;
       case OP_FONT_SIZE:                p_script = font_size( p_ctx, p_script ); break;
       case OP_TEXT_ALIGN:               p_script = text_align( p_ctx, p_script ); break;
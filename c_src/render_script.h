@@ -11,7 +11,92 @@ functions to play a compiled render script
 
 #include "types.h"
 
-void put_script( driver_data_t* p_data, GLuint id, void* p_script );
+// script op codes. These must match the ones in compile.ex
+// state control
+#define OP_PUSH_STATE              0X01
+#define OP_POP_STATE               0X02
+#define OP_RESET_STATE             0X03
+
+#define OP_RUN_SCRIPT              0X04
+
+// RENDER STYLES
+#define OP_PAINT_LINEAR            0X06
+#define OP_PAINT_BOX               0X07
+#define OP_PAINT_RADIAL            0X08
+#define OP_PAINT_IMAGE             0X09
+#define OP_PAINT_DYNAMIC           0X0A
+
+//  #define OP_ANTI_ALIAS              0X0A
+
+#define OP_STROKE_WIDTH            0X0C
+#define OP_STROKE_COLOR            0X0D
+#define OP_STROKE_PAINT            0X0E
+
+#define OP_FILL_COLOR              0X10
+#define OP_FILL_PAINT              0x11
+
+#define OP_MITER_LIMIT             0X14
+#define OP_LINE_CAP                0X15
+#define OP_LINE_JOIN               0X16
+#define OP_GLOBAL_ALPHA            0X17
+
+// SCISSORING
+#define OP_SCISSOR                 0X1B
+#define OP_INTERSECT_SCISSOR       0X1C
+#define OP_RESET_SCISSOR           0X1D
+
+// PATH OPERATIONS
+#define OP_PATH_BEGIN              0X20
+
+#define OP_PATH_MOVE_TO            0X21
+#define OP_PATH_LINE_TO            0X22
+#define OP_PATH_BEZIER_TO          0X23
+#define OP_PATH_QUADRATIC_TO       0X24
+#define OP_PATH_ARC_TO             0X25
+#define OP_PATH_CLOSE              0X26
+#define OP_PATH_WINDING            0X27
+
+#define OP_FILL                    0X29
+#define OP_STROKE                  0X2A
+
+#define OP_TRIANGLE                0X2C
+#define OP_ARC                     0X2D
+#define OP_RECT                    0X2E
+#define OP_ROUND_RECT              0X2F
+#define OP_ROUND_RECT_VAR          0X30
+#define OP_ELLIPSE                 0X31
+#define OP_CIRCLE                  0X32
+#define OP_SECTOR                  0X33
+
+#define OP_TEXT                    0x34
+
+
+// TRANSFORM OPERATIONS
+#define OP_TX_RESET                0X36
+#define OP_TX_IDENTITY             0X37
+#define OP_TX_MATRIX               0X38
+#define OP_TX_TRANSLATE            0X39
+#define OP_TX_SCALE                0X3A
+#define OP_TX_ROTATE               0X3B
+#define OP_TX_SKEW_X               0X3C
+#define OP_TX_SKEW_Y               0X3D
+
+
+#define OP_FONT                    0X40
+#define OP_FONT_BLUR               0X41
+#define OP_FONT_SIZE               0X42
+#define OP_TEXT_ALIGN              0X43
+#define OP_TEXT_HEIGHT             0X44
+
+
+#define OP_TERMINATE               0XFF
+
+// ops that put_script rewrites stored scripts with. Never sent by compile.ex
+#define OP_FONT_SLOT               0X140   // OP_FONT with the slot in place of the name's first word
+
+
+// stores a script of length bytes, taking ownership of it
+void put_script( driver_data_t* p_data, GLuint id, void* p_script, int length );
 void* get_script( driver_data_t* p_data, GLuint id );
 void delete_script( driver_data_t* p_data, GLuint id );
 void delete_all( driver_data_t* p_data );
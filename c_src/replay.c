@@ -0,0 +1,659 @@
+/*
+Headless replay and benchmark tool
+
+Plays a message stream captured with "scenic_driver_egl -c <path>" (see
+capture.h) through the same comms, render script and texture code as the
+driver. Frames are rendered into an offscreen EGL surface, so this runs on
+machines without a display or GPU (Mesa llvmpipe is fine), or with the
+software nanovg back-end, which needs no GL at all.
+
+usage: scenic_driver_egl_replay [options] <capture file>
+  -r            replay at the recorded timing instead of as fast as possible
+  -n <count>    size of the script table (default 1024)
+  -s            render with the software back-end (nanovg_sw.h)
+  -d <dir>      write every rendered frame to <dir>/frame_NNNNN.png
+  -x <dir>      compare every rendered frame with <dir>/frame_NNNNN.png and
+                fail if they differ by more than anti-aliasing noise
+  -j            print the report as JSON
+*/
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define NANOVG_GLES2_IMPLEMENTATION
+#include "nanovg/nanovg.h"
+#include "nanovg/nanovg_gl.h"
+#define NANOVG_SW_IMPLEMENTATION
+#include "nanovg/nanovg_sw.h"
+#include "nanovg/stb_image.h"
+
+#include "types.h"
+#include "capture.h"
+#include "comms.h"
+#include "font.h"
+#include "png.h"
+#include "render_script.h"
+#include "tx.h"
+
+#define DEFAULT_NUM_SCRIPTS   1024
+
+// a pixel differs from the reference if any channel is off by more than
+// DIFF_THRESHOLD. Edges anti-aliased by coverage instead of fringe geometry
+// land well under it. A frame fails if more than MAX_DIFF_PERCENT of its
+// pixels differ
+#define DIFF_THRESHOLD        64
+#define MAX_DIFF_PERCENT      0.5
+
+typedef struct
+{
+  EGLDisplay display;
+  EGLConfig  config;
+  EGLContext context;
+  EGLSurface surface;
+} replay_egl_t;
+
+typedef struct
+{
+  double  cpu_ms;
+  double  wall_ms;
+  int     draw_calls;
+  int     triangles;
+  int     vertices;
+} frame_stats_t;
+
+typedef struct
+{
+  int     frames;
+  int     failed;
+  double  worst_percent;
+  double  mean_abs_diff;
+} compare_stats_t;
+
+typedef struct
+{
+  frame_stats_t* p_frames;
+  int            num_frames;
+  int            max_frames;
+  int            num_messages;
+  uint64_t       stream_bytes;
+  double         dispatch_cpu_ms;
+  double         total_wall_ms;
+  compare_stats_t compare;
+  NVGtextAtlasStats atlas;
+} replay_stats_t;
+
+// the software back-end's target. NULL when rendering with GL
+static uint32_t* sw_pixels = NULL;
+
+//=============================================================================
+// clocks
+
+static double thread_cpu_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double wall_ms() {
+  return monotonic_ns() / 1000000.0;
+}
+
+static void sleep_until_ns( uint64_t t ) {
+  struct timespec ts;
+  ts.tv_sec  = t / 1000000000;
+  ts.tv_nsec = t % 1000000000;
+  while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0 ) {}
+}
+
+//=============================================================================
+// offscreen EGL
+
+static int init_headless_egl( replay_egl_t* p_egl, int width, int height ) {
+  EGLint major, minor, n;
+
+  static const EGLint context_attribs[] = {
+    EGL_CONTEXT_CLIENT_VERSION, 2,
+    EGL_NONE
+  };
+
+  static const EGLint config_attribs[] = {
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_STENCIL_SIZE, 1,
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_NONE
+  };
+
+  const EGLint surface_attribs[] = {
+    EGL_WIDTH, width,
+    EGL_HEIGHT, height,
+    EGL_NONE
+  };
+
+  // prefer the surfaceless platform, which needs no window system at all
+  p_egl->display = EGL_NO_DISPLAY;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if ( get_platform_display ) {
+    p_egl->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                          EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if ( p_egl->display == EGL_NO_DISPLAY || !eglInitialize(p_egl->display, &major, &minor) ) {
+    p_egl->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if ( !eglInitialize(p_egl->display, &major, &minor) ) {
+      fprintf(stderr, "failed to initialize EGL\n");
+      return -1;
+    }
+  }
+
+  if ( !eglBindAPI(EGL_OPENGL_ES_API) ) {
+    fprintf(stderr, "failed to bind api EGL_OPENGL_ES_API\n");
+    return -1;
+  }
+
+  if ( !eglChooseConfig(p_egl->display, config_attribs, &p_egl->config, 1, &n) || n != 1 ) {
+    fprintf(stderr, "failed to choose config: %d\n", n);
+    return -1;
+  }
+
+  p_egl->context = eglCreateContext(p_egl->display, p_egl->config,
+                                    EGL_NO_CONTEXT, context_attribs);
+  if ( p_egl->context == EGL_NO_CONTEXT ) {
+    fprintf(stderr, "failed to create context\n");
+    return -1;
+  }
+
+  p_egl->surface = eglCreatePbufferSurface(p_egl->display, p_egl->config, surface_attribs);
+  if ( p_egl->surface == EGL_NO_SURFACE ) {
+    fprintf(stderr, "failed to create pbuffer surface\n");
+    return -1;
+  }
+
+  eglMakeCurrent(p_egl->display, p_egl->surface, p_egl->surface, p_egl->context);
+
+  fprintf(stderr, "Replaying on \"%s\", %s\n",
+          glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+  // same gles setup as the driver
+  glViewport(0, 0, width, height);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  return 0;
+}
+
+//=============================================================================
+// stream reading
+
+static bool read_fully( int fd, void* p_buff, size_t len ) {
+  size_t got = 0;
+  while ( got < len ) {
+    ssize_t n = read(fd, (char*)p_buff + got, len - got);
+    if ( n <= 0 ) return false;
+    got += n;
+  }
+  return true;
+}
+
+static bool read_capture_header( int fd, capture_header_t* p_header ) {
+  if ( !read_fully(fd, p_header, sizeof(capture_header_t)) ) {
+    fprintf(stderr, "capture file is too short\n");
+    return false;
+  }
+  if ( memcmp(p_header->magic, CAPTURE_MAGIC, sizeof(p_header->magic)) != 0 ) {
+    fprintf(stderr, "not a capture file\n");
+    return false;
+  }
+  if ( p_header->byte_order != CAPTURE_BYTE_ORDER ) {
+    fprintf(stderr, "capture was recorded on a machine with a different byte order\n");
+    return false;
+  }
+  if ( p_header->version != CAPTURE_VERSION ) {
+    fprintf(stderr, "unsupported capture version %u\n", p_header->version);
+    return false;
+  }
+  return true;
+}
+
+//=============================================================================
+// rendering
+
+// reads the last frame as top-down RGBA
+static unsigned char* read_frame( int width, int height ) {
+  size_t         row   = (size_t)width * 4;
+  unsigned char* p_img = malloc(row * height);
+  if ( !p_img ) return NULL;
+
+  if ( sw_pixels ) {
+    // premultiplied ARGB words to the premultiplied RGBA bytes gl gives
+    for ( size_t i = 0; i < (size_t)width * height; i++ ) {
+      uint32_t px = sw_pixels[i];
+      p_img[i * 4]     = px >> 16;
+      p_img[i * 4 + 1] = px >> 8;
+      p_img[i * 4 + 2] = px;
+      p_img[i * 4 + 3] = px >> 24;
+    }
+    return p_img;
+  }
+
+  unsigned char* p_gl = malloc(row * height);
+  if ( !p_gl ) {
+    free(p_img);
+    return NULL;
+  }
+
+  // gl reads bottom-up
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, p_gl);
+  for ( int y = 0; y < height; y++ ) {
+    memcpy(p_img + y * row, p_gl + (height - 1 - y) * row, row);
+  }
+  free(p_gl);
+  return p_img;
+}
+
+static void dump_frame( const char* dir, int frame, int width, int height,
+                        const unsigned char* p_img ) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/frame_%05d.png", dir, frame);
+  if ( !write_png(path, width, height, p_img) ) {
+    fprintf(stderr, "failed to write %s\n", path);
+  }
+}
+
+static void compare_frame( const char* dir, int frame, int width, int height,
+                           const unsigned char* p_img, compare_stats_t* p_stats ) {
+  char path[1024];
+  int  w, h, n;
+  snprintf(path, sizeof(path), "%s/frame_%05d.png", dir, frame);
+
+  unsigned char* p_ref = stbi_load(path, &w, &h, &n, 4);
+  if ( !p_ref || w != width || h != height ) {
+    fprintf(stderr, "no matching reference %s\n", path);
+    stbi_image_free(p_ref);
+    p_stats->frames++;
+    p_stats->failed++;
+    p_stats->worst_percent = 100.0;
+    return;
+  }
+
+  size_t   pixels    = (size_t)width * height;
+  size_t   differing = 0;
+  uint64_t total     = 0;
+  for ( size_t i = 0; i < pixels; i++ ) {
+    int worst = 0;
+    for ( int c = 0; c < 4; c++ ) {
+      int d = abs((int)p_img[i * 4 + c] - (int)p_ref[i * 4 + c]);
+      total += d;
+      if ( d > worst ) worst = d;
+    }
+    if ( worst > DIFF_THRESHOLD ) differing++;
+  }
+  stbi_image_free(p_ref);
+
+  double percent = 100.0 * differing / pixels;
+  double mean    = (double)total / (pixels * 4);
+  if ( percent > MAX_DIFF_PERCENT ) {
+    fprintf(stderr, "frame %d differs from %s: %.3f%% of pixels, mean abs diff %.3f\n",
+            frame, path, percent, mean);
+    p_stats->failed++;
+  }
+  if ( percent > p_stats->worst_percent ) p_stats->worst_percent = percent;
+  p_stats->mean_abs_diff = (p_stats->mean_abs_diff * p_stats->frames + mean) / (p_stats->frames + 1);
+  p_stats->frames++;
+}
+
+static void render_frame( driver_data_t* p_data, replay_stats_t* p_stats ) {
+  frame_stats_t frame;
+
+  double cpu_start  = thread_cpu_ms();
+  double wall_start = wall_ms();
+
+  if ( sw_pixels ) {
+    nvgSWClear(p_data->p_ctx, p_data->clear_color);
+  } else {
+    glClearColor(p_data->clear_color.r, p_data->clear_color.g,
+                 p_data->clear_color.b, p_data->clear_color.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  }
+
+  nvgBeginFrame(p_data->p_ctx, p_data->screen_width, p_data->screen_height, 1.0f);
+  if ( p_data->root_script >= 0 ) {
+    run_script(p_data->root_script, p_data);
+  }
+  nvgFrameStats(p_data->p_ctx, &frame.draw_calls, &frame.triangles, &frame.vertices);
+  nvgEndFrame(p_data->p_ctx);
+  end_tx_frame(p_data);
+
+  // wait for the frame to actually be drawn so the wall time is honest
+  if ( !sw_pixels ) glFinish();
+
+  frame.cpu_ms  = thread_cpu_ms() - cpu_start;
+  frame.wall_ms = wall_ms() - wall_start;
+
+  if ( p_stats->num_frames == p_stats->max_frames ) {
+    p_stats->max_frames = p_stats->max_frames ? p_stats->max_frames * 2 : 256;
+    p_stats->p_frames = realloc(p_stats->p_frames,
+                                sizeof(frame_stats_t) * p_stats->max_frames);
+  }
+  p_stats->p_frames[p_stats->num_frames++] = frame;
+}
+
+//=============================================================================
+// reporting
+
+static int compare_double( const void* a, const void* b ) {
+  double da = *(const double*)a;
+  double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+typedef struct
+{
+  double avg;
+  double p50;
+  double p95;
+  double max;
+} summary_t;
+
+static summary_t summarize( const replay_stats_t* p_stats, size_t offset ) {
+  summary_t summary = {0, 0, 0, 0};
+  int       n       = p_stats->num_frames;
+  if ( n == 0 ) return summary;
+
+  double* p_values = malloc(sizeof(double) * n);
+  double  total    = 0;
+  for ( int i = 0; i < n; i++ ) {
+    p_values[i] = *(double*)((char*)&p_stats->p_frames[i] + offset);
+    total += p_values[i];
+  }
+  qsort(p_values, n, sizeof(double), compare_double);
+
+  summary.avg = total / n;
+  summary.p50 = p_values[n / 2];
+  summary.p95 = p_values[(int)((n - 1) * 0.95)];
+  summary.max = p_values[n - 1];
+  free(p_values);
+  return summary;
+}
+
+static void report( const replay_stats_t* p_stats, bool json, bool compared ) {
+  int    n        = p_stats->num_frames;
+  double calls    = 0;
+  double tris     = 0;
+  double verts    = 0;
+  for ( int i = 0; i < n; i++ ) {
+    calls += p_stats->p_frames[i].draw_calls;
+    tris  += p_stats->p_frames[i].triangles;
+    verts += p_stats->p_frames[i].vertices;
+  }
+  if ( n > 0 ) {
+    calls /= n;
+    tris  /= n;
+    verts /= n;
+  }
+
+  summary_t cpu  = summarize(p_stats, offsetof(frame_stats_t, cpu_ms));
+  summary_t wall = summarize(p_stats, offsetof(frame_stats_t, wall_ms));
+  double    secs = p_stats->total_wall_ms / 1000.0;
+  double    fps  = secs > 0 ? n / secs : 0;
+  double    mbps = secs > 0 ? p_stats->stream_bytes / (1024.0 * 1024.0) / secs : 0;
+
+  // blobs are decoded on worker threads, so their cost isn't in the
+  // dispatch or frame times
+  tx_stats_t tx;
+  get_tx_stats(&tx);
+  double decode_avg_ms = tx.decoded ? tx.decode_total_ns / 1e6 / tx.decoded : 0;
+  double decode_max_ms = tx.decode_max_ns / 1e6;
+
+  miss_stats_t miss;
+  get_miss_stats(&miss);
+
+  // done between frames, counted in the dispatch time
+  prewarm_stats_t prewarm;
+  get_prewarm_stats(&prewarm);
+
+  const NVGtextAtlasStats* atlas = &p_stats->atlas;
+  double atlas_pct = atlas->width > 0 && atlas->height > 0 ?
+    100.0 * atlas->used / ((double)atlas->width * atlas->height) : 0;
+
+  if ( json ) {
+    printf("{\"frames\": %d, \"messages\": %d, \"stream_bytes\": %llu, "
+           "\"total_ms\": %.3f, \"fps\": %.2f, \"stream_mb_per_s\": %.2f, "
+           "\"dispatch_cpu_ms\": %.3f, "
+           "\"frame_cpu_ms\": {\"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f}, "
+           "\"frame_wall_ms\": {\"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f}, "
+           "\"draw_calls\": %.1f, \"triangles\": %.1f, \"vertices\": %.1f, "
+           "\"tx_decode\": {\"count\": %u, \"avg_ms\": %.3f, \"max_ms\": %.3f}, "
+           "\"tx_resident_bytes\": %llu, \"tx_evictions\": %u, "
+           "\"tx_dedup\": {\"hits\": %u, \"bytes\": %llu}, "
+           "\"misses\": {\"sent\": %u, \"suppressed\": %u, \"retried\": %u}, "
+           "\"prewarm\": {\"styles\": %u, \"atlas_full\": %u, \"no_font\": %u, \"ms\": %.3f}, "
+           "\"glyph_atlas\": {\"width\": %d, \"height\": %d, \"used\": %d, \"glyphs\": %d, "
+           "\"evictions\": %d, \"rerasterized\": %d, \"resets\": %d}",
+           n, p_stats->num_messages, (unsigned long long)p_stats->stream_bytes,
+           p_stats->total_wall_ms, fps, mbps, p_stats->dispatch_cpu_ms,
+           cpu.avg, cpu.p50, cpu.p95, cpu.max,
+           wall.avg, wall.p50, wall.p95, wall.max,
+           calls, tris, verts,
+           tx.decoded, decode_avg_ms, decode_max_ms,
+           (unsigned long long)tx.resident_bytes, tx.evictions,
+           tx.dedup_hits, (unsigned long long)tx.dedup_bytes,
+           miss.sent, miss.suppressed, miss.retried,
+           prewarm.styles, prewarm.atlas_full, prewarm.no_font, prewarm.total_ns / 1e6,
+           atlas->width, atlas->height, atlas->used, atlas->glyphs,
+           atlas->evictions, atlas->rerasterized, atlas->resets);
+    if ( compared ) {
+      printf(", \"compare\": {\"frames\": %d, \"failed\": %d, "
+             "\"worst_percent\": %.4f, \"mean_abs_diff\": %.4f}",
+             p_stats->compare.frames, p_stats->compare.failed,
+             p_stats->compare.worst_percent, p_stats->compare.mean_abs_diff);
+    }
+    printf("}\n");
+    return;
+  }
+
+  printf("frames            %d\n", n);
+  printf("messages          %d (%llu bytes)\n", p_stats->num_messages,
+         (unsigned long long)p_stats->stream_bytes);
+  printf("total             %.1f ms, %.1f fps, %.2f MB/s of stream\n",
+         p_stats->total_wall_ms, fps, mbps);
+  printf("dispatch cpu      %.3f ms\n", p_stats->dispatch_cpu_ms);
+  printf("frame cpu ms      avg %.3f  p50 %.3f  p95 %.3f  max %.3f\n",
+         cpu.avg, cpu.p50, cpu.p95, cpu.max);
+  printf("frame wall ms     avg %.3f  p50 %.3f  p95 %.3f  max %.3f\n",
+         wall.avg, wall.p50, wall.p95, wall.max);
+  printf("per frame         %.1f draw calls, %.1f triangles, %.1f vertices\n",
+         calls, tris, verts);
+  if ( tx.decoded ) {
+    printf("texture decode    %u blobs, avg %.3f ms, max %.3f ms\n",
+           tx.decoded, decode_avg_ms, decode_max_ms);
+  }
+  printf("textures          %.1f KB resident, %u evicted\n",
+         tx.resident_bytes / 1024.0, tx.evictions);
+  if ( tx.dedup_hits ) {
+    printf("texture dedup     %u puts shared a texture, %.1f KB saved\n",
+           tx.dedup_hits, tx.dedup_bytes / 1024.0);
+  }
+  if ( miss.sent ) {
+    printf("misses            %u sent, %u suppressed, %u retried\n",
+           miss.sent, miss.suppressed, miss.retried);
+  }
+  if ( prewarm.queued ) {
+    printf("glyph prewarm     %u styles in %.3f ms, %u stopped by a full atlas, "
+           "%u by a missing font\n",
+           prewarm.styles, prewarm.total_ns / 1e6, prewarm.atlas_full, prewarm.no_font);
+  }
+  if ( atlas->glyphs ) {
+    printf("glyph atlas       %dx%d, %.1f%% used by %d glyphs\n",
+           atlas->width, atlas->height, atlas_pct, atlas->glyphs);
+    printf("glyph evictions   %d evicted, %d rasterized again, %d atlas resets\n",
+           atlas->evictions, atlas->rerasterized, atlas->resets);
+  }
+  if ( compared ) {
+    printf("reference         %d of %d frames differ, worst %.3f%% of pixels, mean abs diff %.3f\n",
+           p_stats->compare.failed, p_stats->compare.frames,
+           p_stats->compare.worst_percent, p_stats->compare.mean_abs_diff);
+  }
+}
+
+//=============================================================================
+
+static void usage() {
+  fprintf(stderr,
+          "usage: scenic_driver_egl_replay [-r] [-s] [-j] [-n scripts] [-b bytes] [-d dir] [-x dir] <capture file>\n");
+}
+
+int main( int argc, char** argv ) {
+  driver_data_t    data;
+  replay_egl_t     egl;
+  replay_stats_t   stats;
+  capture_header_t header;
+  capture_record_t record;
+
+  bool  realtime    = false;
+  bool  json        = false;
+  bool  software    = false;
+  int   num_scripts = DEFAULT_NUM_SCRIPTS;
+  char* dump_dir    = NULL;
+  char* ref_dir     = NULL;
+  long long tx_budget = 0;
+  int   opt;
+
+  while ( (opt = getopt(argc, argv, "rsjn:b:d:x:")) != -1 ) {
+    switch ( opt ) {
+      case 'r': realtime = true; break;
+      case 's': software = true; break;
+      case 'j': json = true; break;
+      case 'n': num_scripts = atoi(optarg); break;
+      case 'b': tx_budget = atoll(optarg); break;
+      case 'd': dump_dir = optarg; break;
+      case 'x': ref_dir = optarg; break;
+      default:  usage(); return 1;
+    }
+  }
+  if ( argc - optind != 1 ) {
+    usage();
+    return 1;
+  }
+
+  int fd = open(argv[optind], O_RDONLY);
+  if ( fd < 0 ) {
+    fprintf(stderr, "could not open %s\n", argv[optind]);
+    return 1;
+  }
+  if ( !read_capture_header(fd, &header) ) return 1;
+
+  // messages are read from the capture. Anything the driver would send
+  // up to the caller (draw ready, texture misses...) is thrown away
+  test_endian();
+  set_comms_fds(fd, open("/dev/null", O_WRONLY));
+
+  memset(&data, 0, sizeof(driver_data_t));
+  data.p_scripts = malloc(sizeof(void*) * num_scripts);
+  memset(data.p_scripts, 0, sizeof(void*) * num_scripts);
+  data.p_script_lengths = malloc(sizeof(int) * num_scripts);
+  memset(data.p_script_lengths, 0, sizeof(int) * num_scripts);
+  data.keep_going    = true;
+  data.num_scripts   = num_scripts;
+  data.root_script   = -1;
+  data.screen_width  = header.width;
+  data.screen_height = header.height;
+  data.tx_budget     = tx_budget;
+
+  if ( software ) {
+    fprintf(stderr, "Replaying on the software renderer\n");
+    sw_pixels  = calloc((size_t)header.width * header.height, sizeof(uint32_t));
+    data.p_ctx = nvgCreateSW(NVG_SW_ANTIALIAS);
+    if ( sw_pixels && data.p_ctx ) {
+      nvgSWSetTarget(data.p_ctx, sw_pixels, header.width, header.height,
+                     header.width * sizeof(uint32_t));
+    }
+  } else {
+    if ( init_headless_egl(&egl, header.width, header.height) ) return 1;
+    data.p_ctx = nvgCreateGLES2(NVG_ANTIALIAS | NVG_STENCIL_STROKES | NVG_DEBUG);
+  }
+  if ( data.p_ctx == NULL ) {
+    fprintf(stderr, "Failed to create nvg\n");
+    return 1;
+  }
+
+  memset(&stats, 0, sizeof(replay_stats_t));
+  uint64_t start_ns  = monotonic_ns();
+  double   start_ms  = wall_ms();
+
+  while ( data.keep_going && read_fully(fd, &record, sizeof(capture_record_t)) ) {
+    if ( realtime ) {
+      sleep_until_ns(start_ns + record.time_ns);
+    }
+
+    switch ( record.type ) {
+      case CAPTURE_REC_MSG: {
+        double cpu_start = thread_cpu_ms();
+        dispatch_message(record.length, &data);
+        stats.dispatch_cpu_ms += thread_cpu_ms() - cpu_start;
+        stats.num_messages++;
+        stats.stream_bytes += record.length;
+        break;
+      }
+
+      case CAPTURE_REC_FRAME: {
+        // the live driver uploads decoded blobs as they finish and prewarms
+        // glyphs a bit at a time. Doing all of it here keeps the replayed
+        // frames deterministic
+        double cpu_start = thread_cpu_ms();
+        upload_decoded_tx(&data, true);
+        prewarm_glyphs(&data, true);
+        stats.dispatch_cpu_ms += thread_cpu_ms() - cpu_start;
+
+        render_frame(&data, &stats);
+        if ( dump_dir || ref_dir ) {
+          int            frame = stats.num_frames - 1;
+          unsigned char* p_img = read_frame(header.width, header.height);
+          if ( p_img && dump_dir ) {
+            dump_frame(dump_dir, frame, header.width, header.height, p_img);
+          }
+          if ( p_img && ref_dir ) {
+            compare_frame(ref_dir, frame, header.width, header.height, p_img, &stats.compare);
+          }
+          free(p_img);
+        }
+        break;
+      }
+
+      default:
+        // unknown record. skip its payload
+        lseek(fd, record.length, SEEK_CUR);
+        break;
+    }
+  }
+
+  stats.total_wall_ms = wall_ms() - start_ms;
+  nvgTextAtlasStats(data.p_ctx, &stats.atlas);
+  report(&stats, json, ref_dir != NULL);
+
+  if ( software ) {
+    nvgDeleteSW(data.p_ctx);
+    free(sw_pixels);
+  } else {
+    nvgDeleteGLES2(data.p_ctx);
+    eglTerminate(egl.display);
+  }
+  close(fd);
+  return stats.compare.failed ? 2 : 0;
+}
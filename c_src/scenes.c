@@ -0,0 +1,1007 @@
+/*
+Generator for the synthetic benchmark scenes
+
+Each scene is written as a capture file (see capture.h) made of hand built
+messages and render scripts, so it can be played back by
+scenic_driver_egl_replay exactly like a capture of a real app. Every scene
+stresses one part of the render script interpreter or of nanovg, so a
+regression shows up in the scene that exercises it instead of being lost in
+the average of a whole app screen.
+
+The content is generated from a fixed seed. The same options always produce
+byte for byte identical files, so timings can be compared across builds.
+
+  scenic_driver_egl_scenes [-w width] [-h height] [-f frames] [-t font] dir [scene...]
+  scenic_driver_egl_scenes -l
+
+Every frame re-sends the root script (id 0) with a small translation and
+then presents. The scene content lives in scripts 1 and up and is sent once.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <GLES2/gl2.h>
+
+#include "types.h"
+#include "capture.h"
+#include "comms.h"
+#include "font.h"
+#include "render_script.h"
+#include "png.h"
+#include "tx.h"
+
+#define DEFAULT_WIDTH       800
+#define DEFAULT_HEIGHT      480
+#define DEFAULT_FRAMES      120
+
+#define FRAME_NS            16666667
+#define CONTENT_SCRIPT      1
+#define FONT_NAME           "roboto"
+
+//=============================================================================
+// growable byte buffer used to build scripts and messages
+
+typedef struct
+{
+  unsigned char* p;
+  size_t         len;
+  size_t         cap;
+} buff_t;
+
+static void put_bytes( buff_t* b, const void* p_data, size_t len ) {
+  if ( b->len + len > b->cap ) {
+    while ( b->len + len > b->cap ) {
+      b->cap = b->cap ? b->cap * 2 : 4096;
+    }
+    b->p = realloc(b->p, b->cap);
+  }
+  memcpy(b->p + b->len, p_data, len);
+  b->len += len;
+}
+
+static void put_u32( buff_t* b, uint32_t v ) { put_bytes(b, &v, sizeof(uint32_t)); }
+static void put_f32( buff_t* b, float v ) { put_bytes(b, &v, sizeof(float)); }
+
+// strings in scripts are NUL terminated and padded to 32 bits. The length
+// written in front of them includes the padding
+static void put_padded_str( buff_t* b, const char* str ) {
+  static const unsigned char zeros[4] = {0, 0, 0, 0};
+  size_t len    = strlen(str) + 1;
+  size_t padded = (len + 3) & ~3;
+  put_u32(b, padded);
+  put_bytes(b, str, len);
+  put_bytes(b, zeros, padded - len);
+}
+
+static void buff_free( buff_t* b ) {
+  free(b->p);
+  memset(b, 0, sizeof(buff_t));
+}
+
+//=============================================================================
+// deterministic random numbers
+
+static uint32_t seed;
+
+static uint32_t next_rand() {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+static float rand_float( float lo, float hi ) {
+  return lo + (hi - lo) * (next_rand() & 0xFFFF) / 65535.0f;
+}
+
+static int rand_int( int lo, int hi ) {
+  return lo + next_rand() % (hi - lo + 1);
+}
+
+//=============================================================================
+// script ops
+
+static void op( buff_t* s, uint32_t op_code ) { put_u32(s, op_code); }
+
+static void op_xy( buff_t* s, uint32_t op_code, float x, float y ) {
+  put_u32(s, op_code);
+  put_f32(s, x);
+  put_f32(s, y);
+}
+
+static void op_f( buff_t* s, uint32_t op_code, float v ) {
+  put_u32(s, op_code);
+  put_f32(s, v);
+}
+
+static void op_u( buff_t* s, uint32_t op_code, uint32_t v ) {
+  put_u32(s, op_code);
+  put_u32(s, v);
+}
+
+static void op_color( buff_t* s, uint32_t op_code, uint32_t r, uint32_t g, uint32_t b, uint32_t a ) {
+  put_u32(s, op_code);
+  put_u32(s, r);
+  put_u32(s, g);
+  put_u32(s, b);
+  put_u32(s, a);
+}
+
+static void op_random_color( buff_t* s, uint32_t op_code, uint32_t a ) {
+  op_color(s, op_code, rand_int(0, 255), rand_int(0, 255), rand_int(0, 255), a);
+}
+
+static void op_rect( buff_t* s, float w, float h ) {
+  op_xy(s, OP_RECT, w, h);
+}
+
+static void op_sector( buff_t* s, uint32_t op_code, float radius, float start, float finish ) {
+  put_u32(s, op_code);
+  put_f32(s, radius);
+  put_f32(s, start);
+  put_f32(s, finish);
+}
+
+static void put_colors( buff_t* s ) {
+  for ( int i = 0; i < 2; i++ ) {
+    put_u32(s, rand_int(0, 255));
+    put_u32(s, rand_int(0, 255));
+    put_u32(s, rand_int(0, 255));
+    put_u32(s, 255);
+  }
+}
+
+//=============================================================================
+// capture output
+
+typedef struct
+{
+  FILE*    file;
+  uint64_t time_ns;
+} scene_out_t;
+
+static void write_msg( scene_out_t* out, uint32_t msg_id, const void* p_data, size_t len ) {
+  capture_record_t record;
+  record.type    = CAPTURE_REC_MSG;
+  record.length  = sizeof(uint32_t) + len;
+  record.time_ns = out->time_ns;
+  fwrite(&record, sizeof(capture_record_t), 1, out->file);
+  fwrite(&msg_id, sizeof(uint32_t), 1, out->file);
+  if ( len ) fwrite(p_data, 1, len, out->file);
+}
+
+static void write_frame( scene_out_t* out ) {
+  capture_record_t record;
+  record.type    = CAPTURE_REC_FRAME;
+  record.length  = 0;
+  record.time_ns = out->time_ns;
+  fwrite(&record, sizeof(capture_record_t), 1, out->file);
+}
+
+// sends a finished script as a CMD_RENDER_GRAPH message
+static void write_script( scene_out_t* out, uint32_t id, buff_t* s ) {
+  buff_t msg = {0};
+  op(s, OP_TERMINATE);
+  put_u32(&msg, id);
+  put_bytes(&msg, s->p, s->len);
+  write_msg(out, CMD_RENDER_GRAPH, msg.p, msg.len);
+  buff_free(&msg);
+}
+
+//=============================================================================
+// scenes. Each one sends CONTENT_SCRIPT and anything it depends on
+
+typedef struct
+{
+  int         width;
+  int         height;
+  const char* font_path;
+} scene_opts_t;
+
+//---------------------------------------------------------
+// many small filled rects. Per-op interpreter overhead and path setup
+static bool scene_rects_10k( scene_out_t* out, const scene_opts_t* opts ) {
+  buff_t s = {0};
+  for ( int i = 0; i < 10000; i++ ) {
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, rand_float(0, opts->width), rand_float(0, opts->height));
+    op(&s, OP_PATH_BEGIN);
+    op_rect(&s, rand_float(2, 24), rand_float(2, 24));
+    op_random_color(&s, OP_FILL_COLOR, 255);
+    op(&s, OP_FILL);
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//---------------------------------------------------------
+// a deep chain of OP_RUN_SCRIPT calls, run several times. Script lookup,
+// recursion and nvgSave/nvgRestore
+#define NESTED_DEPTH    64
+#define NESTED_RUNS     16
+
+static bool scene_nested_scripts( scene_out_t* out, const scene_opts_t* opts ) {
+  buff_t s = {0};
+
+  for ( int depth = 0; depth < NESTED_DEPTH; depth++ ) {
+    s.len = 0;
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, 6, 3);
+    op_f(&s, OP_TX_ROTATE, 0.02f);
+    op(&s, OP_PATH_BEGIN);
+    op_rect(&s, 12, 12);
+    op_random_color(&s, OP_FILL_COLOR, 200);
+    op(&s, OP_FILL);
+    if ( depth + 1 < NESTED_DEPTH ) {
+      op_u(&s, OP_RUN_SCRIPT, CONTENT_SCRIPT + 1 + depth + 1);
+    }
+    op(&s, OP_POP_STATE);
+    write_script(out, CONTENT_SCRIPT + 1 + depth, &s);
+  }
+
+  s.len = 0;
+  for ( int i = 0; i < NESTED_RUNS; i++ ) {
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, (i % 4) * opts->width / 4.0f, (i / 4) * opts->height / 4.0f);
+    op_u(&s, OP_RUN_SCRIPT, CONTENT_SCRIPT + 1);
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//---------------------------------------------------------
+// long wrapped paragraphs. Line breaking, glyph lookup and text quads
+static const char* words[] = {
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+  "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore",
+  "et", "dolore", "magna", "aliqua", "Scenic", "render", "script", "glyph",
+  "atlas", "nanovg", "EGL", "frame", "0123456789", "kerning", "Wavy"
+};
+
+static bool write_font( scene_out_t* out, const scene_opts_t* opts, uint32_t flags ) {
+  if ( !opts->font_path ) {
+    fprintf(stderr, "text scenes need a font. Use -t\n");
+    return false;
+  }
+
+  buff_t msg = {0};
+  uint32_t name_length = strlen(FONT_NAME) + 1;
+  uint32_t path_length = strlen(opts->font_path) + 1;
+  put_u32(&msg, name_length);
+  put_u32(&msg, path_length);
+  put_u32(&msg, flags);
+  put_bytes(&msg, FONT_NAME, name_length);
+  put_bytes(&msg, opts->font_path, path_length);
+  write_msg(out, CMD_LOAD_FONT_FILE, msg.p, msg.len);
+  buff_free(&msg);
+  return true;
+}
+
+static bool write_text_paragraphs( scene_out_t* out, const scene_opts_t* opts, bool prewarm ) {
+  if ( !write_font(out, opts, 0) ) return false;
+  uint32_t name_length = strlen(FONT_NAME) + 1;
+
+  float sizes[] = {11, 14, 18, 24};
+  if ( prewarm ) {
+    // every character the words below use, in each size without blur
+    const char* chars = " 0123456789EGLSWabcdefghiklmnopqrstuvy";
+    uint32_t chars_length = strlen(chars);
+    buff_t pw = {0};
+    put_u32(&pw, name_length);
+    put_u32(&pw, 4);
+    put_u32(&pw, chars_length);
+    put_bytes(&pw, FONT_NAME, name_length);
+    for ( int p = 0; p < 4; p++ ) {
+      put_f32(&pw, sizes[p]);
+      put_f32(&pw, 0);
+    }
+    put_bytes(&pw, chars, chars_length);
+    write_msg(out, CMD_PREWARM_FONT, pw.p, pw.len);
+    buff_free(&pw);
+  }
+
+  buff_t s = {0};
+  op(&s, OP_FONT);
+  put_padded_str(&s, FONT_NAME);
+  op_u(&s, OP_TEXT_ALIGN, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+  op_color(&s, OP_FILL_COLOR, 230, 230, 230, 255);
+
+  for ( int p = 0; p < 4; p++ ) {
+    // build a paragraph of about 1500 characters
+    char   paragraph[2048];
+    size_t len = 0;
+    while ( len < 1500 ) {
+      const char* word = words[next_rand() % (sizeof(words) / sizeof(words[0]))];
+      len += snprintf(paragraph + len, sizeof(paragraph) - len, "%s ", word);
+    }
+    paragraph[len - 1] = 0;
+
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, 4 + (p % 2) * opts->width / 2.0f, 4 + (p / 2) * opts->height / 2.0f);
+    op_f(&s, OP_FONT_SIZE, sizes[p]);
+    op_u(&s, OP_TEXT, len - 1);
+    put_bytes(&s, paragraph, len - 1);
+    while ( s.len & 3 ) put_bytes(&s, "", 1);
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+static bool scene_text_paragraphs( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_text_paragraphs(out, opts, false);
+}
+
+// the same text, with its glyphs prewarmed before the first frame
+static bool scene_text_prewarm( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_text_paragraphs(out, opts, true);
+}
+
+//---------------------------------------------------------
+// a few lines of text that zoom in and out, one of them blurred. Nearly
+// every frame asks for new font sizes, so glyphs are rasterized all along
+// unless the font is drawn from distance fields
+#define ZOOM_LINES      4
+
+static bool scene_text_zoom( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_font(out, opts, 0);
+}
+
+static bool scene_text_zoom_sdf( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_font(out, opts, FONT_FLAG_SDF);
+}
+
+static void frame_text_zoom( scene_out_t* out, const scene_opts_t* opts, int frame ) {
+  static const char* lines[ZOOM_LINES] = {
+    "Scenic render script glyph atlas",
+    "0123456789 lorem ipsum dolor sit amet",
+    "EGL nanovg frame kerning Wavy",
+    "consectetur adipiscing elit sed do"
+  };
+  // zooms in over 20 frames and back out over the next 20
+  int   step = frame % 40;
+  float zoom = (step < 20 ? step : 40 - step) / 20.0f;
+
+  buff_t s = {0};
+  op(&s, OP_FONT);
+  put_padded_str(&s, FONT_NAME);
+  op_u(&s, OP_TEXT_ALIGN, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+  op_color(&s, OP_FILL_COLOR, 230, 230, 230, 255);
+
+  float y = 4;
+  for ( int i = 0; i < ZOOM_LINES; i++ ) {
+    float size = (10 + 6 * i) * (1 + 1.5f * zoom) * opts->height / DEFAULT_HEIGHT;
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, 4, y);
+    op_f(&s, OP_FONT_SIZE, size);
+    op_f(&s, OP_FONT_BLUR, i == 2 ? 2 : 0);
+    uint32_t len = strlen(lines[i]);
+    op_u(&s, OP_TEXT, len);
+    put_bytes(&s, lines[i], len);
+    while ( s.len & 3 ) put_bytes(&s, "", 1);
+    op(&s, OP_POP_STATE);
+    y += size * 1.3f;
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+}
+
+//---------------------------------------------------------
+// zooming lines of text, each over a blurred shadow of itself. The shadows
+// go from a slight drop shadow to a wide glow
+static bool scene_text_shadow( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_font(out, opts, 0);
+}
+
+static void frame_text_shadow( scene_out_t* out, const scene_opts_t* opts, int frame ) {
+  static const char* lines[ZOOM_LINES] = {
+    "Scenic render script glyph atlas",
+    "0123456789 lorem ipsum dolor sit amet",
+    "EGL nanovg frame kerning Wavy",
+    "consectetur adipiscing elit sed do"
+  };
+  static const float blurs[ZOOM_LINES] = {2, 4, 8, 12};
+  int   step = frame % 40;
+  float zoom = (step < 20 ? step : 40 - step) / 20.0f;
+  float scale = opts->height / (float)DEFAULT_HEIGHT;
+
+  buff_t s = {0};
+  op(&s, OP_FONT);
+  put_padded_str(&s, FONT_NAME);
+  op_u(&s, OP_TEXT_ALIGN, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+
+  float y = 8 * scale;
+  for ( int i = 0; i < ZOOM_LINES; i++ ) {
+    float size = (14 + 6 * i) * (1 + zoom) * scale;
+    uint32_t len = strlen(lines[i]);
+    for ( int pass = 0; pass < 2; pass++ ) {
+      op(&s, OP_PUSH_STATE);
+      if ( pass == 0 ) {
+        op_xy(&s, OP_TX_TRANSLATE, 8 * scale + size / 10, y + size / 10);
+        op_f(&s, OP_FONT_BLUR, blurs[i] * scale);
+        op_color(&s, OP_FILL_COLOR, 40, 80, 200, 220);
+      } else {
+        op_xy(&s, OP_TX_TRANSLATE, 8 * scale, y);
+        op_color(&s, OP_FILL_COLOR, 240, 240, 240, 255);
+      }
+      op_f(&s, OP_FONT_SIZE, size);
+      op_u(&s, OP_TEXT, len);
+      put_bytes(&s, lines[i], len);
+      while ( s.len & 3 ) put_bytes(&s, "", 1);
+      op(&s, OP_POP_STATE);
+    }
+    y += size * 1.4f;
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+}
+
+//---------------------------------------------------------
+// the same zooming lines, blurred and filled with linear and radial
+// gradients, the last two cut by a scissor. The blur passes take the
+// gradient's paint, which must not change how far apart their taps are
+static bool scene_text_grad_shadow( scene_out_t* out, const scene_opts_t* opts ) {
+  return write_font(out, opts, 0);
+}
+
+static void put_gradient_colors( buff_t* s, int i ) {
+  put_u32(s, 255);
+  put_u32(s, 200 - 40 * i);
+  put_u32(s, 40);
+  put_u32(s, 255);
+  put_u32(s, 40);
+  put_u32(s, 120 + 40 * i);
+  put_u32(s, 255);
+  put_u32(s, 255);
+}
+
+static void frame_text_grad_shadow( scene_out_t* out, const scene_opts_t* opts, int frame ) {
+  static const char* lines[ZOOM_LINES] = {
+    "Scenic render script glyph atlas",
+    "0123456789 lorem ipsum dolor sit amet",
+    "EGL nanovg frame kerning Wavy",
+    "consectetur adipiscing elit sed do"
+  };
+  static const float blurs[ZOOM_LINES] = {1, 2, 3, 6};
+  int   step = frame % 40;
+  float zoom = (step < 20 ? step : 40 - step) / 20.0f;
+  float scale = opts->height / (float)DEFAULT_HEIGHT;
+  float width = opts->width - 16 * scale;
+
+  buff_t s = {0};
+  op(&s, OP_FONT);
+  put_padded_str(&s, FONT_NAME);
+  op_u(&s, OP_TEXT_ALIGN, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+
+  float y = 8 * scale;
+  for ( int i = 0; i < ZOOM_LINES; i++ ) {
+    float size = (20 + 8 * i) * (1 + zoom) * scale;
+    uint32_t len = strlen(lines[i]);
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, 8 * scale, y);
+    if ( i >= 2 ) op_xy(&s, OP_SCISSOR, width * 0.6f, size);
+    op_f(&s, OP_FONT_BLUR, blurs[i] * scale);
+    if ( i & 1 ) {
+      put_u32(&s, OP_PAINT_RADIAL);
+      put_f32(&s, width / 4);
+      put_f32(&s, size / 2);
+      put_f32(&s, 0);
+      put_f32(&s, width / 2);
+    } else {
+      put_u32(&s, OP_PAINT_LINEAR);
+      put_f32(&s, 0);
+      put_f32(&s, 0);
+      put_f32(&s, width);
+      put_f32(&s, size);
+    }
+    put_gradient_colors(&s, i);
+    op(&s, OP_FILL_PAINT);
+    op_f(&s, OP_FONT_SIZE, size);
+    op_u(&s, OP_TEXT, len);
+    put_bytes(&s, lines[i], len);
+    while ( s.len & 3 ) put_bytes(&s, "", 1);
+    op(&s, OP_POP_STATE);
+    y += size * 1.2f;
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+}
+
+//---------------------------------------------------------
+// rounded rects filled with linear, box and radial gradients.
+// Paint setup and the gradient shader paths
+static bool scene_gradients( scene_out_t* out, const scene_opts_t* opts ) {
+  buff_t s = {0};
+  for ( int i = 0; i < 600; i++ ) {
+    float w = rand_float(20, 120);
+    float h = rand_float(20, 80);
+
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, rand_float(0, opts->width - w), rand_float(0, opts->height - h));
+    op(&s, OP_PATH_BEGIN);
+    put_u32(&s, OP_ROUND_RECT);
+    put_f32(&s, w);
+    put_f32(&s, h);
+    put_f32(&s, rand_float(0, 12));
+
+    switch ( i % 3 ) {
+      case 0:
+        put_u32(&s, OP_PAINT_LINEAR);
+        put_f32(&s, 0);
+        put_f32(&s, 0);
+        put_f32(&s, w);
+        put_f32(&s, h);
+        put_colors(&s);
+        break;
+      case 1:
+        put_u32(&s, OP_PAINT_BOX);
+        put_f32(&s, 0);
+        put_f32(&s, 0);
+        put_f32(&s, w);
+        put_f32(&s, h);
+        put_f32(&s, 6);
+        put_f32(&s, 10);
+        put_colors(&s);
+        break;
+      default:
+        put_u32(&s, OP_PAINT_RADIAL);
+        put_f32(&s, w / 2);
+        put_f32(&s, h / 2);
+        put_f32(&s, 2);
+        put_f32(&s, w / 2);
+        put_colors(&s);
+        break;
+    }
+    op(&s, OP_FILL_PAINT);
+    op(&s, OP_FILL);
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//---------------------------------------------------------
+// registers the handle scripts use to draw a texture key, the way
+// tx_handle in cache.ex does
+static void send_tx_handle( scene_out_t* out, uint32_t handle, const char* key ) {
+  buff_t   msg      = {0};
+  uint32_t key_size = strlen(key) + 1;
+  put_u32(&msg, handle);
+  put_u32(&msg, key_size);
+  put_bytes(&msg, key, key_size);
+  write_msg(out, CMD_NEW_TX_ID, msg.p, msg.len);
+  buff_free(&msg);
+}
+
+//---------------------------------------------------------
+// rects filled with image patterns from a handful of textures.
+// Texture lookup by handle and the image shader path
+#define NUM_TEXTURES    4
+#define TEXTURE_SIZE    64
+
+static void send_texture( scene_out_t* out, const char* key, int pattern ) {
+  unsigned char pixels[TEXTURE_SIZE * TEXTURE_SIZE * 4];
+  for ( int y = 0; y < TEXTURE_SIZE; y++ ) {
+    for ( int x = 0; x < TEXTURE_SIZE; x++ ) {
+      unsigned char* p = pixels + (y * TEXTURE_SIZE + x) * 4;
+      bool check = ((x >> (2 + pattern)) ^ (y >> (2 + pattern))) & 1;
+      p[0] = check ? 255 : x * 4;
+      p[1] = check ? 64 * pattern : y * 4;
+      p[2] = check ? 32 : 255 - x * 2;
+      p[3] = 255;
+    }
+  }
+
+  size_t         png_size;
+  unsigned char* p_png = encode_png(TEXTURE_SIZE, TEXTURE_SIZE, pixels, &png_size);
+
+  buff_t   msg      = {0};
+  uint32_t key_size = strlen(key) + 1;
+  put_u32(&msg, key_size);
+  put_u32(&msg, png_size);
+  put_u32(&msg, TX_FLAG_MIPMAPS);
+  put_bytes(&msg, key, key_size);
+  put_bytes(&msg, p_png, png_size);
+  write_msg(out, CMD_PUT_TX_BLOB, msg.p, msg.len);
+  buff_free(&msg);
+  free(p_png);
+}
+
+static bool scene_image_patterns( scene_out_t* out, const scene_opts_t* opts ) {
+  char key[32];
+  for ( int i = 0; i < NUM_TEXTURES; i++ ) {
+    snprintf(key, sizeof(key), "bench_tx_%d", i);
+    send_tx_handle(out, i, key);
+    send_texture(out, key, i);
+  }
+
+  buff_t s = {0};
+  for ( int i = 0; i < 1000; i++ ) {
+    float w = rand_float(16, 96);
+    float h = rand_float(16, 96);
+
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, rand_float(0, opts->width - w), rand_float(0, opts->height - h));
+    op(&s, OP_PATH_BEGIN);
+    op_rect(&s, w, h);
+
+    // all zero extents use the natural size of the image
+    put_u32(&s, OP_PAINT_IMAGE);
+    put_f32(&s, 0);
+    put_f32(&s, 0);
+    put_f32(&s, 0);
+    put_f32(&s, 0);
+    put_f32(&s, rand_float(0, 0.5f));
+    put_u32(&s, rand_int(128, 255));
+    put_u32(&s, i % NUM_TEXTURES);
+
+    op(&s, OP_FILL_PAINT);
+    op(&s, OP_FILL);
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//---------------------------------------------------------
+// one large raw texture that is re-sent every frame, like a camera feed or
+// a live plot. CMD_PUT_TX_RAW and in-place texture updates
+#define DYNAMIC_TX_KEY      "bench_dynamic"
+#define DYNAMIC_TX_WIDTH    320
+#define DYNAMIC_TX_HEIGHT   240
+
+static void send_dynamic_texture( scene_out_t* out, int frame ) {
+  static unsigned char pixels[DYNAMIC_TX_WIDTH * DYNAMIC_TX_HEIGHT * 4];
+  for ( int y = 0; y < DYNAMIC_TX_HEIGHT; y++ ) {
+    for ( int x = 0; x < DYNAMIC_TX_WIDTH; x++ ) {
+      unsigned char* p = pixels + (y * DYNAMIC_TX_WIDTH + x) * 4;
+      p[0] = x + frame * 4;
+      p[1] = y + frame * 2;
+      p[2] = (x ^ y) + frame;
+      p[3] = 255;
+    }
+  }
+
+  // same layout as put_dynamic_texture in cache.ex
+  buff_t   msg      = {0};
+  uint32_t key_size = strlen(DYNAMIC_TX_KEY) + 1;
+  put_u32(&msg, key_size);
+  put_u32(&msg, sizeof(pixels));
+  put_u32(&msg, 4);
+  put_u32(&msg, DYNAMIC_TX_WIDTH);
+  put_u32(&msg, DYNAMIC_TX_HEIGHT);
+  put_u32(&msg, TX_FLAG_MIPMAPS);
+  put_bytes(&msg, DYNAMIC_TX_KEY, key_size);
+  put_bytes(&msg, pixels, sizeof(pixels));
+  write_msg(out, CMD_PUT_TX_RAW, msg.p, msg.len);
+  buff_free(&msg);
+}
+
+static bool scene_dynamic_texture( scene_out_t* out, const scene_opts_t* opts ) {
+  send_tx_handle(out, 0, DYNAMIC_TX_KEY);
+  send_dynamic_texture(out, 0);
+
+  buff_t s = {0};
+  op(&s, OP_PATH_BEGIN);
+  op_rect(&s, opts->width, opts->height);
+  put_u32(&s, OP_PAINT_IMAGE);
+  put_f32(&s, 0);
+  put_f32(&s, 0);
+  put_f32(&s, opts->width);
+  put_f32(&s, opts->height);
+  put_f32(&s, 0);
+  put_u32(&s, 255);
+  put_u32(&s, 0);
+  op(&s, OP_FILL_PAINT);
+  op(&s, OP_FILL);
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+static void frame_dynamic_texture( scene_out_t* out, const scene_opts_t* opts, int frame ) {
+  send_dynamic_texture(out, frame);
+}
+
+//---------------------------------------------------------
+// a plot held in a ring buffer texture. Each frame only the few columns
+// of new samples are sent, with CMD_PUT_TX_SUB
+#define PLOT_TX_KEY         "bench_plot"
+#define PLOT_TX_WIDTH       1024
+#define PLOT_TX_HEIGHT      512
+#define PLOT_COLUMNS        4
+
+static void plot_columns( unsigned char* p, int x, int w, int frame ) {
+  for ( int y = 0; y < PLOT_TX_HEIGHT; y++ ) {
+    for ( int c = 0; c < w; c++ ) {
+      int  sample = (PLOT_TX_HEIGHT / 2) + (int)((x + c) * 7 + frame * 13) % 200 - 100;
+      bool on     = y >= sample - 2 && y <= sample + 2;
+      p[0] = on ? 64 : 8;
+      p[1] = on ? 255 : 16;
+      p[2] = on ? 128 : 24;
+      p[3] = 255;
+      p += 4;
+    }
+  }
+}
+
+static bool scene_scrolling_plot( scene_out_t* out, const scene_opts_t* opts ) {
+  send_tx_handle(out, 0, PLOT_TX_KEY);
+
+  static unsigned char pixels[PLOT_TX_WIDTH * PLOT_TX_HEIGHT * 4];
+  plot_columns(pixels, 0, PLOT_TX_WIDTH, 0);
+
+  buff_t   msg      = {0};
+  uint32_t key_size = strlen(PLOT_TX_KEY) + 1;
+  put_u32(&msg, key_size);
+  put_u32(&msg, sizeof(pixels));
+  put_u32(&msg, 4);
+  put_u32(&msg, PLOT_TX_WIDTH);
+  put_u32(&msg, PLOT_TX_HEIGHT);
+  put_u32(&msg, TX_FLAG_MIPMAPS);
+  put_bytes(&msg, PLOT_TX_KEY, key_size);
+  put_bytes(&msg, pixels, sizeof(pixels));
+  write_msg(out, CMD_PUT_TX_RAW, msg.p, msg.len);
+  buff_free(&msg);
+
+  buff_t s = {0};
+  op(&s, OP_PATH_BEGIN);
+  op_rect(&s, opts->width, opts->height);
+  put_u32(&s, OP_PAINT_IMAGE);
+  put_f32(&s, 0);
+  put_f32(&s, 0);
+  put_f32(&s, opts->width);
+  put_f32(&s, opts->height);
+  put_f32(&s, 0);
+  put_u32(&s, 255);
+  put_u32(&s, 0);
+  op(&s, OP_FILL_PAINT);
+  op(&s, OP_FILL);
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+// same layout as put_dynamic_texture_rect in cache.ex
+static void frame_scrolling_plot( scene_out_t* out, const scene_opts_t* opts, int frame ) {
+  static unsigned char pixels[PLOT_COLUMNS * PLOT_TX_HEIGHT * 4];
+  int x = (frame * PLOT_COLUMNS) % PLOT_TX_WIDTH;
+  plot_columns(pixels, x, PLOT_COLUMNS, frame);
+
+  buff_t   msg      = {0};
+  uint32_t key_size = strlen(PLOT_TX_KEY) + 1;
+  put_u32(&msg, key_size);
+  put_u32(&msg, sizeof(pixels));
+  put_u32(&msg, 4);
+  put_u32(&msg, x);
+  put_u32(&msg, 0);
+  put_u32(&msg, PLOT_COLUMNS);
+  put_u32(&msg, PLOT_TX_HEIGHT);
+  put_bytes(&msg, PLOT_TX_KEY, key_size);
+  put_bytes(&msg, pixels, sizeof(pixels));
+  write_msg(out, CMD_PUT_TX_SUB, msg.p, msg.len);
+  buff_free(&msg);
+}
+
+//---------------------------------------------------------
+// wide polylines and curves with every join and cap.
+// Stroke expansion, joins and stencil strokes
+static bool scene_thick_strokes( scene_out_t* out, const scene_opts_t* opts ) {
+  buff_t s = {0};
+  for ( int i = 0; i < 150; i++ ) {
+    // each polyline wanders around its own neighbourhood so the cost is
+    // in the joins and caps rather than in filling the whole screen
+    float x = rand_float(0, opts->width);
+    float y = rand_float(0, opts->height);
+
+    op(&s, OP_PATH_BEGIN);
+    op_xy(&s, OP_PATH_MOVE_TO, x, y);
+    for ( int p = 0; p < 12; p++ ) {
+      if ( p % 4 == 3 ) {
+        put_u32(&s, OP_PATH_BEZIER_TO);
+        for ( int c = 0; c < 3; c++ ) {
+          x += rand_float(-30, 30);
+          y += rand_float(-30, 30);
+          put_f32(&s, x);
+          put_f32(&s, y);
+        }
+      } else {
+        x += rand_float(-40, 40);
+        y += rand_float(-40, 40);
+        op_xy(&s, OP_PATH_LINE_TO, x, y);
+      }
+    }
+    op_f(&s, OP_STROKE_WIDTH, rand_float(6, 20));
+    op_u(&s, OP_LINE_JOIN, i % 3);
+    op_u(&s, OP_LINE_CAP, (i / 3) % 3);
+    op_f(&s, OP_MITER_LIMIT, 10);
+    op_random_color(&s, OP_STROKE_COLOR, 160);
+    op(&s, OP_STROKE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//---------------------------------------------------------
+// stroked arcs and filled sectors of many sizes. The segment generation
+// in render_script.c plus circle and ellipse fills
+static bool scene_arcs_sectors( scene_out_t* out, const scene_opts_t* opts ) {
+  buff_t s = {0};
+  for ( int i = 0; i < 2000; i++ ) {
+    float radius = rand_float(4, 60);
+    float start  = rand_float(0, 6.2831853f);
+    float finish = start + rand_float(0.2f, 6.2831853f);
+
+    op(&s, OP_PUSH_STATE);
+    op_xy(&s, OP_TX_TRANSLATE, rand_float(0, opts->width), rand_float(0, opts->height));
+    op(&s, OP_PATH_BEGIN);
+    switch ( i % 4 ) {
+      case 0:
+        op_sector(&s, OP_ARC, radius, start, finish);
+        op_f(&s, OP_STROKE_WIDTH, rand_float(1, 6));
+        op_random_color(&s, OP_STROKE_COLOR, 255);
+        op(&s, OP_STROKE);
+        break;
+      case 1:
+        op_sector(&s, OP_SECTOR, radius, start, finish);
+        op_random_color(&s, OP_FILL_COLOR, 200);
+        op(&s, OP_FILL);
+        break;
+      case 2:
+        op_f(&s, OP_CIRCLE, radius);
+        op_random_color(&s, OP_FILL_COLOR, 200);
+        op(&s, OP_FILL);
+        break;
+      default:
+        op_xy(&s, OP_ELLIPSE, radius, radius / 2);
+        op_random_color(&s, OP_FILL_COLOR, 200);
+        op(&s, OP_FILL);
+        break;
+    }
+    op(&s, OP_POP_STATE);
+  }
+  write_script(out, CONTENT_SCRIPT, &s);
+  buff_free(&s);
+  return true;
+}
+
+//=============================================================================
+
+typedef struct
+{
+  const char* name;
+  bool        (*build)(scene_out_t* out, const scene_opts_t* opts);
+  // optional, sends per frame messages before the root script
+  void        (*frame)(scene_out_t* out, const scene_opts_t* opts, int frame);
+} scene_t;
+
+static const scene_t scenes[] = {
+  {"rects_10k",       scene_rects_10k,       NULL},
+  {"nested_scripts",  scene_nested_scripts,  NULL},
+  {"text_paragraphs", scene_text_paragraphs, NULL},
+  {"text_prewarm",    scene_text_prewarm,    NULL},
+  {"text_zoom",       scene_text_zoom,       frame_text_zoom},
+  {"text_zoom_sdf",   scene_text_zoom_sdf,   frame_text_zoom},
+  {"text_shadow",     scene_text_shadow,     frame_text_shadow},
+  {"text_grad_shadow", scene_text_grad_shadow, frame_text_grad_shadow},
+  {"gradients",       scene_gradients,       NULL},
+  {"image_patterns",  scene_image_patterns,  NULL},
+  {"dynamic_texture", scene_dynamic_texture, frame_dynamic_texture},
+  {"scrolling_plot",  scene_scrolling_plot,  frame_scrolling_plot},
+  {"thick_strokes",   scene_thick_strokes,   NULL},
+  {"arcs_sectors",    scene_arcs_sectors,    NULL},
+};
+#define NUM_SCENES  (sizeof(scenes) / sizeof(scene_t))
+
+//---------------------------------------------------------
+static bool write_scene( const scene_t* p_scene, const char* dir,
+                         const scene_opts_t* opts, int frames ) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s.cap", dir, p_scene->name);
+
+  scene_out_t out;
+  out.time_ns = 0;
+  out.file    = fopen(path, "wb");
+  if ( !out.file ) {
+    fprintf(stderr, "could not open %s\n", path);
+    return false;
+  }
+
+  capture_header_t header;
+  memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+  header.version    = CAPTURE_VERSION;
+  header.byte_order = CAPTURE_BYTE_ORDER;
+  header.width      = opts->width;
+  header.height     = opts->height;
+  header.start_ns   = 0;
+  fwrite(&header, sizeof(capture_header_t), 1, out.file);
+
+  // every scene starts from the same random sequence, whatever ran before
+  seed = 0x5CE7E000;
+  bool ok = p_scene->build(&out, opts);
+
+  if ( ok ) {
+    uint32_t root = 0;
+    write_msg(&out, CMD_SET_ROOT, &root, sizeof(uint32_t));
+
+    buff_t s = {0};
+    for ( int frame = 0; frame < frames; frame++ ) {
+      if ( p_scene->frame ) p_scene->frame(&out, opts, frame);
+
+      // nudge the content around so each frame is a real redraw
+      s.len = 0;
+      op(&s, OP_PUSH_STATE);
+      op_xy(&s, OP_TX_TRANSLATE, (frame % 16) - 8, ((frame / 16) % 8) - 4);
+      op_u(&s, OP_RUN_SCRIPT, CONTENT_SCRIPT);
+      op(&s, OP_POP_STATE);
+      write_script(&out, root, &s);
+      write_frame(&out);
+      out.time_ns += FRAME_NS;
+    }
+    buff_free(&s);
+  }
+
+  fclose(out.file);
+  if ( !ok ) unlink(path);
+  return ok;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: scenic_driver_egl_scenes [-w width] [-h height] [-f frames] [-t font] dir [scene...]\n"
+          "       scenic_driver_egl_scenes -l\n");
+}
+
+int main( int argc, char** argv ) {
+  scene_opts_t opts;
+  int          frames = DEFAULT_FRAMES;
+  int          opt;
+
+  opts.width     = DEFAULT_WIDTH;
+  opts.height    = DEFAULT_HEIGHT;
+  opts.font_path = NULL;
+
+  while ( (opt = getopt(argc, argv, "w:h:f:t:l")) != -1 ) {
+    switch ( opt ) {
+      case 'w': opts.width = atoi(optarg); break;
+      case 'h': opts.height = atoi(optarg); break;
+      case 'f': frames = atoi(optarg); break;
+      case 't': opts.font_path = optarg; break;
+      case 'l':
+        for ( size_t i = 0; i < NUM_SCENES; i++ ) {
+          printf("%s\n", scenes[i].name);
+        }
+        return 0;
+      default: usage(); return 1;
+    }
+  }
+  if ( argc - optind < 1 ) {
+    usage();
+    return 1;
+  }
+  const char* dir = argv[optind++];
+
+  int failed = 0;
+  for ( size_t i = 0; i < NUM_SCENES; i++ ) {
+    // with no names given, write every scene
+    bool wanted = optind == argc;
+    for ( int a = optind; a < argc; a++ ) {
+      if ( strcmp(argv[a], scenes[i].name) == 0 ) wanted = true;
+    }
+    if ( wanted && !write_scene(&scenes[i], dir, &opts, frames) ) {
+      failed++;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -16,6 +16,11 @@ Functions to load textures onto the graphics card
 #include "nanovg/nanovg.h"
 #include "types.h"
 #include "comms.h"
+#include "decode.h"
+#include "atlas.h"
+#include "ktx.h"
+#include "tx.h"
+#include "xxhash.h"
 
 #include "uthash.h"
 
@@ -24,25 +29,260 @@ Functions to load textures onto the graphics card
 //=============================================================================
 // uthash setup
 
+struct tx_handle_s;
+
 //---------------------------------------------------------
-typedef struct
+// a texture on the card. Keys whose data is the same share one, so it is
+// refcounted and its memory is counted once
+typedef struct tx_image_s
+{
+  int               id;
+  atlas_slot_t*     p_slot;     // set for small images packed in an atlas. id is then the page
+  int               type;       // NVG_TEXTURE_* format the image was created with
+  int               flags;      // TX_FLAG_* it was put with
+  bool              mipmapped;  // has had its mipmaps made
+  uint32_t          bytes;      // estimated texture memory, counted against the budget
+  uint32_t          refs;       // keys pointing at it
+  uint64_t          hash;       // of the data it was made from, see content_hash
+  bool              hashed;     // in p_images_by_hash. Not once it was changed in place
+  UT_hash_handle    hh;
+} tx_image_t;
+
+//---------------------------------------------------------
+typedef struct tx_id_s
+{
+  const char*       key;
+  struct tx_handle_s* p_handle; // the handle scripts draw this key by, if it has one
+  tx_image_t*       p_image;
+  uint32_t          last_used;  // tx_frame the texture was last drawn in
+  struct tx_id_s*   p_older;    // LRU list, least recently used first
+  struct tx_id_s*   p_newer;
+  UT_hash_handle    hh;
+} tx_id_t;
+
+// every texture is on the LRU list. Drawing one moves it to the newest end
+// and end_tx_frame evicts from the oldest end while over the budget
+static tx_id_t*   p_lru_oldest = NULL;
+static tx_id_t*   p_lru_newest = NULL;
+static uint32_t   tx_frame = 0;
+static uint64_t   resident_bytes = 0;
+static uint32_t   evictions = 0;
+
+static void lru_unlink(tx_id_t* p_tx) {
+  if (p_tx->p_older) p_tx->p_older->p_newer = p_tx->p_newer;
+  else p_lru_oldest = p_tx->p_newer;
+  if (p_tx->p_newer) p_tx->p_newer->p_older = p_tx->p_older;
+  else p_lru_newest = p_tx->p_older;
+  p_tx->p_older = p_tx->p_newer = NULL;
+}
+
+static void lru_append(tx_id_t* p_tx) {
+  p_tx->p_older = p_lru_newest;
+  p_tx->p_newer = NULL;
+  if (p_lru_newest) p_lru_newest->p_newer = p_tx;
+  else p_lru_oldest = p_tx;
+  p_lru_newest = p_tx;
+  p_tx->last_used = tx_frame;
+}
+
+// memory a texture takes on the card, without mipmaps. mipmap_tx_handle
+// adds the third they take when they are made
+static uint32_t tx_bytes(int type, int width, int height) {
+  int bpp;
+  switch (type) {
+    case NVG_TEXTURE_RGBA:              bpp = 4; break;
+    case NVG_TEXTURE_RGB:               bpp = 3; break;
+    case NVG_TEXTURE_LUMINANCE_ALPHA:   bpp = 2; break;
+    default:                            bpp = 1; break;
+  }
+  return width * height * bpp;
+}
+
+//---------------------------------------------------------
+// images by the hash of the data they were made from. The same icon put
+// under several keys, or a placeholder put for many, is only uploaded once
+static tx_image_t*  p_images_by_hash = NULL;
+
+// what the data is is hashed along with it, so a file and raw pixels, or
+// the same pixels with other flags or another size, never match
+#define TX_SOURCE_BLOB      1
+#define TX_SOURCE_KTX       2
+#define TX_SOURCE_PIXELS    3
+
+static uint64_t content_hash(int source, int flags, int depth, int width, int height,
+                             const void* p_data, uint32_t size) {
+  uint32_t desc[5] = {source, flags, depth, width, height};
+  return xxh64(p_data, size, xxh64(desc, sizeof(desc), 0));
+}
+
+static tx_image_t* find_image(uint64_t hash) {
+  tx_image_t* found;
+  HASH_FIND(hh, p_images_by_hash, &hash, sizeof(uint64_t), found);
+  return found;
+}
+
+static tx_image_t* new_image(int id, atlas_slot_t* p_slot, int type, int flags,
+                             uint32_t bytes, uint64_t hash) {
+  tx_image_t* p_image = calloc(1, sizeof(tx_image_t));
+  p_image->id = id;
+  p_image->p_slot = p_slot;
+  p_image->type = type;
+  p_image->flags = flags;
+  p_image->bytes = bytes;
+  p_image->hash = hash;
+  // an image that failed to decode or upload is never shared, or every
+  // later put of the same data would be pointed at it instead of retried
+  if (id > 0) {
+    p_image->hashed = true;
+    HASH_ADD(hh, p_images_by_hash, hash, sizeof(uint64_t), p_image);
+  }
+  resident_bytes += bytes;
+  return p_image;
+}
+
+// an image is about to be changed in place, so it no longer holds the
+// data it was hashed from. Only done to images a single key points at
+static void unhash_image(tx_image_t* p_image) {
+  if (!p_image->hashed) return;
+  HASH_DEL(p_images_by_hash, p_image);
+  p_image->hashed = false;
+}
+
+//---------------------------------------------------------
+// drops a key's reference. The last one frees the image, or its place in
+// the atlas
+static void release_image(NVGcontext* p_ctx, tx_image_t* p_image) {
+  if (--p_image->refs > 0) return;
+  if (p_image->p_slot) atlas_remove(p_ctx, p_image->p_slot);
+  else if (p_image->id > 0) nvgDeleteImage(p_ctx, p_image->id);
+  unhash_image(p_image);
+  resident_bytes -= p_image->bytes;
+  free(p_image);
+}
+
+//---------------------------------------------------------
+// scripts refer to textures by small integer handles, which Elixir assigns
+// when it first compiles a key. A handle stays valid while the texture
+// behind it is loaded, evicted and loaded again, so drawing only indexes
+// the flat array instead of hashing the key.
+//
+// Once the key is freed from the cache and no stored script draws with
+// the handle, it is reported unused. Elixir stops giving it out, then
+// sends CMD_RELEASE_TX_ID, and the handle is dropped as soon as no script
+// uses it. Elixir reuses the number after it hears the handle is gone
+typedef struct tx_handle_s
 {
   const char*     key;
-  int             id;
+  tx_id_t*        p_tx;       // the loaded texture. NULL while there isn't one
+  uint32_t        handle;     // the last handle registered for the key
+  uint32_t        handles;    // handles that point at this key
+  bool            freed;      // deleted from the cache and not put since
   UT_hash_handle  hh;
-} tx_id_t;
+} tx_handle_t;
+
+typedef struct
+{
+  tx_handle_t*    p_handle;
+  uint32_t        refs;       // stored scripts that draw with the handle
+  bool            unused_sent;
+  bool            releasing;  // dropped when refs reach 0
+} tx_handle_slot_t;
+
+// handles are assigned counting up from 0, so a bigger one is a bad message
+#define TX_MAX_HANDLES    (1 << 20)
+
+static tx_handle_slot_t*  p_slots = NULL;     // indexed by handle
+static uint32_t           handles_size = 0;
+static tx_handle_t*       p_handles_by_key = NULL;
+
+static void link_handle(tx_id_t* p_tx) {
+  tx_handle_t* p_handle;
+  HASH_FIND_STR(p_handles_by_key, p_tx->key, p_handle);
+  p_tx->p_handle = p_handle;
+  if (p_handle) {
+    p_handle->p_tx = p_tx;
+    p_handle->freed = false;
+  }
+}
+
+static tx_handle_t* get_handle(uint32_t handle) {
+  return handle < handles_size ? p_slots[handle].p_handle : NULL;
+}
+
+// makes room in the table for the handle. Refs can arrive before the
+// handle is registered, from a script compiled in another task
+static bool grow_handles(uint32_t handle) {
+  if ( handle >= TX_MAX_HANDLES ) return false;
+  if ( handle < handles_size ) return true;
+  uint64_t size = handles_size ? handles_size : 64;
+  while ( size <= handle ) size *= 2;
+  tx_handle_slot_t* p = realloc(p_slots, size * sizeof(tx_handle_slot_t));
+  if ( !p ) return false;
+  p_slots = p;
+  memset(p_slots + handles_size, 0, (size - handles_size) * sizeof(tx_handle_slot_t));
+  handles_size = size;
+  return true;
+}
+
+// takes the handle out of its slot. The key's record goes with the last
+// handle pointing at it
+static void unlink_slot(tx_handle_slot_t* p_slot) {
+  tx_handle_t* p_handle = p_slot->p_handle;
+  p_slot->p_handle = NULL;
+  p_slot->unused_sent = false;
+  p_slot->releasing = false;
+  if ( !p_handle || --p_handle->handles ) return;
+  HASH_DEL(p_handles_by_key, p_handle);
+  if (p_handle->p_tx) p_handle->p_tx->p_handle = NULL;
+  free(p_handle);
+}
+
+// reports the handle once nothing needs it, or drops it if it is on its way out
+static void check_handle_unused(uint32_t handle) {
+  tx_handle_slot_t* p_slot = &p_slots[handle];
+  if ( !p_slot->p_handle || p_slot->refs ) return;
+  if ( p_slot->releasing ) {
+    unlink_slot(p_slot);
+    send_tx_handle_released(handle);
+  } else if ( p_slot->p_handle->freed && !p_slot->unused_sent ) {
+    p_slot->unused_sent = true;
+    send_tx_handle_unused(handle, p_slot->p_handle->key);
+  }
+}
+
+// a stored script draws with the handle
+void ref_tx_handle(uint32_t handle) {
+  if ( grow_handles(handle) ) p_slots[handle].refs++;
+}
+
+void unref_tx_handle(uint32_t handle) {
+  if ( handle >= handles_size || p_slots[handle].refs == 0 ) return;
+  if ( --p_slots[handle].refs == 0 ) check_handle_unused(handle);
+}
+
+//---------------------------------------------------------
+// atlas pages are sampled linearly and clamp at each image's padding
+static bool atlas_allowed(int flags) {
+  return (flags & (TX_FLAG_REPEAT_X | TX_FLAG_REPEAT_Y | TX_FLAG_NEAREST)) == 0;
+}
 
 //---------------------------------------------------------
-static tx_id_t* put_tx_id(tx_id_t* p_tx_ids, char* p_key, int key_size, int id, int* old_id) {
+// points the key at the image. Putting a key again replaces the texture,
+// so the one it used to point at loses a reference
+static tx_id_t* put_tx_id(NVGcontext* p_ctx, tx_id_t* p_tx_ids, char* p_key, int key_size,
+                          tx_image_t* p_image) {
   tx_id_t *found;
 
+  p_image->refs++;
+
   // check if the key is already assigned.
   HASH_FIND_STR(p_tx_ids, p_key, found);
   if (found) {
-    // pass out the old id.
-    *old_id = found->id;
-    // store the new id in the existing record
-    found->id = id;
+    // store the new image in the existing record
+    release_image(p_ctx, found->p_image);
+    found->p_image = p_image;
+    lru_unlink(found);
+    lru_append(found);
     // return
     return p_tx_ids;
   }
@@ -51,11 +291,13 @@ static tx_id_t* put_tx_id(tx_id_t* p_tx_ids, char* p_key, int key_size, int id,
   unsigned int size = sizeof(tx_id_t) + key_size;
   tx_id_t* p_tx_id = malloc(size);
   memset(p_tx_id, 0, size );
-  p_tx_id->id = id;
+  p_tx_id->p_image = p_image;
   p_tx_id->key = (void*)p_tx_id + sizeof(tx_id_t);
   memcpy((char*)p_tx_id->key, p_key, key_size);
 
   HASH_ADD_KEYPTR( hh, p_tx_ids, p_tx_id->key, strlen(p_tx_id->key), p_tx_id );
+  link_handle(p_tx_id);
+  lru_append(p_tx_id);
 
   return p_tx_ids;
 }
@@ -65,50 +307,362 @@ int get_tx_id(void* p_tx_ids, char* p_key) {
   if (p_tx_ids == NULL) {return -1;}
   tx_id_t* found;
   HASH_FIND_STR( (tx_id_t*)p_tx_ids, p_key, found );
-  if (found) return found->id;
+  if (found) return found->p_image->id;
   return -1;
 }
 
 //---------------------------------------------------------
-// removes from the hash by id, and frees the pointer
-static tx_id_t* delete_tx_id(tx_id_t* p_tx_ids, char* p_key) {
+// looks up a handle for drawing. Marks the texture as used this frame and
+// passes out the part of the image it is in. If it isn't loaded, passes
+// out the key to report the miss with, or NULL for an unknown handle
+int use_tx_handle(uint32_t handle, tx_rect_t* p_rect, const char** pp_key) {
+  tx_handle_t* p_handle = get_handle(handle);
+  *pp_key = p_handle ? p_handle->key : NULL;
+  if (!p_handle || !p_handle->p_tx) return -1;
+
+  tx_id_t* found = p_handle->p_tx;
+  if (found->last_used != tx_frame) {
+    lru_unlink(found);
+    lru_append(found);
+  }
+  tx_image_t* p_image = found->p_image;
+  if (p_image->p_slot) {
+    p_rect->x = p_image->p_slot->x;
+    p_rect->y = p_image->p_slot->y;
+    p_rect->w = p_image->p_slot->w;
+    p_rect->h = p_image->p_slot->h;
+  } else {
+    memset(p_rect, 0, sizeof(tx_rect_t));
+  }
+  return p_image->id;
+}
+
+//---------------------------------------------------------
+// moves an image out of its atlas page into a texture of its own, which
+// can have mipmaps. Returns false if the texture couldn't be made
+static bool unpack_image(NVGcontext* p_ctx, tx_image_t* p_image) {
+  atlas_slot_t* p_slot = p_image->p_slot;
+  unsigned char* p_rgba = malloc((size_t)p_slot->w * p_slot->h * 4);
+  if (!p_rgba) return false;
+  atlas_read(p_slot, p_rgba);
+  int id = nvgCreateImageRGBA(p_ctx, p_slot->w, p_slot->h,
+    p_image->flags & ~TX_FLAG_MIPMAPS, p_rgba);
+  free(p_rgba);
+  if (id == 0) return false;
+
+  uint32_t bytes = tx_bytes(NVG_TEXTURE_RGBA, p_slot->w, p_slot->h);
+  resident_bytes += bytes;
+  resident_bytes -= p_image->bytes;
+  atlas_remove(p_ctx, p_slot);
+  p_image->id = id;
+  p_image->p_slot = NULL;
+  p_image->bytes = bytes;
+  return true;
+}
+
+//---------------------------------------------------------
+// called when a handle is drawn smaller than its image. Textures put with
+// TX_FLAG_MIPMAPS get them now, the first time they are needed, or again
+// if the texture was updated since. Until then they cost no memory or
+// upload time, which matters for textures that are updated every frame.
+// An image in the atlas is moved to its own texture first, so *p_id and
+// the rect change to it
+void mipmap_tx_handle(NVGcontext* p_ctx, uint32_t handle, int* p_id, tx_rect_t* p_rect) {
+  tx_handle_t* p_handle = get_handle(handle);
+  if (!p_handle || !p_handle->p_tx) return;
+
+  tx_image_t* p_image = p_handle->p_tx->p_image;
+  if (!(p_image->flags & TX_FLAG_MIPMAPS)) return;
+
+  if (p_image->p_slot) {
+    if (!unpack_image(p_ctx, p_image)) return;
+    *p_id = p_image->id;
+    memset(p_rect, 0, sizeof(tx_rect_t));
+  }
+  if (nvgImageGenerateMipmaps(p_ctx, p_image->id) && !p_image->mipmapped) {
+    p_image->mipmapped = true;
+    // compressed textures came with theirs, already counted
+    if (p_image->type != NVG_TEXTURE_COMPRESSED) {
+      resident_bytes += p_image->bytes / 3;
+      p_image->bytes += p_image->bytes / 3;
+    }
+  }
+}
+
+//---------------------------------------------------------
+// removes from the hash by id, releases its image and frees the pointer
+static tx_id_t* delete_tx_id(NVGcontext* p_ctx, tx_id_t* p_tx_ids, char* p_key) {
   if (p_tx_ids == NULL) {return NULL;}
 
   tx_id_t* found;
   HASH_FIND_STR( p_tx_ids, p_key, found );
   if (found != NULL) {
     HASH_DEL( p_tx_ids, found );
+    if (found->p_handle) found->p_handle->p_tx = NULL;
+    lru_unlink(found);
+    release_image(p_ctx, found->p_image);
     free( found );
   }
   return p_tx_ids;
 }
 
-//=============================================================================
+//---------------------------------------------------------
+// called after each frame is drawn. Evicts the least recently drawn
+// textures until the budget is met, never one drawn in this frame. An
+// evicted texture that is drawn again is a miss and gets sent again.
+// Evicting a key whose image other keys share frees nothing yet
+void end_tx_frame( driver_data_t* p_data ) {
+  tx_id_t* p_tx = p_lru_oldest;
+  while ( p_data->tx_budget && resident_bytes > p_data->tx_budget &&
+          p_tx && p_tx->last_used != tx_frame ) {
+    tx_id_t* p_next = p_tx->p_newer;
+    p_data->p_tx_ids = delete_tx_id(p_data->p_ctx, p_data->p_tx_ids, (char*)p_tx->key);
+    evictions++;
+    p_tx = p_next;
+  }
+  tx_frame++;
+}
 
 //---------------------------------------------------------
-void receive_put_tx_blob( int* p_msg_length, driver_data_t* p_data ) {
+// blobs that are still being decoded, by key. Only the newest put of a key
+// is uploaded when it finishes, and a free or raw put cancels it
+typedef struct
+{
+  const char*     key;
+  uint32_t        seq;
+  UT_hash_handle  hh;
+} tx_pending_t;
+
+static tx_pending_t*      p_pending = NULL;
+static uint32_t           next_seq = 0;
+static tx_stats_t         tx_stats = {0};
+
+static tx_pending_t* find_pending(const char* p_key) {
+  tx_pending_t* found;
+  HASH_FIND_STR(p_pending, p_key, found);
+  return found;
+}
+
+static void cancel_pending(char* p_key) {
+  tx_pending_t* found = find_pending(p_key);
+  if (found) {
+    HASH_DEL(p_pending, found);
+    free(found);
+  }
+}
+
+static void set_pending(char* p_key, uint32_t seq) {
+  tx_pending_t* found = find_pending(p_key);
+  if (found) {
+    found->seq = seq;
+    return;
+  }
+
+  int key_size = strlen(p_key) + 1;
+  tx_pending_t* p_tx = malloc(sizeof(tx_pending_t) + key_size);
+  p_tx->seq = seq;
+  p_tx->key = (void*)p_tx + sizeof(tx_pending_t);
+  memcpy((char*)p_tx->key, p_key, key_size);
+  HASH_ADD_KEYPTR(hh, p_pending, p_tx->key, key_size - 1, p_tx);
+}
+
+//---------------------------------------------------------
+bool is_tx_pending(const char* p_key) {
+  return find_pending(p_key) != NULL;
+}
+
+//---------------------------------------------------------
+void get_tx_stats(tx_stats_t* p_stats) {
+  *p_stats = tx_stats;
+  p_stats->resident_bytes = resident_bytes;
+  p_stats->evictions = evictions;
+
+  // every key past the first that shares an image would have had its own
+  p_stats->dedup_bytes = 0;
+  tx_image_t* p_image;
+  for ( p_image = p_images_by_hash; p_image; p_image = p_image->hh.next ) {
+    p_stats->dedup_bytes += (uint64_t)p_image->bytes * (p_image->refs - 1);
+  }
+}
+
+//---------------------------------------------------------
+// points the key at an image made from the same data, if there is one
+static bool put_duplicate(driver_data_t* p_data, char* p_key, int key_size, uint64_t hash) {
+  tx_image_t* p_image = find_image(hash);
+  if (!p_image) return false;
+
+  cancel_pending(p_key);
+  p_data->p_tx_ids = put_tx_id(p_data->p_ctx, p_data->p_tx_ids, p_key, key_size, p_image);
+  tx_stats.dedup_hits++;
+  return true;
+}
+
+//---------------------------------------------------------
+// uploads the blobs that finished decoding since the last call and the atlas
+// rows changed since then. Runs on the render thread between frames.
+// Returns true if a texture changed
+bool upload_decoded_tx( driver_data_t* p_data, bool wait ) {
   NVGcontext* p_ctx = p_data->p_ctx;
+  bool changed = false;
+
+  decode_job_t* p_job = decode_take_done(wait);
+  while (p_job) {
+    decode_job_t* p_next = p_job->p_next;
+
+    tx_stats.decoded++;
+    tx_stats.decode_total_ns += p_job->decode_ns;
+    if (p_job->decode_ns > tx_stats.decode_max_ns) tx_stats.decode_max_ns = p_job->decode_ns;
+
+    // skip jobs that were freed or put again while decoding
+    tx_pending_t* p_tx = find_pending(p_job->p_key);
+    if (p_tx && p_tx->seq == p_job->seq) {
+      cancel_pending(p_job->p_key);
+
+      // the same file put under another key may have finished first
+      if ( !put_duplicate(p_data, p_job->p_key, strlen(p_job->p_key) + 1, p_job->hash) ) {
+        // small images share an atlas page, the rest get a texture each
+        int id = 0;
+        uint32_t bytes = 0;
+        atlas_slot_t* p_slot = NULL;
+        if (p_job->p_pixels) {
+          if (atlas_allowed(p_job->flags)) {
+            p_slot = atlas_add(p_ctx, p_job->width, p_job->height, p_job->p_pixels);
+          }
+          if (p_slot) {
+            id = atlas_image(p_slot);
+            bytes = atlas_slot_bytes(p_slot);
+          } else {
+            id = nvgCreateImageRGBA(p_ctx, p_job->width, p_job->height,
+              p_job->flags & ~TX_FLAG_MIPMAPS, p_job->p_pixels);
+            bytes = tx_bytes(NVG_TEXTURE_RGBA, p_job->width, p_job->height);
+          }
+        }
+
+        tx_image_t* p_image = new_image(id, p_slot, NVG_TEXTURE_RGBA, p_job->flags,
+                                        bytes, p_job->hash);
+        p_data->p_tx_ids = put_tx_id( p_ctx, p_data->p_tx_ids, p_job->p_key,
+          strlen(p_job->p_key) + 1, p_image );
+      }
+      changed = true;
+    }
 
-  // read in the data from the stream
+    decode_free_job(p_job);
+    p_job = p_next;
+  }
+
+  // atlas pages changed by the uploads above or by raw puts
+  changed = atlas_flush(p_ctx) || changed;
+
+  return changed;
+}
+
+//---------------------------------------------------------
+// decodes a file on a worker thread. Takes ownership of the key and file.
+// upload_decoded_tx creates the texture once it is done. Until then scripts
+// see the old texture under this key, or skip it if there isn't one
+static void submit_decode( char* p_key, void* p_file, uint32_t file_size, uint32_t flags,
+                           uint64_t hash ) {
+  decode_job_t* p_job = calloc(1, sizeof(decode_job_t));
+  p_job->p_key     = p_key;
+  p_job->seq       = ++next_seq;
+  p_job->p_file    = p_file;
+  p_job->file_size = file_size;
+  p_job->flags     = flags;
+  p_job->hash      = hash;
+  set_pending(p_key, p_job->seq);
+  decode_submit(p_job);
+}
+
+//=============================================================================
+
+//---------------------------------------------------------
+typedef struct __attribute__((__packed__))
+{
   GLuint key_size;
   GLuint file_size;
-  read_bytes_down( &key_size, sizeof(GLuint), p_msg_length);
-  read_bytes_down( &file_size, sizeof(GLuint), p_msg_length);
+  GLuint flags;
+} tx_blob_t;
+
+void receive_put_tx_blob( int* p_msg_length, driver_data_t* p_data ) {
+  // read in the data from the stream
+  tx_blob_t header;
+  read_bytes_down( &header, sizeof(tx_blob_t), p_msg_length);
+  GLuint key_size = header.key_size;
+  GLuint file_size = header.file_size;
 
   // Allocate and read the key. Need to free from now on
   char* p_key = malloc(key_size);
   read_bytes_down( p_key, key_size, p_msg_length);
+  texture_miss_answered(p_key);
 
   // Allocate and read the main data. Need to free from now on
   void* p_tx_file = malloc(file_size);
   read_bytes_down( p_tx_file, file_size, p_msg_length);
 
-  // load the texture
-  int id = nvgCreateImageMem(p_ctx, NVG_IMAGE_GENERATE_MIPMAPS, p_tx_file, file_size);
+  // a file that is already loaded under another key isn't decoded again
+  int flags = header.flags & TX_FLAGS;
+  uint64_t hash = content_hash(TX_SOURCE_BLOB, flags, 0, 0, 0, p_tx_file, file_size);
+  if ( put_duplicate(p_data, p_key, key_size, hash) ) {
+    free(p_key);
+    free(p_tx_file);
+    return;
+  }
+
+  submit_decode(p_key, p_tx_file, file_size, flags, hash);
+}
+
+//---------------------------------------------------------
+// KTX files with ETC1/ETC2 blocks. They are uploaded as they are if the
+// GPU takes the format, which needs no decode and a quarter to an eighth
+// of the memory of RGBA. Otherwise they are decoded like any other blob
+void receive_put_tx_ktx( int* p_msg_length, driver_data_t* p_data ) {
+  NVGcontext* p_ctx = p_data->p_ctx;
+
+  tx_blob_t header;
+  read_bytes_down( &header, sizeof(tx_blob_t), p_msg_length);
+  GLuint key_size = header.key_size;
+  GLuint file_size = header.file_size;
+  int flags = header.flags & TX_FLAGS;
+
+  char* p_key = malloc(key_size);
+  read_bytes_down( p_key, key_size, p_msg_length);
+  texture_miss_answered(p_key);
+
+  void* p_tx_file = malloc(file_size);
+  read_bytes_down( p_tx_file, file_size, p_msg_length);
+
+  uint64_t hash = content_hash(TX_SOURCE_KTX, flags, 0, 0, 0, p_tx_file, file_size);
+  if ( put_duplicate(p_data, p_key, key_size, hash) ) {
+    free(p_key);
+    free(p_tx_file);
+    return;
+  }
+
+  ktx_t ktx;
+  int id = 0;
+  if ( ktx_parse(p_tx_file, file_size, &ktx) ) {
+    // the mipmaps are the ones in the file, if it has them all
+    id = nvgCreateImageCompressed(p_ctx, ktx.format, ktx.width, ktx.height,
+      ktx.levels, ktx.p_level, ktx.level_size, flags & ~TX_FLAG_MIPMAPS);
+
+    // ETC1 blocks are valid ETC2 blocks, for GPUs that only list ETC2
+    if ( id == 0 && ktx.format == KTX_ETC1_RGB8 ) {
+      id = nvgCreateImageCompressed(p_ctx, KTX_ETC2_RGB8, ktx.width, ktx.height,
+        ktx.levels, ktx.p_level, ktx.level_size, flags & ~TX_FLAG_MIPMAPS);
+    }
+  }
+
+  if ( id == 0 ) {
+    submit_decode(p_key, p_tx_file, file_size, flags, hash);
+    return;
+  }
+
+  uint32_t bytes = 0;
+  for ( int i = 0; i < ktx.levels; i++ ) bytes += ktx.level_size[i];
 
-  // store the key/id pair
-  int old_id;
-  p_data->p_tx_ids = put_tx_id( p_data->p_tx_ids, p_key, key_size, id, &old_id );
+  cancel_pending(p_key);
+  tx_image_t* p_image = new_image(id, NULL, NVG_TEXTURE_COMPRESSED, flags, bytes, hash);
+  p_data->p_tx_ids = put_tx_id(p_ctx, p_data->p_tx_ids, p_key, key_size, p_image);
 
   free(p_key);
   free(p_tx_file);
@@ -122,6 +676,7 @@ typedef struct __attribute__((__packed__))
   GLuint depth;
   GLuint width;
   GLuint height;
+  GLuint flags;
 } tx_pixels_t;
 
 void receive_put_tx_pixels(int* p_msg_length, driver_data_t* p_data)
@@ -131,7 +686,6 @@ void receive_put_tx_pixels(int* p_msg_length, driver_data_t* p_data)
   // read in the data from the stream
   tx_pixels_t header;
   read_bytes_down(&header, sizeof(tx_pixels_t), p_msg_length);
-  GLuint pixel_count = header.width * header.height;
 
   // Allocate and read the key. Need to free from now on
   char* p_key = malloc(header.key_size);
@@ -141,63 +695,228 @@ void receive_put_tx_pixels(int* p_msg_length, driver_data_t* p_data)
   unsigned char* p_tx_pixels = malloc(header.pixel_size);
   read_bytes_down(p_tx_pixels, header.pixel_size, p_msg_length);
 
-  // expand the texture as appropriate depending on the depth
-  GLuint src_i;
-  GLuint dst_i;
-  unsigned char* p_tx_source = p_tx_pixels;
+  // the pixels must be exactly the image, or uploading it reads past them.
+  // In 64 bits so huge sizes can't wrap. A bad put is dropped and the
+  // texture asked for again, but not before the miss is due a retry
+  if ( header.depth < 1 || header.depth > 4 ||
+       header.pixel_size != (uint64_t)header.width * header.height * header.depth ) {
+    send_dynamic_texture_miss(p_key);
+    free(p_key);
+    free(p_tx_pixels);
+    return;
+  }
+  texture_miss_answered(p_key);
+
+  // the pixels are uploaded in the format they arrive in. Gray and
+  // gray/alpha textures take a quarter or half the memory of RGBA
+  int type;
   switch (header.depth)
   {
-    case 4: // already good
-      break;
-    case 3:
-      p_tx_pixels = malloc(pixel_count * 4);
-      for( unsigned int i = 0; i < pixel_count; i++ ) {
-        dst_i = i * 4;
-        src_i = i * 3;
-        p_tx_pixels[dst_i] = p_tx_source[src_i];
-        p_tx_pixels[dst_i + 1] = p_tx_source[src_i + 1];
-        p_tx_pixels[dst_i + 2] = p_tx_source[src_i + 2];
-        p_tx_pixels[dst_i + 3] = 0xff;
-      }
-      free(p_tx_source);
-      break;
-    case 2:
-      p_tx_pixels = malloc(pixel_count * 4);
-      for( unsigned int i = 0; i < pixel_count; i++ ) {
-        dst_i = i * 4;
-        src_i = i * 2;
-        p_tx_pixels[dst_i] = p_tx_source[src_i];
-        p_tx_pixels[dst_i + 1] = p_tx_source[src_i];
-        p_tx_pixels[dst_i + 2] = p_tx_source[src_i];
-        p_tx_pixels[dst_i + 3] = p_tx_source[src_i + 1];
-      }
-      free(p_tx_source);
-      break;
-    case 1:
-      p_tx_pixels = malloc(pixel_count * 4);
-      for( unsigned int i = 0; i < pixel_count; i++ ) {
-        dst_i = i * 4;
-        p_tx_pixels[dst_i] = p_tx_source[i];
-        p_tx_pixels[dst_i + 1] = p_tx_source[i];
-        p_tx_pixels[dst_i + 2] = p_tx_source[i];
-        p_tx_pixels[dst_i + 3] = 0xff;
-      }
-      free(p_tx_source);
-      break;
+    case 1:   type = NVG_TEXTURE_LUMINANCE;         break;
+    case 2:   type = NVG_TEXTURE_LUMINANCE_ALPHA;   break;
+    case 3:   type = NVG_TEXTURE_RGB;               break;
+    default:  type = NVG_TEXTURE_RGBA;              break;
+  }
+
+  // this put wins over a blob for the same key that is still decoding
+  cancel_pending(p_key);
+
+  // raw puts are how dynamic textures (camera frames, plots) are refreshed.
+  // If the key already has a texture of the same size and format, update
+  // it in place instead of creating a new one every frame. Not if other
+  // keys share it, they keep what they were put with
+  tx_id_t* found;
+  HASH_FIND_STR((tx_id_t*)p_data->p_tx_ids, p_key, found);
+  int flags = header.flags & TX_FLAGS;
+  tx_image_t* p_image = found ? found->p_image : NULL;
+  if ( p_image && (p_image->flags != flags || p_image->refs > 1) ) p_image = NULL;
+  if ( p_image && p_image->p_slot && type == NVG_TEXTURE_RGBA &&
+       (GLuint)p_image->p_slot->w == header.width &&
+       (GLuint)p_image->p_slot->h == header.height ) {
+    unhash_image(p_image);
+    atlas_update(p_image->p_slot, p_tx_pixels);
+    free(p_key);
+    free(p_tx_pixels);
+    return;
+  }
+  if ( p_image && !p_image->p_slot && p_image->type == type ) {
+    int width, height;
+    nvgImageSize(p_ctx, p_image->id, &width, &height);
+    if ( (GLuint)width == header.width && (GLuint)height == header.height ) {
+      unhash_image(p_image);
+      nvgUpdateImage(p_ctx, p_image->id, p_tx_pixels);
+      free(p_key);
+      free(p_tx_pixels);
+      return;
+    }
   }
 
-  // load the texture
-  int id = nvgCreateImageRGBA(p_ctx, header.width, header.height,
-    NVG_IMAGE_GENERATE_MIPMAPS, p_tx_pixels);
+  // the same pixels may already be loaded under another key
+  uint64_t hash = content_hash(TX_SOURCE_PIXELS, flags, header.depth,
+    header.width, header.height, p_tx_pixels, header.pixel_size);
+  if ( put_duplicate(p_data, p_key, header.key_size, hash) ) {
+    free(p_key);
+    free(p_tx_pixels);
+    return;
+  }
+
+  // small RGBA images go in the atlas, which only holds RGBA. Mipmaps
+  // are left until the texture is drawn minified
+  int id;
+  uint32_t bytes;
+  atlas_slot_t* p_slot = NULL;
+  if ( type == NVG_TEXTURE_RGBA && atlas_allowed(flags) ) {
+    p_slot = atlas_add(p_ctx, header.width, header.height, p_tx_pixels);
+  }
+  if ( p_slot ) {
+    id = atlas_image(p_slot);
+    bytes = atlas_slot_bytes(p_slot);
+  } else {
+    id = nvgCreateImageFormat(p_ctx, type, header.width, header.height,
+      flags & ~TX_FLAG_MIPMAPS, p_tx_pixels);
+    bytes = tx_bytes(type, header.width, header.height);
+  }
+
+  p_image = new_image(id, p_slot, type, flags, bytes, hash);
+  p_data->p_tx_ids = put_tx_id(p_ctx, p_data->p_tx_ids, p_key, header.key_size, p_image);
+
+  free(p_key);
+  free(p_tx_pixels);
+}
+
+//---------------------------------------------------------
+typedef struct __attribute__((__packed__))
+{
+  GLuint key_size;
+  GLuint pixel_size;
+  GLuint depth;
+  GLuint x;
+  GLuint y;
+  GLuint width;
+  GLuint height;
+} tx_sub_t;
+
+// replaces part of a texture that was put raw, like the few columns a
+// scrolling plot changes. The pixels hold just that rect. If the texture
+// isn't there in that size and format any more, or is shared with other
+// keys, it is reported as a miss so the whole of it is sent again
+void receive_put_tx_sub(int* p_msg_length, driver_data_t* p_data)
+{
+  NVGcontext* p_ctx = p_data->p_ctx;
+
+  tx_sub_t header;
+  read_bytes_down(&header, sizeof(tx_sub_t), p_msg_length);
 
-  // store the key/id pair
-  int old_id;
-  p_data->p_tx_ids = put_tx_id(p_data->p_tx_ids, p_key, header.key_size, id, &old_id);
+  char* p_key = malloc(header.key_size);
+  read_bytes_down(p_key, header.key_size, p_msg_length);
+
+  unsigned char* p_tx_pixels = malloc(header.pixel_size);
+  read_bytes_down(p_tx_pixels, header.pixel_size, p_msg_length);
+
+  int type;
+  switch (header.depth)
+  {
+    case 1:   type = NVG_TEXTURE_LUMINANCE;         break;
+    case 2:   type = NVG_TEXTURE_LUMINANCE_ALPHA;   break;
+    case 3:   type = NVG_TEXTURE_RGB;               break;
+    default:  type = NVG_TEXTURE_RGBA;              break;
+  }
+
+  bool updated = false;
+  tx_id_t* found;
+  HASH_FIND_STR((tx_id_t*)p_data->p_tx_ids, p_key, found);
+  tx_image_t* p_image = found ? found->p_image : NULL;
+  // in 64 bits and without adding, so huge values can't wrap past the checks
+  if ( p_image && p_image->type == type && p_image->refs == 1 && !find_pending(p_key) &&
+       header.depth >= 1 && header.depth <= 4 &&
+       header.pixel_size == (uint64_t)header.width * header.height * header.depth ) {
+    int w, h;
+    if ( p_image->p_slot ) {
+      w = p_image->p_slot->w;
+      h = p_image->p_slot->h;
+    } else {
+      nvgImageSize(p_ctx, p_image->id, &w, &h);
+    }
+    if ( header.x <= (GLuint)w && header.width <= (GLuint)w - header.x &&
+         header.y <= (GLuint)h && header.height <= (GLuint)h - header.y ) {
+      if ( p_image->p_slot ) {
+        atlas_update_rect(p_image->p_slot, header.x, header.y,
+                          header.width, header.height, p_tx_pixels);
+        updated = true;
+      } else {
+        updated = nvgUpdateImageRect(p_ctx, p_image->id, header.x, header.y,
+                                     header.width, header.height, p_tx_pixels);
+      }
+    }
+    if ( updated ) unhash_image(p_image);
+  }
+  if ( !updated ) send_dynamic_texture_miss(p_key);
 
   free(p_key);
   free(p_tx_pixels);
 }
 
+//---------------------------------------------------------
+typedef struct __attribute__((__packed__))
+{
+  GLuint handle;
+  GLuint key_size;
+} tx_new_id_t;
+
+// registers the handle scripts will use for a key
+void receive_new_tx_id( int* p_msg_length, driver_data_t* p_data ) {
+  tx_new_id_t header;
+  read_bytes_down(&header, sizeof(tx_new_id_t), p_msg_length);
+
+  char* p_key = malloc(header.key_size);
+  read_bytes_down(p_key, header.key_size, p_msg_length);
+
+  if ( !grow_handles(header.handle) ) {
+    free(p_key);
+    return;
+  }
+
+  // a key has one record, however many handles point at it. It can have
+  // two while an old handle waits for the scripts still using it to go
+  tx_handle_t* p_handle;
+  HASH_FIND_STR(p_handles_by_key, p_key, p_handle);
+  if ( !p_handle ) {
+    int key_size = strlen(p_key) + 1;
+    p_handle = malloc(sizeof(tx_handle_t) + key_size);
+    memset(p_handle, 0, sizeof(tx_handle_t));
+    p_handle->key = (void*)p_handle + sizeof(tx_handle_t);
+    memcpy((char*)p_handle->key, p_key, key_size);
+    HASH_ADD_KEYPTR(hh, p_handles_by_key, p_handle->key, key_size - 1, p_handle);
+
+    tx_id_t* found;
+    HASH_FIND_STR((tx_id_t*)p_data->p_tx_ids, p_key, found);
+    p_handle->p_tx = found;
+    if ( found ) found->p_handle = p_handle;
+  }
+
+  tx_handle_slot_t* p_slot = &p_slots[header.handle];
+  if ( p_slot->p_handle != p_handle ) {
+    p_handle->handles++;
+    unlink_slot(p_slot);
+    p_slot->p_handle = p_handle;
+  }
+  p_handle->handle = header.handle;
+
+  free(p_key);
+}
+
+//---------------------------------------------------------
+// Elixir has stopped giving the handle out. It goes when the last script
+// drawing with it does
+void receive_release_tx_id( int* p_msg_length, driver_data_t* p_data ) {
+  GLuint handle;
+  read_bytes_down( &handle, sizeof(GLuint), p_msg_length);
+
+  if ( !get_handle(handle) ) return;
+  p_slots[handle].releasing = true;
+  check_handle_unused(handle);
+}
+
 //---------------------------------------------------------
 void receive_free_tx_id( int* p_msg_length, driver_data_t* p_data ) {
   NVGcontext* p_ctx = p_data->p_ctx;
@@ -213,10 +932,20 @@ void receive_free_tx_id( int* p_msg_length, driver_data_t* p_data ) {
 // sprintf(buff, "TX delete key: %s", p_key);
 // send_puts(buff);
 
-  int id = get_tx_id(p_data->p_tx_ids, p_key);
-  if (id >= 0) {
-    p_data->p_tx_ids = delete_tx_id(p_data->p_tx_ids, p_key);
-    nvgDeleteImage(p_ctx, id);
+  cancel_pending(p_key);
+
+  tx_id_t* found;
+  HASH_FIND_STR((tx_id_t*)p_data->p_tx_ids, p_key, found);
+  if (found) {
+    p_data->p_tx_ids = delete_tx_id(p_ctx, p_data->p_tx_ids, p_key);
+  }
+
+  // its handle can go once the scripts drawing with it are gone
+  tx_handle_t* p_handle;
+  HASH_FIND_STR(p_handles_by_key, p_key, p_handle);
+  if (p_handle) {
+    p_handle->freed = true;
+    if (p_slots[p_handle->handle].p_handle == p_handle) check_handle_unused(p_handle->handle);
   }
 
   free(p_key);
@@ -7,8 +7,51 @@ Functions to load textures onto the graphics card
 */
 
 
+#include <stdint.h>
+
+// flags of a texture, sent with each put. They are the same bits as the
+// nanovg image flags they turn into
+#define TX_FLAG_MIPMAPS       0x01    // may get mipmaps, made when first drawn minified
+#define TX_FLAG_REPEAT_X      0x02
+#define TX_FLAG_REPEAT_Y      0x04
+#define TX_FLAG_NEAREST       0x20
+#define TX_FLAGS              (TX_FLAG_MIPMAPS | TX_FLAG_REPEAT_X | TX_FLAG_REPEAT_Y | TX_FLAG_NEAREST)
+
+typedef struct
+{
+  uint32_t  decoded;          // blobs decoded so far
+  uint64_t  decode_total_ns;  // decode time summed over all of them
+  uint64_t  decode_max_ns;    // the slowest single decode
+  uint64_t  resident_bytes;   // estimated memory of the loaded textures
+  uint32_t  evictions;        // textures dropped to stay in the budget
+  uint32_t  dedup_hits;       // puts whose data was already loaded under another key
+  uint64_t  dedup_bytes;      // memory saved by keys sharing a texture
+} tx_stats_t;
+
+// the part of its image a texture is drawn from. All zero when that is
+// the whole image, otherwise the texture is packed in an atlas page
+typedef struct
+{
+  int x;
+  int y;
+  int w;
+  int h;
+} tx_rect_t;
+
 int get_tx_id(void* p_tx_ids, char* p_key);
+int use_tx_handle(uint32_t handle, tx_rect_t* p_rect, const char** pp_key);
+void mipmap_tx_handle(NVGcontext* p_ctx, uint32_t handle, int* p_id, tx_rect_t* p_rect);
+void ref_tx_handle(uint32_t handle);
+void unref_tx_handle(uint32_t handle);
+bool is_tx_pending(const char* p_key);
+bool upload_decoded_tx( driver_data_t* p_data, bool wait );
+void end_tx_frame( driver_data_t* p_data );
+void get_tx_stats(tx_stats_t* p_stats);
 
 void receive_put_tx_blob( int* p_msg_length, driver_data_t* window );
 void receive_put_tx_pixels(int* p_msg_length, driver_data_t* window);
+void receive_put_tx_ktx( int* p_msg_length, driver_data_t* window );
+void receive_put_tx_sub( int* p_msg_length, driver_data_t* window );
+void receive_new_tx_id( int* p_msg_length, driver_data_t* window );
 void receive_free_tx_id( int* p_msg_length, driver_data_t* window );
+void receive_release_tx_id( int* p_msg_length, driver_data_t* window );
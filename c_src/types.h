@@ -35,6 +35,7 @@ typedef struct
   float       last_x;
   float       last_y;
   void**      p_scripts;
+  int*        p_script_lengths; // bytes in each stored script
   int         root_script;
   int         num_scripts;
   void*       p_tx_ids;
@@ -42,6 +43,8 @@ typedef struct
   NVGcontext* p_ctx;
   int         screen_width;
   int         screen_height;
+  NVGcolor    clear_color;
+  uint64_t    tx_budget;      // texture memory limit in bytes. 0 is unlimited
 } driver_data_t;
 
 #endif
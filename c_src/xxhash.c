@@ -0,0 +1,106 @@
+/*
+64 bit xxHash (XXH64)
+
+Written from the description of the algorithm at
+https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+*/
+
+#include <string.h>
+
+#include "xxhash.h"
+
+#define PRIME64_1   0x9E3779B185EBCA87ULL
+#define PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3   0x165667B19E3779F9ULL
+#define PRIME64_4   0x85EBCA77C2B2AE63ULL
+#define PRIME64_5   0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64( uint64_t x, int r ) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// the input is little endian. memcpy keeps unaligned reads legal
+static inline uint64_t read64( const unsigned char* p ) {
+  uint64_t v;
+  memcpy( &v, p, sizeof(v) );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64( v );
+#endif
+  return v;
+}
+
+static inline uint32_t read32( const unsigned char* p ) {
+  uint32_t v;
+  memcpy( &v, p, sizeof(v) );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap32( v );
+#endif
+  return v;
+}
+
+static inline uint64_t round64( uint64_t acc, uint64_t input ) {
+  acc += input * PRIME64_2;
+  acc = rotl64( acc, 31 );
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t merge64( uint64_t acc, uint64_t v ) {
+  acc ^= round64( 0, v );
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+//---------------------------------------------------------
+uint64_t xxh64( const void* p_data, size_t size, uint64_t seed ) {
+  const unsigned char* p = p_data;
+  const unsigned char* p_end = p + size;
+  uint64_t h;
+
+  if ( size >= 32 ) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    const unsigned char* p_limit = p_end - 32;
+    do {
+      v1 = round64( v1, read64(p) );
+      v2 = round64( v2, read64(p + 8) );
+      v3 = round64( v3, read64(p + 16) );
+      v4 = round64( v4, read64(p + 24) );
+      p += 32;
+    } while ( p <= p_limit );
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = merge64( h, v1 );
+    h = merge64( h, v2 );
+    h = merge64( h, v3 );
+    h = merge64( h, v4 );
+  } else {
+    h = seed + PRIME64_5;
+  }
+
+  h += (uint64_t)size;
+
+  while ( p + 8 <= p_end ) {
+    h ^= round64( 0, read64(p) );
+    h = rotl64( h, 27 ) * PRIME64_1 + PRIME64_4;
+    p += 8;
+  }
+  if ( p + 4 <= p_end ) {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64( h, 23 ) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  while ( p < p_end ) {
+    h ^= (*p) * PRIME64_5;
+    h = rotl64( h, 11 ) * PRIME64_1;
+    p++;
+  }
+
+  // avalanche
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
@@ -0,0 +1,17 @@
+/*
+64 bit xxHash (XXH64)
+
+A fast non-cryptographic hash, used to spot texture data that was already
+uploaded under another key. Gives the same values as the reference
+implementation.
+*/
+
+#ifndef _XXHASH_H
+#define _XXHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t xxh64( const void* p_data, size_t size, uint64_t seed );
+
+#endif
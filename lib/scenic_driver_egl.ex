@@ -38,6 +38,35 @@ defmodule ScenicDriverEGL do
   def hide(pid), do: GenServer.cast(pid, :hide)
   def close(pid), do: GenServer.cast(pid, :close)
 
+  @doc """
+  Rasterize the glyphs of `chars` in `font` into the font atlas ahead of
+  time, so the first frame that draws them doesn't stall. `sizes` is a list
+  of font sizes or `{size, blur}` pairs. `chars` is a string or a range of
+  codepoints. The work is spread over the time between frames.
+  """
+  def prewarm_text(pid, font, sizes, chars),
+    do: GenServer.cast(pid, {:prewarm_text, font, sizes, chars})
+
+  @doc """
+  Measure a batch of strings with the metrics the driver draws text with,
+  in one round trip. `font` is a system font atom, like `:roboto`, or the
+  cache key of a font, `size` the font size and `strings` a list of
+  strings. Options:
+
+    * `:text_align` - a `text_align` style, `:left` by default
+    * `:wrap_width` - break each string into lines no wider than this
+
+  Returns `{:ok, %{ascender: a, descender: d, line_height: h, strings: list}}`
+  where each entry of `list` is `%{width: w, bounds: {l, t, r, b}, lines:
+  lines}`. `w` is the advance of the string, the bounds are relative to
+  the point it is drawn at, and with a wrap width `lines` holds a
+  `%{text: t, start: byte_offset, width: w, min_x: x0, max_x: x1}` for each
+  line. Returns `{:err, :font_not_loaded}` if the driver doesn't have the
+  font yet.
+  """
+  def measure_text(pid, font, size, strings, opts \\ []),
+    do: GenServer.call(pid, {:measure_text, font, size, strings, opts})
+
   if Mix.env() == :dev do
     def crash(pid), do: GenServer.cast(pid, :crash)
   end
@@ -65,7 +94,55 @@ defmodule ScenicDriverEGL do
         _ -> @default_debug
       end
 
-    port_args = to_charlist(" #{dl_block_size} #{debug_mode}")
+    # optionally record every message sent to the port. See c_src/capture.h
+    capture_arg =
+      case config[:capture] do
+        path when is_binary(path) -> " -c #{path}"
+        _ -> ""
+      end
+
+    # render on the CPU into DRM dumb buffers instead of through GBM/EGL.
+    # The window size is used when there is no DRM device to size from
+    output_arg =
+      case config[:output] do
+        :software -> " -s -w #{width} -h #{height}"
+        _ -> ""
+      end
+
+    # cap texture memory. The least recently drawn textures are evicted when
+    # over budget and reloaded through the texture miss path if drawn again
+    budget_arg =
+      case config[:texture_budget] do
+        bytes when is_integer(bytes) and bytes > 0 -> " -b #{bytes}"
+        _ -> ""
+      end
+
+    # per texture mipmaps, filtering and repeat, by cache key. See Cache.texture_flags
+    texture_opts =
+      case config[:texture_opts] do
+        %{} = opts -> opts
+        _ -> %{}
+      end
+
+    # per font load options, by font key or system font atom. See Font.load_font
+    font_opts =
+      case config[:font_opts] do
+        %{} = opts ->
+          Map.new(opts, fn {font, opts} -> {ScenicDriverEGL.Font.font_key(font), opts} end)
+
+        _ ->
+          %{}
+      end
+
+    # {font, sizes, chars} to prewarm once the port is up. See prewarm_text/4
+    prewarm_text =
+      case config[:prewarm_text] do
+        list when is_list(list) -> list
+        _ -> []
+      end
+
+    port_args =
+      to_charlist(" #{dl_block_size} #{debug_mode}#{capture_arg}#{output_arg}#{budget_arg}")
 
     # request put and delete notifications from the cache
     Cache.Static.Font.subscribe(:all)
@@ -76,6 +153,10 @@ defmodule ScenicDriverEGL do
     executable = :code.priv_dir(:scenic_driver_egl) ++ @port ++ port_args
     port = Port.open({:spawn, executable}, [:binary, {:packet, 4}])
 
+    # texture key => script handle. See Cache.tx_handle
+    tx_handles = :ets.new(:scenic_driver_egl_tx_handles, [:set, :public])
+    :ets.insert(tx_handles, [{:next_handle, 0}, {:compiling, 0}])
+
     state = %{
       inputs: 0x0000,
       port: port,
@@ -91,6 +172,12 @@ defmodule ScenicDriverEGL do
       used_dls: %{},
       clear_color: @default_clear_color,
       textures: %{},
+      dynamic_textures: %{},
+      texture_opts: texture_opts,
+      font_opts: font_opts,
+      prewarm_text: prewarm_text,
+      tx_handles: tx_handles,
+      tx_retiring: [],
       fonts: %{},
       dirty_graphs: [],
       sync_interval: sync_interval,
@@ -114,6 +201,10 @@ defmodule ScenicDriverEGL do
   # this module just got too long and complicated, so this cleans things up.
 
   # --------------------------------------------------------
+  def handle_call({:measure_text, _, _, _, _} = msg, from, state) do
+    ScenicDriverEGL.Font.handle_call(msg, from, state)
+  end
+
   def handle_call(msg, from, state) do
     ScenicDriverEGL.Port.handle_call(msg, from, state)
   end
@@ -125,7 +216,7 @@ defmodule ScenicDriverEGL do
     |> do_handle(&ScenicDriverEGL.Graph.handle_cast(&1, state))
     |> do_handle(&ScenicDriverEGL.Cache.handle_cast(&1, state))
     |> do_handle(&ScenicDriverEGL.Port.handle_cast(&1, state))
-    # |> do_handle( &ScenicDriverEGL.Font.handle_cast( &1, state ) )
+    |> do_handle(&ScenicDriverEGL.Font.handle_cast(&1, state))
     |> case do
       {:noreply, state} ->
         {:noreply, state}
@@ -149,6 +240,11 @@ defmodule ScenicDriverEGL do
     ScenicDriverEGL.Graph.handle_flush_dirty(state)
   end
 
+  # --------------------------------------------------------
+  def handle_info(:release_tx_handles, state) do
+    {:noreply, ScenicDriverEGL.Cache.release_tx_handles(state)}
+  end
+
   # --------------------------------------------------------
   def handle_info({:debounce, type}, %{ready: true} = state) do
     ScenicDriverEGL.Input.handle_debounce(type, state)
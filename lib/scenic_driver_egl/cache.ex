@@ -14,17 +14,34 @@ defmodule ScenicDriverEGL.Cache do
 
   # @msg_new_tx_id            0x31
 
+  @cmd_new_tx_id 0x32
   @cmd_free_tx_id 0x33
   @cmd_put_tx_file 0x34
   @cmd_put_tx_raw 0x35
+  @cmd_put_tx_ktx 0x36
+  @cmd_put_tx_sub 0x3A
+  @cmd_release_tx_id 0x3D
+
+  # how often to try again to release handles while graphs are compiling
+  @release_retry_ms 100
+
+  # texture flags sent with each put
+  @tx_flag_mipmaps 0x01
+  @tx_flag_repeat_x 0x02
+  @tx_flag_repeat_y 0x04
+  @tx_flag_nearest 0x20
+
+  # KTX 1 files are sent as they are, so the driver can hand their ETC
+  # blocks straight to the GPU
+  @ktx_identifier <<0xAB, "KTX 11", 0xBB, "\r\n", 0x1A, "\n">>
 
   # import IEx
 
   # ============================================================================
 
   # --------------------------------------------------------
-  def handle_cast({Static.Texture, :put, key}, %{port: port, ready: true} = state) do
-    load_static_texture(key, port)
+  def handle_cast({Static.Texture, :put, key}, %{ready: true} = state) do
+    load_static_texture(key, state)
     {:noreply, state}
   end
 
@@ -42,9 +59,8 @@ defmodule ScenicDriverEGL.Cache do
   end
 
   # --------------------------------------------------------
-  def handle_cast({Scenic.Cache.Dynamic.Texture, :put, key}, %{port: port, ready: true} = state) do
-    load_dynamic_texture(key, port)
-    {:noreply, state}
+  def handle_cast({Scenic.Cache.Dynamic.Texture, :put, key}, %{ready: true} = state) do
+    {:noreply, update_dynamic_texture(key, state)}
   end
 
   # --------------------------------------------------------
@@ -60,7 +76,7 @@ defmodule ScenicDriverEGL.Cache do
     >>
     |> Driver.Port.send(port)
 
-    {:noreply, state}
+    {:noreply, %{state | dynamic_textures: Map.delete(state.dynamic_textures, key)}}
   end
 
   # --------------------------------------------------------
@@ -72,13 +88,136 @@ defmodule ScenicDriverEGL.Cache do
   # ============================================================================
 
   # --------------------------------------------------------
-  def load_static_texture(key, port) do
+  # scripts draw textures by integer handle instead of by key. A key gets
+  # its handle the first time a graph using it is compiled, and keeps it
+  # while the texture is loaded, evicted and loaded again. Graphs are
+  # compiled in tasks, so handles live in a public ets table. If two tasks
+  # race for a key, the winner registers it with the port and the loser's
+  # number goes back to the free list
+  def tx_handle(key, %{tx_handles: table, port: port}) do
+    case :ets.lookup(table, key) do
+      [{_, handle}] ->
+        handle
+
+      [] ->
+        handle = take_free_handle(table) || :ets.update_counter(table, :next_handle, 1) - 1
+
+        case :ets.insert_new(table, {key, handle}) do
+          true ->
+            <<
+              @cmd_new_tx_id::unsigned-integer-size(32)-native,
+              handle::unsigned-integer-size(32)-native,
+              byte_size(key) + 1::unsigned-integer-size(32)-native,
+              key::binary,
+              0::size(8)
+            >>
+            |> Driver.Port.send(port)
+
+            handle
+
+          false ->
+            :ets.insert(table, {{:free_handle, handle}})
+            [{_, handle}] = :ets.lookup(table, key)
+            handle
+        end
+    end
+  end
+
+  # another task may take the same free handle first. :ets.take decides
+  defp take_free_handle(table) do
+    case :ets.match(table, {{:free_handle, :"$1"}}, 1) do
+      {[[handle]], _} ->
+        case :ets.take(table, {:free_handle, handle}) do
+          [_] -> handle
+          [] -> take_free_handle(table)
+        end
+
+      _ ->
+        nil
+    end
+  end
+
+  # --------------------------------------------------------
+  # runs a graph compile. Handles are only released while no compile is
+  # running, so a script can't arrive at the port with a handle the port
+  # already dropped
+  def compiling(%{tx_handles: table}, fun) do
+    :ets.update_counter(table, :compiling, 1)
+
+    try do
+      fun.()
+    after
+      :ets.update_counter(table, :compiling, -1)
+    end
+  end
+
+  # --------------------------------------------------------
+  # the port reports a handle whose key was freed from the cache and that
+  # no stored script draws with. Compiles from now on give the key a new
+  # handle, and the old one is released. Reports for a handle that is
+  # already on its way out are dropped
+  def retire_tx_handle(handle, key, %{tx_handles: table, tx_retiring: retiring} = state) do
+    case :ets.lookup(table, key) do
+      [{_, ^handle}] ->
+        :ets.delete(table, key)
+
+        case retiring do
+          [] -> release_tx_handles(%{state | tx_retiring: [handle]})
+          # a retry is already scheduled
+          _ -> %{state | tx_retiring: [handle | retiring]}
+        end
+
+      _ ->
+        state
+    end
+  end
+
+  # --------------------------------------------------------
+  # a compile that started before the handles were retired may still put
+  # them in a script. Wait for it, then tell the port. The port drops each
+  # handle when the last script drawing with it goes
+  def release_tx_handles(%{tx_retiring: []} = state), do: state
+
+  def release_tx_handles(%{tx_handles: table, tx_retiring: retiring, port: port} = state) do
+    case :ets.lookup(table, :compiling) do
+      [{_, 0}] ->
+        Enum.each(retiring, fn handle ->
+          <<
+            @cmd_release_tx_id::unsigned-integer-size(32)-native,
+            handle::unsigned-integer-size(32)-native
+          >>
+          |> Driver.Port.send(port)
+        end)
+
+        %{state | tx_retiring: []}
+
+      _ ->
+        Process.send_after(self(), :release_tx_handles, @release_retry_ms)
+        state
+    end
+  end
+
+  # --------------------------------------------------------
+  # the port has dropped the handle, so it can be given to another key
+  def free_tx_handle(handle, %{tx_handles: table}) do
+    :ets.insert(table, {{:free_handle, handle}})
+  end
+
+  # --------------------------------------------------------
+  def load_static_texture(key, %{port: port} = state) do
     # Static.Texture.subscribe(key, :all)
     with {:ok, data} <- Static.Texture.fetch(key) do
+      cmd =
+        case data do
+          <<@ktx_identifier::binary, _::binary>> -> @cmd_put_tx_ktx
+          _ -> @cmd_put_tx_file
+        end
+
       <<
-        @cmd_put_tx_file::unsigned-integer-size(32)-native,
+        cmd::unsigned-integer-size(32)-native,
         byte_size(key) + 1::unsigned-integer-size(32)-native,
         byte_size(data)::unsigned-integer-size(32)-native,
+        texture_flags(key, [], state)::unsigned-integer-size(32)-native,
         key::binary,
         0::size(8),
         data::binary
@@ -90,30 +229,155 @@ defmodule ScenicDriverEGL.Cache do
   end
 
   # --------------------------------------------------------
-  def load_dynamic_texture(key, port) do
-    with {:ok, {type, width, height, pixels, _}} <- Dynamic.Texture.fetch(key) do
-      depth =
-        case type do
-          :g -> 1
-          :ga -> 2
-          :rgb -> 3
-          :rgba -> 4
-        end
+  # sends the whole texture. The pixels are remembered to find what changed
+  # when it is put again. Binaries this size are shared, not copied, so
+  # this only holds on to the previous version of each texture
+  def load_dynamic_texture(key, %{port: port, dynamic_textures: textures} = state) do
+    with {:ok, {type, width, height, pixels, opts}} <- Dynamic.Texture.fetch(key) do
+      depth = texture_depth(type)
+      flags = texture_flags(key, opts, state)
+      put_dynamic_texture(key, depth, width, height, flags, pixels, port)
+      %{state | dynamic_textures: Map.put(textures, key, {depth, width, height, flags, pixels})}
+    else
+      err ->
+        IO.inspect(err, label: "load_dynamic_texture")
+        state
+    end
+  end
+
+  # --------------------------------------------------------
+  # a put of a texture the driver already has in the same size, format
+  # and flags only sends the rect that changed, unless that is most of it
+  def update_dynamic_texture(key, %{port: port, dynamic_textures: textures} = state) do
+    with {:ok, {type, width, height, pixels, opts}} <- Dynamic.Texture.fetch(key),
+         depth = texture_depth(type),
+         flags = texture_flags(key, opts, state),
+         {^depth, ^width, ^height, ^flags, old_pixels} <- Map.get(textures, key) do
+      case dirty_rect(old_pixels, pixels, width, depth) do
+        nil ->
+          :ok
+
+        {_, _, w, h} = rect when w * h * 2 <= width * height ->
+          put_dynamic_texture_rect(key, depth, width, rect, pixels, port)
+
+        _ ->
+          put_dynamic_texture(key, depth, width, height, flags, pixels, port)
+      end
+
+      %{state | dynamic_textures: Map.put(textures, key, {depth, width, height, flags, pixels})}
+    else
+      _ -> load_dynamic_texture(key, state)
+    end
+  end
+
+  # --------------------------------------------------------
+  def put_dynamic_texture(key, depth, width, height, flags, pixels, port) do
+    <<
+      @cmd_put_tx_raw::unsigned-integer-size(32)-native,
+      byte_size(key) + 1::unsigned-integer-size(32)-native,
+      byte_size(pixels)::unsigned-integer-size(32)-native,
+      depth::unsigned-integer-size(32)-native,
+      width::unsigned-integer-size(32)-native,
+      height::unsigned-integer-size(32)-native,
+      flags::unsigned-integer-size(32)-native,
+      key::binary,
+      0::size(8),
+      pixels::binary
+    >>
+    |> Driver.Port.send(port)
+  end
+
+  # --------------------------------------------------------
+  # sends the pixels of the rect {x, y, w, h} of an image that is width
+  # pixels wide. The driver updates just that part of its texture
+  def put_dynamic_texture_rect(key, depth, width, {x, y, w, h}, pixels, port) do
+    stride = width * depth
+
+    rows =
+      for row <- y..(y + h - 1) do
+        :binary.part(pixels, row * stride + x * depth, w * depth)
+      end
 
+    [
       <<
-        @cmd_put_tx_raw::unsigned-integer-size(32)-native,
+        @cmd_put_tx_sub::unsigned-integer-size(32)-native,
         byte_size(key) + 1::unsigned-integer-size(32)-native,
-        byte_size(pixels)::unsigned-integer-size(32)-native,
+        w * h * depth::unsigned-integer-size(32)-native,
         depth::unsigned-integer-size(32)-native,
-        width::unsigned-integer-size(32)-native,
-        height::unsigned-integer-size(32)-native,
+        x::unsigned-integer-size(32)-native,
+        y::unsigned-integer-size(32)-native,
+        w::unsigned-integer-size(32)-native,
+        h::unsigned-integer-size(32)-native,
         key::binary,
-        0::size(8),
-        pixels::binary
-      >>
-      |> Driver.Port.send(port)
-    else
-      err -> IO.inspect(err, label: "load_dynamic_texture")
+        0::size(8)
+      >>,
+      rows
+    ]
+    |> Driver.Port.send(port)
+  end
+
+  # --------------------------------------------------------
+  # the bounding rect of the pixels that differ, or nil if none do. The
+  # common prefix and suffix of the whole images give the rows, and those
+  # of each row in between give the columns
+  defp dirty_rect(old_pixels, pixels, width, depth) do
+    size = byte_size(pixels)
+
+    case :binary.longest_common_prefix([old_pixels, pixels]) do
+      ^size ->
+        nil
+
+      prefix ->
+        suffix = :binary.longest_common_suffix([old_pixels, pixels])
+        stride = width * depth
+        top = div(prefix, stride)
+        bottom = div(size - suffix - 1, stride)
+
+        {left, right} =
+          Enum.reduce(top..bottom, {width, 0}, fn row, {left, right} ->
+            old_row = :binary.part(old_pixels, row * stride, stride)
+            new_row = :binary.part(pixels, row * stride, stride)
+
+            case :binary.longest_common_prefix([old_row, new_row]) do
+              ^stride ->
+                {left, right}
+
+              row_prefix ->
+                row_suffix = :binary.longest_common_suffix([old_row, new_row])
+                {min(left, div(row_prefix, depth)),
+                 max(right, div(stride - row_suffix - 1, depth) + 1)}
+            end
+          end)
+
+        {left, top, right - left, bottom - top + 1}
     end
   end
+
+  # --------------------------------------------------------
+  # options for a texture come from the driver's :texture_opts config for
+  # its key, and for dynamic textures from the opts they were put with.
+  # Mipmaps are allowed unless turned off, and only made if the texture is
+  # drawn smaller than its size
+  defp texture_flags(key, put_opts, %{texture_opts: texture_opts}) do
+    put_opts = if Keyword.keyword?(put_opts), do: put_opts, else: []
+    opts = Keyword.merge(Map.get(texture_opts, key, []), put_opts)
+
+    mipmaps = if Keyword.get(opts, :mipmaps, true), do: @tx_flag_mipmaps, else: 0
+    filter = if Keyword.get(opts, :filter) == :nearest, do: @tx_flag_nearest, else: 0
+
+    repeat =
+      case Keyword.get(opts, :repeat) do
+        true -> @tx_flag_repeat_x + @tx_flag_repeat_y
+        :x -> @tx_flag_repeat_x
+        :y -> @tx_flag_repeat_y
+        _ -> 0
+      end
+
+    mipmaps + filter + repeat
+  end
+
+  defp texture_depth(:g), do: 1
+  defp texture_depth(:ga), do: 2
+  defp texture_depth(:rgb), do: 3
+  defp texture_depth(:rgba), do: 4
 end
@@ -10,6 +10,7 @@
 defmodule ScenicDriverEGL.Compile do
   @moduledoc false
   alias Scenic.Primitive
+  alias ScenicDriverEGL, as: Driver
 
   require Logger
 
@@ -124,23 +125,23 @@ defmodule ScenicDriverEGL.Compile do
     |> compile_styles(p)
     |> op_path_begin()
     |> do_compile_primitive(p, graph, state)
-    |> do_fill(p)
-    |> do_stroke(p)
+    |> do_fill(p, state)
+    |> do_stroke(p, state)
     |> op_pop_state()
   end
 
   # --------------------------------------------------------
-  defp do_fill(ops, %{styles: %{fill: paint}}) do
+  defp do_fill(ops, %{styles: %{fill: paint}}, state) do
     case paint do
       {:image, {image, ox, oy, ex, ey, angle, alpha}} ->
         ops
-        |> op_paint_image(image, ox, oy, ex, ey, angle, alpha)
+        |> op_paint_image(Driver.Cache.tx_handle(image, state), ox, oy, ex, ey, angle, alpha)
         |> op_fill_paint()
 
       {:dynamic, {image, ox, oy, ex, ey, angle, alpha}} ->
         # IO.inspect(image, label: "dynamic")
         ops
-        |> op_paint_dynamic(image, ox, oy, ex, ey, angle, alpha)
+        |> op_paint_dynamic(Driver.Cache.tx_handle(image, state), ox, oy, ex, ey, angle, alpha)
         |> op_fill_paint()
 
       _ ->
@@ -149,19 +150,19 @@ defmodule ScenicDriverEGL.Compile do
     |> op_fill()
   end
 
-  defp do_fill(ops, _), do: ops
+  defp do_fill(ops, _, _), do: ops
 
   # --------------------------------------------------------
-  defp do_stroke(ops, %{styles: %{stroke: paint}}) do
+  defp do_stroke(ops, %{styles: %{stroke: paint}}, state) do
     case paint do
       {:image, {image, ox, oy, ex, ey, angle, alpha}} ->
         ops
-        |> op_paint_image(image, ox, oy, ex, ey, angle, alpha)
+        |> op_paint_image(Driver.Cache.tx_handle(image, state), ox, oy, ex, ey, angle, alpha)
         |> op_stroke_paint()
 
       {:dynamic, {image, ox, oy, ex, ey, angle, alpha}} ->
         ops
-        |> op_paint_dynamic(image, ox, oy, ex, ey, angle, alpha)
+        |> op_paint_dynamic(Driver.Cache.tx_handle(image, state), ox, oy, ex, ey, angle, alpha)
         |> op_stroke_paint()
 
       _ ->
@@ -170,7 +171,7 @@ defmodule ScenicDriverEGL.Compile do
     |> op_stroke()
   end
 
-  defp do_stroke(ops, _), do: ops
+  defp do_stroke(ops, _, _), do: ops
 
   # --------------------------------------------------------
   defp do_compile_primitive(ops, %{data: {Primitive.Group, ids}}, graph, state) do
@@ -606,18 +607,7 @@ defmodule ScenicDriverEGL.Compile do
     ]
   end
 
-  defp op_paint_image(ops, image, ox, oy, ex, ey, angle, alpha) do
-    name_size = byte_size(image) + 1
-
-    # keep everything aligned on 4 byte boundaries
-    {name_size, extra_buffer} =
-      case 4 - rem(name_size, 4) do
-        1 -> {name_size + 1, <<0::size(8)>>}
-        2 -> {name_size + 2, <<0::size(16)>>}
-        3 -> {name_size + 3, <<0::size(24)>>}
-        _ -> {name_size, <<>>}
-      end
-
+  defp op_paint_image(ops, handle, ox, oy, ex, ey, angle, alpha) do
     [
       <<
         @op_paint_image::unsigned-integer-size(32)-native,
@@ -627,28 +617,13 @@ defmodule ScenicDriverEGL.Compile do
         ey::float-size(32)-native,
         angle::float-size(32)-native,
         alpha::unsigned-integer-size(32)-native,
-        name_size::unsigned-integer-size(32)-native,
-        image::binary,
-        # null terminate to it can be used directly
-        0::size(8),
-        extra_buffer::binary
+        handle::unsigned-integer-size(32)-native
       >>
       | ops
     ]
   end
 
-  defp op_paint_dynamic(ops, image, ox, oy, ex, ey, angle, alpha) do
-    name_size = byte_size(image) + 1
-
-    # keep everything aligned on 4 byte boundaries
-    {name_size, extra_buffer} =
-      case 4 - rem(name_size, 4) do
-        1 -> {name_size + 1, <<0::size(8)>>}
-        2 -> {name_size + 2, <<0::size(16)>>}
-        3 -> {name_size + 3, <<0::size(24)>>}
-        _ -> {name_size, <<>>}
-      end
-
+  defp op_paint_dynamic(ops, handle, ox, oy, ex, ey, angle, alpha) do
     [
       <<
         @op_paint_dynamic::unsigned-integer-size(32)-native,
@@ -658,11 +633,7 @@ defmodule ScenicDriverEGL.Compile do
         ey::float-size(32)-native,
         angle::float-size(32)-native,
         alpha::unsigned-integer-size(32)-native,
-        name_size::unsigned-integer-size(32)-native,
-        image::binary,
-        # null terminate to it can be used directly
-        0::size(8),
-        extra_buffer::binary
+        handle::unsigned-integer-size(32)-native
       >>
       | ops
     ]
@@ -837,18 +808,8 @@ defmodule ScenicDriverEGL.Compile do
     ]
   end
 
-  defp op_text_align(ops, :left), do: op_text_align(ops, 0b1000001)
-  defp op_text_align(ops, :center), do: op_text_align(ops, 0b1000010)
-  defp op_text_align(ops, :right), do: op_text_align(ops, 0b1000100)
-  defp op_text_align(ops, :left_top), do: op_text_align(ops, 0b0001001)
-  defp op_text_align(ops, :center_top), do: op_text_align(ops, 0b0001010)
-  defp op_text_align(ops, :right_top), do: op_text_align(ops, 0b0001100)
-  defp op_text_align(ops, :left_middle), do: op_text_align(ops, 0b0010001)
-  defp op_text_align(ops, :center_middle), do: op_text_align(ops, 0b0010010)
-  defp op_text_align(ops, :right_middle), do: op_text_align(ops, 0b0010100)
-  defp op_text_align(ops, :left_bottom), do: op_text_align(ops, 0b0100001)
-  defp op_text_align(ops, :center_bottom), do: op_text_align(ops, 0b0100010)
-  defp op_text_align(ops, :right_bottom), do: op_text_align(ops, 0b0100100)
+  defp op_text_align(ops, align) when is_atom(align),
+    do: op_text_align(ops, text_align_flags(align))
 
   defp op_text_align(ops, flags) when is_integer(flags) do
     [
@@ -860,6 +821,21 @@ defmodule ScenicDriverEGL.Compile do
     ]
   end
 
+  # nanovg NVG_ALIGN_* bits of a text_align style. Text is measured with them too
+  @doc false
+  def text_align_flags(:left), do: 0b1000001
+  def text_align_flags(:center), do: 0b1000010
+  def text_align_flags(:right), do: 0b1000100
+  def text_align_flags(:left_top), do: 0b0001001
+  def text_align_flags(:center_top), do: 0b0001010
+  def text_align_flags(:right_top), do: 0b0001100
+  def text_align_flags(:left_middle), do: 0b0010001
+  def text_align_flags(:center_middle), do: 0b0010010
+  def text_align_flags(:right_middle), do: 0b0010100
+  def text_align_flags(:left_bottom), do: 0b0100001
+  def text_align_flags(:center_bottom), do: 0b0100010
+  def text_align_flags(:right_bottom), do: 0b0100100
+
   defp op_text_height(ops, height) do
     [
       <<
@@ -5,6 +5,7 @@
 
 defmodule ScenicDriverEGL.Font do
   alias ScenicDriverEGL
+  alias ScenicDriverEGL.Compile
   alias Scenic.Cache
   require Logger
 
@@ -15,14 +16,42 @@ defmodule ScenicDriverEGL.Font do
   # @cmd_load_font_file 0x37
   @cmd_load_font_blob 0x38
   @cmd_free_font 0x39
+  @cmd_prewarm_font 0x3B
+  @cmd_measure_text 0x3C
+
+  @msg_text_metrics_id 0x08
+
+  # status of a text metrics reply. See font.c
+  @measure_ok 0
+  @measure_no_font 1
+
+  # load flags. See font.h
+  @font_flag_sdf 0x01
+
+  # the port loads fonts under their cache key. These are the keys of the
+  # system fonts Scenic styles name by atom. See priv/fonts
+  @system_fonts %{
+    roboto: "eehRQEZX2sIQaz0irSVtR4JKmldlRY7bcskQKkWBbZU",
+    roboto_mono: "x6stc899U4-s4IvN3pW5KM5gmpcCN8iBHKPHYFnIuy8"
+  }
 
   # --------------------------------------------------------
-  def load_font(font_key, port)
+  @doc false
+  def font_key(font) when is_atom(font), do: Map.get(@system_fonts, font, to_string(font))
+  def font_key(font), do: to_string(font)
+
+  # --------------------------------------------------------
+  # opts come from the driver's :font_opts config for the font's key.
+  # sdf: true draws it from distance field glyphs, which stay sharp at any
+  # size from one set of glyphs in the atlas
+  def load_font(font_key, port, opts \\ [])
+
+  def load_font(hash, port, opts) when is_bitstring(hash) do
+    flags = if opts[:sdf], do: @font_flag_sdf, else: 0
 
-  def load_font(hash, port) when is_bitstring(hash) do
     case Cache.Static.Font.fetch(hash) do
       {:ok, font} ->
-        do_load_font(font, hash, port)
+        do_load_font(font, hash, flags, port)
 
       _ ->
         font_folder =
@@ -31,16 +60,17 @@ defmodule ScenicDriverEGL.Font do
 
         with {:ok, ^hash} <- Cache.Static.Font.load(font_folder, hash),
              {:ok, font} <- Cache.Static.Font.fetch(hash) do
-          do_load_font(font, hash, port)
+          do_load_font(font, hash, flags, port)
         end
     end
   end
 
-  defp do_load_font(font_blob, font_hash, port) do
+  defp do_load_font(font_blob, font_hash, flags, port) do
     <<
       @cmd_load_font_blob::unsigned-integer-size(32)-native,
       byte_size(font_hash) + 1::unsigned-integer-size(32)-native,
       byte_size(font_blob)::unsigned-integer-size(32)-native,
+      flags::unsigned-integer-size(32)-native,
       font_hash::binary,
       # null terminate so it can be used directly
       0::size(8),
@@ -52,14 +82,175 @@ defmodule ScenicDriverEGL.Font do
   # --------------------------------------------------------
   def free_font(font_name_or_key, port) do
     name = to_string(font_name_or_key)
-    # send the message to the C driver to load the font
+    # send the message to the C driver to free the font. It waits for the
+    # scripts that still draw with it to go
     <<
       @cmd_free_font::unsigned-integer-size(32)-native,
-      byte_size(name) + 1::unsigned-integer-size(16)-native,
+      byte_size(name) + 1::unsigned-integer-size(32)-native,
       name::binary,
       # null terminate so it can be used directly
       0::size(8)
     >>
     |> ScenicDriverEGL.Port.send(port)
   end
+
+  # --------------------------------------------------------
+  # rasterize glyphs into the font atlas before a scene draws them. sizes is
+  # a list of font sizes or {size, blur} pairs. chars is a string, or a
+  # range of codepoints
+  def prewarm(font, sizes, chars, port) do
+    name = font_key(font)
+
+    styles =
+      for size <- List.wrap(sizes), into: <<>> do
+        {size, blur} =
+          case size do
+            {size, blur} -> {size, blur}
+            size -> {size, 0}
+          end
+
+        <<size::float-size(32)-native, blur::float-size(32)-native>>
+      end
+
+    text =
+      case chars do
+        %Range{} = range ->
+          # surrogates aren't characters
+          for cp <- range, cp not in 0xD800..0xDFFF, into: "", do: <<cp::utf8>>
+
+        chars ->
+          to_string(chars)
+      end
+
+    <<
+      @cmd_prewarm_font::unsigned-integer-size(32)-native,
+      byte_size(name) + 1::unsigned-integer-size(32)-native,
+      div(byte_size(styles), 8)::unsigned-integer-size(32)-native,
+      byte_size(text)::unsigned-integer-size(32)-native,
+      name::binary,
+      # null terminate so it can be used directly
+      0::size(8),
+      styles::binary,
+      text::binary
+    >>
+    |> ScenicDriverEGL.Port.send(port)
+  end
+
+  # --------------------------------------------------------
+  # measure a batch of strings in one round trip. Each string is measured
+  # on its own, with the font, size and alignment it would be drawn with
+  def measure(font, size, strings, opts, port) do
+    name = font_key(font)
+    strings = Enum.map(List.wrap(strings), &to_string/1)
+    align = Compile.text_align_flags(opts[:text_align] || :left)
+    wrap_width = opts[:wrap_width] || 0
+    # a reply left over from a call that timed out is told apart by its tag
+    tag = :erlang.unique_integer([:positive]) |> rem(0x100000000)
+
+    packed =
+      for string <- strings, into: <<>> do
+        <<byte_size(string)::unsigned-integer-size(32)-native, string::binary>>
+      end
+
+    <<
+      @cmd_measure_text::unsigned-integer-size(32)-native,
+      tag::unsigned-integer-size(32)-native,
+      byte_size(name) + 1::unsigned-integer-size(32)-native,
+      size::float-size(32)-native,
+      align::unsigned-integer-size(32)-native,
+      wrap_width::float-size(32)-native,
+      length(strings)::unsigned-integer-size(32)-native,
+      name::binary,
+      # null terminate so it can be used directly
+      0::size(8),
+      packed::binary
+    >>
+    |> ScenicDriverEGL.Port.send(port)
+
+    receive do
+      {^port,
+       {:data,
+        <<@msg_text_metrics_id::unsigned-integer-size(32)-native,
+          ^tag::unsigned-integer-size(32)-native, status::unsigned-integer-size(32)-native,
+          ascender::float-size(32)-native, descender::float-size(32)-native,
+          line_height::float-size(32)-native, _count::unsigned-integer-size(32)-native,
+          data::binary>>}} ->
+        case status do
+          @measure_ok ->
+            {:ok,
+             %{
+               ascender: ascender,
+               descender: descender,
+               line_height: line_height,
+               strings: parse_metrics(strings, data, [])
+             }}
+
+          @measure_no_font ->
+            {:err, :font_not_loaded}
+        end
+    after
+      200 -> {:err, :timeout}
+    end
+  end
+
+  defp parse_metrics([], _, metrics), do: Enum.reverse(metrics)
+
+  defp parse_metrics(
+         [string | strings],
+         <<width::float-size(32)-native, left::float-size(32)-native,
+           top::float-size(32)-native, right::float-size(32)-native,
+           bottom::float-size(32)-native, line_count::unsigned-integer-size(32)-native,
+           rest::binary>>,
+         metrics
+       ) do
+    # five 32 bit values a line
+    line_bytes = line_count * 20
+    <<lines::binary-size(line_bytes), rest::binary>> = rest
+
+    lines =
+      for <<start::unsigned-integer-size(32)-native, stop::unsigned-integer-size(32)-native,
+            line_width::float-size(32)-native, min_x::float-size(32)-native,
+            max_x::float-size(32)-native <- lines>> do
+        %{
+          text: binary_part(string, start, stop - start),
+          start: start,
+          width: line_width,
+          min_x: min_x,
+          max_x: max_x
+        }
+      end
+
+    metric = %{width: width, bounds: {left, top, right, bottom}, lines: lines}
+    parse_metrics(strings, rest, [metric | metrics])
+  end
+
+  # strings cut off by a short message aren't in the reply
+  defp parse_metrics(_, _, metrics), do: Enum.reverse(metrics)
+
+  # ============================================================================
+  @doc false
+  def handle_call(msg, from, state)
+
+  def handle_call({:measure_text, font, size, strings, opts}, _from, %{port: port} = state) do
+    {:reply, measure(font, size, strings, opts, port), state}
+  end
+
+  # ============================================================================
+  @doc false
+  def handle_cast(msg, state)
+
+  def handle_cast({:prewarm_text, font, sizes, chars}, %{port: port} = state) do
+    prewarm(font, sizes, chars, port)
+    {:noreply, state}
+  end
+
+  # a font taken out of the cache is freed in the port too. Scripts that
+  # still draw with it keep it until they are replaced
+  def handle_cast({Cache.Static.Font, :delete, key}, %{port: port, ready: true} = state) do
+    free_font(key, port)
+    {:noreply, state}
+  end
+
+  # unhandled. do nothing
+  def handle_cast(msg, _), do: msg
 end
@@ -259,7 +259,10 @@ defmodule ScenicDriverEGL.Graph do
       end
 
     Task.start_link(fn ->
-      Enum.each(keys, &render_one_graph(driver, &1, state))
+      Driver.Cache.compiling(state, fn ->
+        Enum.each(keys, &render_one_graph(driver, &1, state))
+      end)
+
       if root_id, do: Port.set_root_dl(port, root_id)
     end)
 
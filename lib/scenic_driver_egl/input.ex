@@ -26,6 +26,7 @@ defmodule ScenicDriverEGL.Input do
 
   @msg_ready_id 0x06
   @msg_draw_ready_id 0x07
+  @msg_text_metrics_id 0x08
 
   @msg_key_id 0x0A
   @msg_char_id 0x0B
@@ -38,6 +39,8 @@ defmodule ScenicDriverEGL.Input do
   @msg_dynamic_texture_miss 0x21
 
   @msg_font_miss 0x22
+  @msg_tx_handle_unused 0x23
+  @msg_tx_handle_released 0x24
 
   @debounce_speed 16
 
@@ -133,6 +136,10 @@ defmodule ScenicDriverEGL.Input do
     GenServer.cast(viewport, {:driver_ready, self()})
     GenServer.cast(viewport, {:driver_register, driver_data})
 
+    Enum.each(state.prewarm_text, fn {font, sizes, chars} ->
+      Font.prewarm(font, sizes, chars, state.port)
+    end)
+
     {:noreply, state}
   end
 
@@ -188,10 +195,10 @@ defmodule ScenicDriverEGL.Input do
         <<
           @msg_static_texture_miss::unsigned-integer-size(32)-native
         >> <> key,
-        %{port: port} = state
+        state
       ) do
     Scenic.Cache.Static.Texture.subscribe(key, :all)
-    Cache.load_static_texture(key, port)
+    Cache.load_static_texture(key, state)
     {:noreply, state}
   end
 
@@ -200,11 +207,10 @@ defmodule ScenicDriverEGL.Input do
         <<
           @msg_dynamic_texture_miss::unsigned-integer-size(32)-native
         >> <> key,
-        %{port: port} = state
+        state
       ) do
     Scenic.Cache.Dynamic.Texture.subscribe(key, :all)
-    Cache.load_dynamic_texture(key, port)
-    {:noreply, state}
+    {:noreply, Cache.load_dynamic_texture(key, state)}
   end
 
   # --------------------------------------------------------
@@ -212,7 +218,26 @@ defmodule ScenicDriverEGL.Input do
         <<@msg_font_miss::unsigned-integer-size(32)-native>> <> key,
         %{port: port} = state
       ) do
-    Font.load_font(key, port)
+    Font.load_font(key, port, Map.get(state.font_opts, key, []))
+    {:noreply, state}
+  end
+
+  # --------------------------------------------------------
+  def handle_port_message(
+        <<@msg_tx_handle_unused::unsigned-integer-size(32)-native,
+          handle::unsigned-integer-size(32)-native>> <> key,
+        state
+      ) do
+    {:noreply, Cache.retire_tx_handle(handle, key, state)}
+  end
+
+  # --------------------------------------------------------
+  def handle_port_message(
+        <<@msg_tx_handle_released::unsigned-integer-size(32)-native,
+          handle::unsigned-integer-size(32)-native>>,
+        state
+      ) do
+    Cache.free_tx_handle(handle, state)
     {:noreply, state}
   end
 
@@ -303,6 +328,16 @@ defmodule ScenicDriverEGL.Input do
     {:noreply, state}
   end
 
+  # --------------------------------------------------------
+  # Font.measure waits for its reply. One that comes after it gave up is
+  # dropped here
+  def handle_port_message(
+        <<@msg_text_metrics_id::unsigned-integer-size(32)-native>> <> _,
+        state
+      ) do
+    {:noreply, state}
+  end
+
   # --------------------------------------------------------
   def handle_port_message(<<id::unsigned-integer-size(32)-native, bin::binary>>, state) do
     IO.puts("Unhandled port messages id: #{id}, msg: #{inspect(bin)}")
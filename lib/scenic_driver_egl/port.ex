@@ -166,9 +166,29 @@ defmodule ScenicDriverEGL.Port do
       receive do
         {^port,
          {:data,
-          <<@msg_stats_id::size(8), input_flags::unsigned-integer-native-size(32),
-            x_pos::integer-native-size(32), y_pos::integer-native-size(32),
-            width::integer-native-size(32), height::integer-native-size(32)>>}} ->
+          <<@msg_stats_id::unsigned-integer-size(32)-native,
+            input_flags::unsigned-integer-native-size(32), x_pos::integer-native-size(32),
+            y_pos::integer-native-size(32), width::integer-native-size(32),
+            height::integer-native-size(32), tx_decoded::unsigned-integer-native-size(32),
+            tx_decode_us_total::unsigned-integer-native-size(64),
+            tx_decode_us_max::unsigned-integer-native-size(32),
+            tx_resident_bytes::unsigned-integer-native-size(64),
+            tx_evictions::unsigned-integer-native-size(32),
+            miss_sent::unsigned-integer-native-size(32),
+            miss_suppressed::unsigned-integer-native-size(32),
+            miss_retried::unsigned-integer-native-size(32),
+            tx_dedup_hits::unsigned-integer-native-size(32),
+            tx_dedup_bytes::unsigned-integer-native-size(64),
+            glyph_atlas_width::unsigned-integer-native-size(32),
+            glyph_atlas_height::unsigned-integer-native-size(32),
+            glyph_atlas_used::unsigned-integer-native-size(32),
+            glyph_count::unsigned-integer-native-size(32),
+            glyph_evictions::unsigned-integer-native-size(32),
+            glyph_rerasterized::unsigned-integer-native-size(32),
+            glyph_atlas_resets::unsigned-integer-native-size(32),
+            font_count::unsigned-integer-native-size(32),
+            font_bytes::unsigned-integer-native-size(32),
+            fonts_freed::unsigned-integer-native-size(32)>>}} ->
           {:ok,
            %{
              input_flags: input_flags,
@@ -176,6 +196,26 @@ defmodule ScenicDriverEGL.Port do
              y_pos: y_pos,
              width: width,
              height: height,
+             tx_decoded: tx_decoded,
+             tx_decode_us_total: tx_decode_us_total,
+             tx_decode_us_max: tx_decode_us_max,
+             tx_resident_bytes: tx_resident_bytes,
+             tx_evictions: tx_evictions,
+             miss_sent: miss_sent,
+             miss_suppressed: miss_suppressed,
+             miss_retried: miss_retried,
+             tx_dedup_hits: tx_dedup_hits,
+             tx_dedup_bytes: tx_dedup_bytes,
+             glyph_atlas_width: glyph_atlas_width,
+             glyph_atlas_height: glyph_atlas_height,
+             glyph_atlas_used: glyph_atlas_used,
+             glyph_count: glyph_count,
+             glyph_evictions: glyph_evictions,
+             glyph_rerasterized: glyph_rerasterized,
+             glyph_atlas_resets: glyph_atlas_resets,
+             font_count: font_count,
+             font_bytes: font_bytes,
+             fonts_freed: fonts_freed,
              pid: self(),
              module: __MODULE__
            }}
@@ -341,6 +341,34 @@ defmodule ScenicDriverEGLTest do
     state = %{state | pending_flush: false, dirty_graphs: []}
     Process.sleep(40)
 
+    # measure a batch of strings in one call. System fonts are named by atom
+    {:reply, {:ok, metrics}, state} =
+      ScenicDriverEGL.handle_call(
+        {:measure_text, :roboto, 24, ["This is", "This is some text"], []},
+        self(),
+        state
+      )
+
+    assert metrics.line_height > 0
+    [short, long] = metrics.strings
+    assert short.width > 0 and short.width < long.width
+    assert short.lines == []
+
+    {:reply, {:ok, %{strings: [wrapped]}}, state} =
+      ScenicDriverEGL.handle_call(
+        {:measure_text, @roboto_hash, 24, "This is some text\nover two lines",
+         [wrap_width: 1000]},
+        self(),
+        state
+      )
+
+    assert Enum.map(wrapped.lines, & &1.text) == ["This is some text", "over two lines"]
+
+    msg = {:measure_text, "missing", 24, ["x"], []}
+
+    assert ScenicDriverEGL.handle_call(msg, self(), state) ==
+             {:reply, {:err, :font_not_loaded}, state}
+
     # custom font
     assert Cache.Static.FontMetrics.load(@font_metrics_path, @font_metrics_hash) ==
              {:ok, @font_metrics_hash}